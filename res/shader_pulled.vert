@@ -0,0 +1,25 @@
+#version 450
+#pragma shader_stage(vertex)
+#extension GL_EXT_buffer_reference : require
+
+// same layout as shader.vert's vertex input, but fetched straight from the mesh's vertex buffer
+struct Vertex {
+    vec2 pos;
+    vec2 uv;
+};
+
+layout(buffer_reference, std430, buffer_reference_align = 16) readonly buffer VertexBuffer {
+    Vertex vertices[];
+};
+
+layout(push_constant) uniform VertexPulling {
+    VertexBuffer vertex_buffer;
+};
+
+layout(location = 0) out vec2 f_uv;
+
+void main() {
+    Vertex v = vertex_buffer.vertices[gl_VertexIndex];
+    gl_Position = vec4(v.pos, 0.0, 1.0);
+    f_uv = v.uv;
+}
@@ -0,0 +1,281 @@
+// checks that steady state frames don't touch the heap. global operator new is replaced with a counting version, a few frames run to let everything grow to fit,
+// then any allocation in the following frames fails the test.
+// frames are recorded like App::render does, through the real record_single_use_commands, TrackedImage, SimpleRenderer and ActiveRenderer (both the pipeline and the
+// shader object path), after animating instances on the JobSystem and culling them with InstanceStore and Bvh. there's no device, the vulkan commands are stubbed out in
+// the default dispatcher, so RenderContext::render_frame and submit_for_rendering (which need a device and a swapchain) aren't covered.
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+#include "vke/bvh.hpp"
+#include "vke/instance_store.hpp"
+#include "vke/job_system.hpp"
+#include "vke/render_context.hpp"
+#include "vke/renderer.hpp"
+#include "vke/shader_object.hpp"
+#include "vke/state_track.hpp"
+
+namespace {
+    std::atomic<uint64_t> g_allocations = 0;
+
+    void *counted_allocate(std::size_t size, const std::size_t alignment) {
+        g_allocations.fetch_add(1, std::memory_order_relaxed);
+
+        size    = std::max(size, std::size_t{1});
+        void *p = alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__ ? std::aligned_alloc(alignment, (size + alignment - 1) & ~(alignment - 1)) : std::malloc(size);
+        if (p == nullptr)
+            throw std::bad_alloc();
+        return p;
+    }
+} // namespace
+
+void *operator new(const std::size_t size) { return counted_allocate(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__); }
+void *operator new[](const std::size_t size) { return counted_allocate(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__); }
+void *operator new(const std::size_t size, const std::align_val_t alignment) { return counted_allocate(size, static_cast<std::size_t>(alignment)); }
+void *operator new[](const std::size_t size, const std::align_val_t alignment) { return counted_allocate(size, static_cast<std::size_t>(alignment)); }
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::size_t) noexcept { std::free(p); }
+void operator delete(void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+
+namespace {
+    constexpr uint32_t WARMUP_FRAMES  = 8;
+    constexpr uint32_t TEST_FRAMES    = 1000;
+    constexpr uint32_t INSTANCE_COUNT = 4096;
+
+    // stands in for every command, the template arguments are deduced from the function pointer it's assigned to
+    template <typename R, typename... Args>
+    VKAPI_ATTR R VKAPI_CALL record_nothing(Args...) {
+        if constexpr (!std::is_void_v<R>)
+            return R{}; // VK_SUCCESS for commands returning a VkResult
+    }
+
+    template <typename T>
+    T fake_handle(const uint64_t value) {
+        if constexpr (std::is_pointer_v<T>) {
+            return reinterpret_cast<T>(static_cast<uintptr_t>(value));
+        } else {
+            return static_cast<T>(value);
+        }
+    }
+
+    VKAPI_ATTR VkResult VKAPI_CALL create_shaders(VkDevice, const uint32_t count, const VkShaderCreateInfoEXT *, const VkAllocationCallbacks *, VkShaderEXT *shaders) {
+        static uint64_t next = 1;
+        for (uint32_t i = 0; i < count; i++) {
+            shaders[i] = fake_handle<VkShaderEXT>(next++);
+        }
+        return VK_SUCCESS;
+    }
+
+    // every command a frame records, anything missing here crashes on a null function pointer
+    void stub_vulkan() {
+        auto &d = VULKAN_HPP_DEFAULT_DISPATCHER;
+
+        d.vkCreateShadersEXT = create_shaders;
+        d.vkDestroyShaderEXT = record_nothing;
+
+        d.vkResetCommandBuffer = record_nothing;
+        d.vkBeginCommandBuffer = record_nothing;
+        d.vkEndCommandBuffer   = record_nothing;
+
+        d.vkCmdPipelineBarrier2  = record_nothing;
+        d.vkCmdBeginRendering    = record_nothing;
+        d.vkCmdEndRendering      = record_nothing;
+        d.vkCmdBindPipeline      = record_nothing;
+        d.vkCmdBindShadersEXT    = record_nothing;
+        d.vkCmdBindVertexBuffers = record_nothing;
+        d.vkCmdDrawIndexed       = record_nothing;
+
+        d.vkCmdSetViewport                = record_nothing;
+        d.vkCmdSetScissor                 = record_nothing;
+        d.vkCmdSetViewportWithCount       = record_nothing;
+        d.vkCmdSetScissorWithCount        = record_nothing;
+        d.vkCmdSetCullMode                = record_nothing;
+        d.vkCmdSetFrontFace               = record_nothing;
+        d.vkCmdSetPrimitiveTopology       = record_nothing;
+        d.vkCmdSetPrimitiveRestartEnable  = record_nothing;
+        d.vkCmdSetRasterizerDiscardEnable = record_nothing;
+        d.vkCmdSetDepthBiasEnable         = record_nothing;
+        d.vkCmdSetDepthBias               = record_nothing;
+        d.vkCmdSetDepthTestEnable         = record_nothing;
+        d.vkCmdSetDepthWriteEnable        = record_nothing;
+        d.vkCmdSetDepthCompareOp          = record_nothing;
+        d.vkCmdSetDepthBoundsTestEnable   = record_nothing;
+        d.vkCmdSetStencilTestEnable       = record_nothing;
+        d.vkCmdSetStencilOp               = record_nothing;
+        d.vkCmdSetStencilCompareMask      = record_nothing;
+        d.vkCmdSetStencilWriteMask        = record_nothing;
+        d.vkCmdSetStencilReference        = record_nothing;
+        d.vkCmdSetLineWidth               = record_nothing;
+
+        d.vkCmdSetPolygonModeEXT           = record_nothing;
+        d.vkCmdSetDepthClampEnableEXT      = record_nothing;
+        d.vkCmdSetColorBlendEnableEXT      = record_nothing;
+        d.vkCmdSetColorBlendEquationEXT    = record_nothing;
+        d.vkCmdSetColorWriteMaskEXT        = record_nothing;
+        d.vkCmdSetVertexInputEXT           = record_nothing;
+        d.vkCmdSetRasterizationSamplesEXT  = record_nothing;
+        d.vkCmdSetSampleMaskEXT            = record_nothing;
+        d.vkCmdSetAlphaToCoverageEnableEXT = record_nothing;
+    }
+
+    // a grid of instances drifting back and forth, so some move in and out of view every frame
+    glm::vec4 instance_position(const uint32_t i, const uint32_t frame) {
+        const float drift = static_cast<float>(frame % 64) / 64.0f - 0.5f;
+        return {static_cast<float>(i % 64) / 16.0f - 2.0f + drift, static_cast<float>(i / 64) / 16.0f - 2.0f, 0.5f, 1.0f};
+    }
+} // namespace
+
+int main() {
+    stub_vulkan();
+
+    vke::DeviceFeatures features;
+    features.dynamic_polygon_mode = true;
+    features.dynamic_depth_clamp  = true;
+    features.dynamic_color_blend  = true;
+    features.shader_object        = true;
+
+    const vk::Device        device(fake_handle<VkDevice>(1));
+    const vk::CommandBuffer cmd(fake_handle<VkCommandBuffer>(1));
+    const vk::Pipeline      pipeline(fake_handle<VkPipeline>(1));
+    const vk::Buffer        vertex_buffer(fake_handle<VkBuffer>(1));
+    const vk::Image         swapchain_image(fake_handle<VkImage>(1));
+    const vk::ImageView     swapchain_view(fake_handle<VkImageView>(1));
+    const vk::Rect2D        area({0, 0}, {1280, 720});
+    const vk::Viewport      viewport(0.0f, 0.0f, 1280.0f, 720.0f, 0.0f, 1.0f);
+
+    const std::vector<vke::VertexBufferBinding> vertex_bindings = {
+        {0, 32, vk::VertexInputRate::eVertex, {{0, vk::Format::eR32G32B32Sfloat, 0}, {1, vk::Format::eR32G32B32Sfloat, 12}, {2, vk::Format::eR32G32Sfloat, 24}}},
+        {1, 64, vk::VertexInputRate::eInstance, {{3, vk::Format::eR32G32B32A32Sfloat, 0}, {4, vk::Format::eR32G32B32A32Sfloat, 16}, {5, vk::Format::eR32G32B32A32Sfloat, 32},
+                                                 {6, vk::Format::eR32G32B32A32Sfloat, 48}}},
+    };
+
+    vke::GraphicsPipelineBuilder render_state;
+    render_state.dynamic_states          = vke::extended_dynamic_states(features);
+    render_state.vertex_buffer_bindings  = vertex_bindings;
+    render_state.color_blend_attachments = {vke::ColorBlendAttachment{}};
+
+    vke::ShaderRenderState shader_render_state;
+    shader_render_state.vertex_buffer_bindings  = vertex_bindings;
+    shader_render_state.color_blend_attachments = {vke::ColorBlendAttachment{}};
+    shader_render_state.depth_test              = vke::DepthTest{};
+
+    const std::vector<uint32_t> code(16);
+    const std::array            sources = {
+        vke::ShaderObjectSource{code, {.stage = vk::ShaderStageFlagBits::eVertex, .next_stages = vk::ShaderStageFlagBits::eFragment}},
+        vke::ShaderObjectSource{code, {.stage = vk::ShaderStageFlagBits::eFragment}},
+    };
+    const auto shader_objects = vke::ShaderObject::create_linked(device, sources);
+
+    const std::array<vke::InstanceStream, 1> instance_streams = {vke::InstanceStream{vertex_buffer, 0}};
+
+    const vke::SimpleRenderer renderer(features);
+    vke::TrackedImage         image(swapchain_image, vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1));
+
+    vke::InstanceStore           store;
+    std::vector<vke::InstanceId> ids;
+    std::vector<glm::mat4>       transforms(INSTANCE_COUNT, glm::mat4(1.0f));
+    for (uint32_t i = 0; i < INSTANCE_COUNT; i++) {
+        transforms[i][3] = instance_position(i, 0);
+        ids.push_back(store.add(transforms[i], {glm::vec3(0.0f), 0.05f}, 0, i % 4));
+    }
+
+    vke::Bvh bvh;
+    bvh.build(store);
+
+    // identity view projection, so the frustum is the clip space box
+    const vke::Frustum    frustum = vke::Frustum::from_matrix(glm::mat4(1.0f));
+    std::vector<uint32_t> visible;
+    std::vector<uint32_t> bvh_visible;
+
+    vke::JobSystem jobs({.worker_count = 2, .pin_threads = false});
+
+    uint64_t   draw_count   = 0;
+    const auto render_frame = [&](const uint32_t frame) {
+        vke::JobCounter animated;
+        jobs.parallel_for(
+            INSTANCE_COUNT, 256,
+            [&](const uint32_t begin, const uint32_t end) {
+                for (uint32_t i = begin; i < end; i++) {
+                    transforms[i][3] = instance_position(i, frame);
+                }
+            },
+            animated);
+        jobs.wait(animated);
+
+        for (uint32_t i = 0; i < INSTANCE_COUNT; i++) {
+            store.set_transform(ids[i], transforms[i]);
+        }
+        bvh.refit(store);
+        store.cull(frustum, visible);
+        bvh.cull(frustum, store, bvh_visible);
+
+        vke::record_single_use_commands(
+            cmd,
+            [&](const vk::CommandBuffer &c) {
+                image.set_layout(vk::ImageLayout::eUndefined);
+                image.transition(c, vk::PipelineStageFlagBits2::eTopOfPipe, vk::PipelineStageFlagBits2::eColorAttachmentOutput, vk::ImageLayout::eColorAttachmentOptimal,
+                                 vk::AccessFlagBits2::eColorAttachmentWrite, 0);
+
+                renderer.render(c, swapchain_view, area, [&](vke::ActiveRenderer &&r) {
+                    // the first half of the draws through a pipeline, the rest through shader objects
+                    r.bind_graphics_pipeline(pipeline);
+                    r.set_viewport(viewport);
+                    r.set_scissor(area);
+                    render_state.cull_mode = frame % 2 == 0 ? vk::CullModeFlagBits::eBack : vk::CullModeFlagBits::eNone;
+                    r.set_dynamic_state(render_state);
+
+                    const size_t half = visible.size() / 2;
+                    for (size_t i = 0; i < visible.size(); i++) {
+                        if (i == half) {
+                            r.bind_shaders(shader_objects);
+                            r.set_viewport(viewport);
+                            r.set_scissor(area);
+                            r.set_render_state(shader_render_state);
+                        }
+
+                        r->bindVertexBuffers(0, vertex_buffer, vk::DeviceSize{0});
+                        r.bind_instance_streams(instance_streams);
+                        r->drawIndexed(36, 1, 0, 0, visible[i]);
+                        draw_count++;
+                    }
+                });
+
+                image.transition(c, vk::PipelineStageFlagBits2::eColorAttachmentOutput, vk::PipelineStageFlagBits2::eBottomOfPipe, vk::ImageLayout::ePresentSrcKHR,
+                                 vk::AccessFlagBits2::eNone, 0);
+            },
+            true);
+    };
+
+    uint32_t frame = 0;
+    for (; frame < WARMUP_FRAMES; frame++) {
+        render_frame(frame);
+    }
+
+    const uint64_t before = g_allocations.load(std::memory_order_relaxed);
+    for (; frame < WARMUP_FRAMES + TEST_FRAMES; frame++) {
+        render_frame(frame);
+    }
+    const uint64_t allocations = g_allocations.load(std::memory_order_relaxed) - before;
+
+    std::cout << TEST_FRAMES << " frames after " << WARMUP_FRAMES << " warmup frames (" << draw_count << " draws, " << bvh_visible.size() << " visible through the bvh): "
+              << allocations << " heap allocations\n";
+    if (allocations != 0) {
+        std::cerr << "steady state frames allocated from the heap\n";
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,101 @@
+// measures JobSystem throughput and how it scales with the number of workers
+// usage: job_bench [max workers] (defaults to the hardware thread count)
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+#include "vke/job_system.hpp"
+
+namespace {
+    constexpr uint32_t JOB_COUNT   = 1 << 18;
+    constexpr uint32_t SMALL_WORK  = 2000; // iterations of busy work in a small job, about a microsecond
+    constexpr uint32_t REPETITIONS = 5;    // the best run counts, to skip warmup and noise
+
+    std::atomic<uint64_t> g_sink = 0;
+
+    void small_work(const uint32_t seed) {
+        uint64_t value = seed;
+        for (uint32_t i = 0; i < SMALL_WORK; i++) {
+            value = value * 6364136223846793005ull + 1442695040888963407ull;
+        }
+        g_sink.fetch_add(value & 1, std::memory_order_relaxed);
+    }
+
+    template <typename F>
+    double best_seconds(F &&f) {
+        double best = 1e30;
+        for (uint32_t i = 0; i < REPETITIONS; i++) {
+            const auto start = std::chrono::steady_clock::now();
+            f();
+            best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        }
+        return best;
+    }
+
+    // jobs queued from outside the workers, through the shared queue
+    double empty_injected(vke::JobSystem &jobs) {
+        return best_seconds([&] {
+            vke::JobCounter counter;
+            for (uint32_t i = 0; i < JOB_COUNT; i++) {
+                jobs.run([] {}, &counter);
+            }
+            jobs.wait(counter);
+        });
+    }
+
+    // jobs queued from inside a job, onto a worker's own deque and stolen from there
+    double empty_spawned(vke::JobSystem &jobs) {
+        return best_seconds([&] {
+            vke::JobCounter counter;
+            constexpr uint32_t spawners = 64;
+            for (uint32_t i = 0; i < spawners; i++) {
+                jobs.run(
+                    [&] {
+                        for (uint32_t j = 0; j < JOB_COUNT / spawners; j++) {
+                            jobs.run([] {}, &counter);
+                        }
+                    },
+                    &counter);
+            }
+            jobs.wait(counter);
+        });
+    }
+
+    double small_jobs(vke::JobSystem &jobs) {
+        return best_seconds([&] {
+            vke::JobCounter counter;
+            jobs.parallel_for(JOB_COUNT / 8, 1, [](const uint32_t begin, uint32_t) { small_work(begin); }, counter);
+            jobs.wait(counter);
+        });
+    }
+} // namespace
+
+int main(const int argc, char **argv) {
+    const uint32_t max_workers = argc > 1 ? static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10)) : std::max(std::thread::hardware_concurrency(), 1u);
+
+    std::cout << "jobs per second, the waiting thread helps too so there's one more thread running jobs than workers\n";
+    std::cout << std::setw(8) << "workers" << std::setw(16) << "empty queued" << std::setw(16) << "empty spawned" << std::setw(16) << "small" << std::setw(10) << "scaling"
+              << '\n';
+
+    double single_worker_small = 0.0;
+    for (uint32_t workers = 1; workers <= max_workers; workers++) {
+        vke::JobSystem jobs({.worker_count = workers});
+
+        const double injected = JOB_COUNT / empty_injected(jobs);
+        const double spawned  = (JOB_COUNT + 64) / empty_spawned(jobs);
+        const double small    = (JOB_COUNT / 8) / small_jobs(jobs);
+        if (workers == 1)
+            single_worker_small = small;
+
+        std::cout << std::setw(8) << workers << std::fixed << std::setprecision(0) << std::setw(16) << injected << std::setw(16) << spawned << std::setw(16) << small
+                  << std::setprecision(2) << std::setw(9) << small / single_worker_small << "x\n";
+    }
+
+    return g_sink.load() == UINT64_MAX ? 1 : 0; // keeps the busy work from being optimized out
+}
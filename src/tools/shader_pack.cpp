@@ -0,0 +1,115 @@
+// packs compiled spirv into a shader archive (see vke/shader_archive_format.hpp)
+// usage: shader_pack <archive> <name>=<spirv file>...
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "vke/shader_archive_format.hpp"
+
+namespace {
+    struct Shader {
+        std::string       name;
+        uint32_t          stage;
+        std::vector<char> code;
+    };
+
+    // VkShaderStageFlagBits values, so this doesn't need the vulkan headers
+    uint32_t stage_from_extension(const std::string &extension) {
+        if (extension == ".vert")
+            return 0x00000001;
+        if (extension == ".tesc")
+            return 0x00000002;
+        if (extension == ".tese")
+            return 0x00000004;
+        if (extension == ".geom")
+            return 0x00000008;
+        if (extension == ".frag")
+            return 0x00000010;
+        if (extension == ".comp")
+            return 0x00000020;
+        if (extension == ".task")
+            return 0x00000040;
+        if (extension == ".mesh")
+            return 0x00000080;
+        return 0;
+    }
+
+    uint64_t align_up(const uint64_t value, const uint64_t alignment) {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+} // namespace
+
+int main(const int argc, char **argv) {
+    if (argc < 2) {
+        std::cerr << "usage: shader_pack <archive> <name>=<spirv file>..." << std::endl;
+        return 1;
+    }
+
+    std::vector<Shader> shaders;
+    for (int i = 2; i < argc; i++) {
+        const std::string argument = argv[i];
+        const auto        split    = argument.find('=');
+        if (split == std::string::npos) {
+            std::cerr << "expected <name>=<spirv file>, got " << argument << std::endl;
+            return 1;
+        }
+
+        const std::string name = argument.substr(0, split);
+        std::ifstream     f(argument.substr(split + 1), std::ios::binary);
+        if (!f.is_open()) {
+            std::cerr << "failed to open " << argument.substr(split + 1) << std::endl;
+            return 1;
+        }
+
+        shaders.push_back(Shader{name, stage_from_extension(std::filesystem::path(name).extension().string()), {std::istreambuf_iterator(f), {}}});
+    }
+
+    // the loader binary searches by name
+    std::ranges::sort(shaders, {}, &Shader::name);
+
+    vke::ShaderArchiveHeader header{};
+    header.magic              = vke::SHADER_ARCHIVE_MAGIC;
+    header.version            = vke::SHADER_ARCHIVE_VERSION;
+    header.entry_count        = static_cast<uint32_t>(shaders.size());
+    header.entry_table_offset = align_up(sizeof(header), alignof(vke::ShaderArchiveEntry));
+
+    std::vector<vke::ShaderArchiveEntry> entries(shaders.size());
+    uint64_t                             offset = header.entry_table_offset + entries.size() * sizeof(vke::ShaderArchiveEntry);
+    for (size_t i = 0; i < shaders.size(); i++) {
+        entries[i].name_offset = static_cast<uint32_t>(offset);
+        entries[i].name_size   = static_cast<uint32_t>(shaders[i].name.size());
+        entries[i].stage       = shaders[i].stage;
+        offset += shaders[i].name.size();
+    }
+
+    for (size_t i = 0; i < shaders.size(); i++) {
+        offset                 = align_up(offset, vke::SHADER_ARCHIVE_ALIGNMENT);
+        entries[i].code_offset = offset;
+        entries[i].code_size   = shaders[i].code.size();
+        offset += shaders[i].code.size();
+    }
+    header.file_size = offset;
+
+    std::vector<char> archive(header.file_size, 0);
+    std::memcpy(archive.data(), &header, sizeof(header));
+    std::memcpy(archive.data() + header.entry_table_offset, entries.data(), entries.size() * sizeof(vke::ShaderArchiveEntry));
+    for (size_t i = 0; i < shaders.size(); i++) {
+        std::ranges::copy(shaders[i].name, archive.data() + entries[i].name_offset);
+        std::ranges::copy(shaders[i].code, archive.data() + entries[i].code_offset);
+    }
+
+    std::ofstream out(argv[1], std::ios::binary | std::ios::trunc);
+    out.write(archive.data(), static_cast<std::streamsize>(archive.size()));
+    if (!out) {
+        std::cerr << "failed to write " << argv[1] << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
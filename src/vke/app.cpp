@@ -2,6 +2,12 @@
 
 #include <spdlog/sinks/stdout_color_sinks.h>
 
+#include <algorithm>
+#include <array>
+#include <iterator>
+
+#include "vke/shader_archive.hpp"
+
 namespace vke {
     App::App() {
         auto sink = std::make_shared<spdlog::sinks::stdout_color_sink_mt>();
@@ -24,24 +30,40 @@ namespace vke {
 
         glfwSetWindowUserPointer(m_window, this);
 
-        m_simple_renderer = std::make_shared<SimpleRenderer>();
+        m_simple_renderer = std::make_shared<SimpleRenderer>(m_render_context->features());
         m_simple_renderer->set_clear_color({0.0f, 1.0f, 0.0f, 1.0f});
 
-        m_vertex_module   = m_render_context->load_shader_module("res/shader.vert", SourceType::GLSL);
+#ifdef VKE_SHADER_ARCHIVE_PATH
+        const ShaderArchive shaders(ShaderArchive::locate(VKE_SHADER_ARCHIVE_PATH));
+        m_vertex_module   = shaders.create_module(m_render_context->device(), USE_VERTEX_PULLING ? "shader_pulled.vert" : "shader.vert");
+        m_fragment_module = shaders.create_module(m_render_context->device(), "shader.frag");
+#else
+        m_vertex_module   = m_render_context->load_shader_module(USE_VERTEX_PULLING ? "res/shader_pulled.vert" : "res/shader.vert", SourceType::GLSL);
         m_fragment_module = m_render_context->load_shader_module("res/shader.frag", SourceType::GLSL);
-
-        m_pipeline_layout = m_render_context->device().createPipelineLayout({});
+#endif
+
+        if (m_render_context->features().descriptor_indexing) {
+            m_descriptor_heap = std::make_unique<DescriptorHeap>(m_render_context);
+            m_pipeline_layout = m_descriptor_heap->pipeline_layout();
+        } else {
+            // no bindless heap, just the same push constants so everything else stays the same
+            spdlog::warn("Descriptor indexing isn't supported, drawing without the descriptor heap");
+            const vk::PushConstantRange push_constant_range(DescriptorHeap::PUSH_CONSTANT_STAGES, 0, DescriptorHeap::PUSH_CONSTANT_SIZE);
+            m_pipeline_layout = m_render_context->device().createPipelineLayout(vk::PipelineLayoutCreateInfo({}, {}, push_constant_range));
+        }
 
         GraphicsPipelineBuilder builder{};
-        builder.vertex_buffer_bindings = {VertexBufferBinding{
-            0,
-            sizeof(glm::vec4),
-            vk::VertexInputRate::eVertex,
-            {
-                VertexBufferAttribute{0, vk::Format::eR32G32Sfloat, 0},
-                VertexBufferAttribute{1, vk::Format::eR32G32Sfloat, sizeof(float) * 2},
-            },
-        }};
+        if (!USE_VERTEX_PULLING) {
+            builder.vertex_buffer_bindings = {VertexBufferBinding{
+                0,
+                sizeof(glm::vec4),
+                vk::VertexInputRate::eVertex,
+                {
+                    VertexBufferAttribute{0, vk::Format::eR32G32Sfloat, 0},
+                    VertexBufferAttribute{1, vk::Format::eR32G32Sfloat, sizeof(float) * 2},
+                },
+            }};
+        }
 
         builder.stages = {
             ShaderStage{vk::ShaderStageFlagBits::eVertex, "main", m_vertex_module},
@@ -51,6 +73,8 @@ namespace vke {
             vk::DynamicState::eViewport,
             vk::DynamicState::eScissor,
         };
+        // one pipeline covers every cull mode, blend setting, etc. set_dynamic_state applies the builder's values when drawing
+        std::ranges::copy(extended_dynamic_states(m_render_context->features()), std::back_inserter(builder.dynamic_states));
         builder.viewports = {
             m_render_context->swapchain_viewport(),
         };
@@ -63,7 +87,65 @@ namespace vke {
         builder.dynamic_rendering_info = {.color_formats = {m_render_context->swapchain_configuration().format}};
         builder.layout                 = m_pipeline_layout;
 
-        m_pipeline = std::make_unique<GraphicsPipeline>(m_render_context->device(), builder);
+        m_render_state = builder;
+
+#ifdef VKE_RUNTIME_SHADER_COMPILER
+        // edits to the glsl in res/ show up without restarting
+        m_shader_reloader = std::make_unique<ShaderHotReloader>(m_render_context);
+        m_pipeline        = m_shader_reloader->watch(builder, {USE_VERTEX_PULLING ? "res/shader_pulled.vert" : "res/shader.vert", "res/shader.frag"});
+#else
+        m_pipeline = std::make_shared<ReloadablePipeline>(std::make_shared<GraphicsPipeline>(m_render_context->device(), builder));
+#endif
+
+        if (PREFER_SHADER_OBJECTS && m_render_context->features().shader_object) {
+            const auto shader_code = [&](const std::string &name) {
+#ifdef VKE_SHADER_ARCHIVE_PATH
+                const auto index = shaders.find(name);
+                if (!index.has_value())
+                    throw std::runtime_error("Shader '" + name + "' isn't in the shader archive.");
+
+                const auto code = shaders.code(*index);
+                return std::vector<uint32_t>(code.begin(), code.end());
+#else
+                return m_render_context->load_shader_code("res/" + name, SourceType::GLSL);
+#endif
+            };
+
+            const auto vertex_code   = shader_code(USE_VERTEX_PULLING ? "shader_pulled.vert" : "shader.vert");
+            const auto fragment_code = shader_code("shader.frag");
+
+            ShaderObjectInfo info{
+                .stage                = vk::ShaderStageFlagBits::eVertex,
+                .next_stages          = vk::ShaderStageFlagBits::eFragment,
+                .push_constant_ranges = {vk::PushConstantRange{DescriptorHeap::PUSH_CONSTANT_STAGES, 0, DescriptorHeap::PUSH_CONSTANT_SIZE}},
+            };
+            if (m_descriptor_heap)
+                info.set_layouts = {m_descriptor_heap->set_layout()};
+            ShaderObjectInfo fragment_info = info;
+            fragment_info.stage            = vk::ShaderStageFlagBits::eFragment;
+            fragment_info.next_stages      = {};
+
+            const std::array sources = {
+                ShaderObjectSource{vertex_code, info},
+                ShaderObjectSource{fragment_code, fragment_info},
+            };
+            m_shader_objects = ShaderObject::create_linked(m_render_context->device(), sources);
+
+            m_shader_render_state.vertex_buffer_bindings    = builder.vertex_buffer_bindings;
+            m_shader_render_state.topology                  = builder.topology;
+            m_shader_render_state.enable_primitive_restart  = builder.enable_primitive_restart;
+            m_shader_render_state.discard_rasterizer_output = builder.discard_rasterizer_output;
+            m_shader_render_state.polygon_mode              = builder.polygon_mode;
+            m_shader_render_state.cull_mode                 = builder.cull_mode;
+            m_shader_render_state.front_face                = builder.front_face;
+            m_shader_render_state.line_width                = builder.line_width;
+            m_shader_render_state.depth_bias                = builder.depth_bias;
+            m_shader_render_state.rasterization_samples     = builder.rasterization_samples;
+            m_shader_render_state.enable_alpha_to_coverage  = builder.enable_alpha_to_coverage;
+            m_shader_render_state.color_blend_attachments   = builder.color_blend_attachments;
+
+            spdlog::info("Drawing with shader objects");
+        }
 
         std::vector<glm::vec4> vertices = {
             {-0.5f, 0.5f, -1.0f, -1.0f}, // bl
@@ -74,7 +156,7 @@ namespace vke {
 
         std::vector<uint16_t> indices = {0, 1, 2, 0, 2, 3};
 
-        m_mesh = Mesh::create(m_render_context, vertices, indices, MeshType::Static, {.index_type = vk::IndexType::eUint16});
+        m_mesh = Mesh::create(m_render_context, vertices, indices, MeshType::Static, {.index_type = vk::IndexType::eUint16, .vertex_pulling = USE_VERTEX_PULLING});
     }
 
     App::~App() {
@@ -82,10 +164,16 @@ namespace vke {
 
         m_mesh.reset();
 
+        m_shader_objects.clear();
         m_pipeline.reset();
+        m_shader_reloader.reset();
         m_render_context->device().destroy(m_vertex_module);
         m_render_context->device().destroy(m_fragment_module);
-        m_render_context->device().destroy(m_pipeline_layout);
+        if (m_descriptor_heap) {
+            m_descriptor_heap.reset();
+        } else {
+            m_render_context->device().destroy(m_pipeline_layout);
+        }
 
         m_render_context.reset();
 
@@ -105,6 +193,9 @@ namespace vke {
     }
 
     void App::render() {
+        if (m_shader_reloader)
+            m_shader_reloader->update();
+
         m_render_context->render_frame(m_window, [&](const FrameInfo &frame_info) {
             if (frame_info.swapchain_reloaded)
                 reload_image_tracking();
@@ -120,10 +211,25 @@ namespace vke {
                                                                         m_render_context->queue_families().graphics);
 
                     m_simple_renderer->render(cmd, frame_info.image_view, m_render_context->swapchain_area(), [&](ActiveRenderer &&r) {
-                        r.bind_graphics_pipeline(m_pipeline);
-                        r->setViewport(0, m_render_context->swapchain_viewport());
-                        r->setScissor(0, m_render_context->swapchain_area());
-                        r.bind_mesh(m_mesh);
+                        if (m_shader_objects.empty()) {
+                            r.bind_graphics_pipeline(m_pipeline->get());
+                        } else {
+                            r.bind_shaders(m_shader_objects);
+                        }
+                        if (m_descriptor_heap)
+                            r.bind_descriptor_heap(*m_descriptor_heap);
+                        r.set_viewport(m_render_context->swapchain_viewport());
+                        r.set_scissor(m_render_context->swapchain_area());
+                        if (m_shader_objects.empty()) {
+                            r.set_dynamic_state(m_render_state);
+                        } else {
+                            r.set_render_state(m_shader_render_state);
+                        }
+                        if (USE_VERTEX_PULLING) {
+                            r.bind_pulled_mesh(m_mesh, m_pipeline_layout, DescriptorHeap::PUSH_CONSTANT_STAGES);
+                        } else {
+                            r.bind_mesh(m_mesh);
+                        }
                         r->drawIndexed(6, 1, 0, 0, 0);
                     });
 
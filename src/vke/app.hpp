@@ -2,8 +2,11 @@
 #include <GLFW/glfw3.h>
 #include <spdlog/spdlog.h>
 
+#include "vke/descriptor_heap.hpp"
 #include "vke/render_context.hpp"
 #include "vke/renderer.hpp"
+#include "vke/shader_hot_reload.hpp"
+#include "vke/shader_object.hpp"
 #include "vke/state_track.hpp"
 #include "vke/mesh.hpp"
 
@@ -18,6 +21,12 @@ namespace vke {
         void render();
 
       private:
+        // draws through ActiveRenderer::bind_pulled_mesh instead of the fixed function vertex input
+        static constexpr bool USE_VERTEX_PULLING = false;
+
+        // draws with shader objects instead of m_pipeline when the device supports them. set to false to benchmark against the pipeline path
+        static constexpr bool PREFER_SHADER_OBJECTS = true;
+
         GLFWwindow *m_window;
 
         std::shared_ptr<spdlog::logger> m_logger;
@@ -28,8 +37,14 @@ namespace vke {
         vk::ShaderModule m_vertex_module;
         vk::ShaderModule m_fragment_module;
 
-        vk::PipelineLayout                m_pipeline_layout;
-        std::unique_ptr<GraphicsPipeline> m_pipeline;
+        std::unique_ptr<DescriptorHeap>     m_descriptor_heap; // null on devices without descriptor indexing
+        vk::PipelineLayout                  m_pipeline_layout; // owned by the descriptor heap if there is one
+        std::unique_ptr<ShaderHotReloader>  m_shader_reloader; // only with the runtime shader compiler
+        std::shared_ptr<ReloadablePipeline> m_pipeline;
+        GraphicsPipelineBuilder             m_render_state; // the dynamic state values to draw with
+
+        std::vector<std::shared_ptr<ShaderObject>> m_shader_objects; // empty unless drawing with shader objects
+        ShaderRenderState                          m_shader_render_state;
 
         std::unique_ptr<Mesh> m_mesh;
 
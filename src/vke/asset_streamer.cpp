@@ -0,0 +1,273 @@
+#include "asset_streamer.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include "vke/mesh_pack.hpp"
+
+namespace vke {
+    // the heap keeps the highest priority at the front, oldest first within a priority
+    static bool request_order(const auto &a, const auto &b) {
+        return a.priority < b.priority || (a.priority == b.priority && a.sequence > b.sequence);
+    }
+
+    static constexpr vk::AccessFlags        MESH_READ_ACCESS = vk::AccessFlagBits::eVertexAttributeRead | vk::AccessFlagBits::eIndexRead | vk::AccessFlagBits::eShaderRead;
+    static constexpr vk::PipelineStageFlags MESH_READ_STAGES = vk::PipelineStageFlagBits::eVertexInput | vk::PipelineStageFlagBits::eVertexShader;
+
+    AssetStreamer::AssetStreamer(const std::shared_ptr<RenderContext> &rc, const AssetStreamerSettings &settings)
+        : m_rc(rc), m_settings(settings), m_transfers_ownership(rc->queue_families().transfer != rc->queue_families().graphics) {
+        m_pool = m_rc->device().createCommandPool(vk::CommandPoolCreateInfo(vk::CommandPoolCreateFlagBits::eResetCommandBuffer, m_rc->queue_families().transfer));
+
+        m_workers.reserve(m_settings.worker_count);
+        for (uint32_t i = 0; i < std::max(m_settings.worker_count, 1u); i++) {
+            m_workers.emplace_back([this](const std::stop_token &stop) { worker(stop); });
+        }
+    }
+
+    AssetStreamer::~AssetStreamer() {
+        for (auto &worker : m_workers) {
+            worker.request_stop();
+        }
+        m_workers.clear(); // joins
+
+        const auto device = m_rc->device();
+        for (auto &batch : m_in_flight) {
+            auto _ = device.waitForFences(batch.fence, true, UINT64_MAX);
+            for (const auto &mesh : batch.meshes) {
+                destroy_buffers(mesh);
+            }
+            m_free_batches.push_back(std::move(batch));
+        }
+
+        for (const auto &mesh : m_staged) {
+            destroy_buffers(mesh);
+        }
+
+        for (const auto &batch : m_free_batches) {
+            device.destroy(batch.fence);
+        }
+        device.destroy(m_pool);
+    }
+
+    void AssetStreamer::request(MeshLoader loader, MeshLoadedCallback callback, const int priority) {
+        {
+            std::lock_guard lock(m_mutex);
+            m_requests.push_back(Request{priority, m_next_sequence++, std::move(loader), std::move(callback)});
+            std::ranges::push_heap(m_requests, request_order<Request, Request>);
+        }
+        m_request_cv.notify_one();
+    }
+
+    void AssetStreamer::request(const std::shared_ptr<const MeshPack> &pack, const uint32_t mesh, MeshLoadedCallback callback, const int priority,
+                                const ExtraMeshSettings &extra_mesh_settings) {
+        request(
+            [pack, mesh, extra_mesh_settings] {
+                // the mapping is read straight into staging memory, so get the os reading ahead first
+                pack->file().prefetch(pack->entry(mesh).vertex_offset, pack->entry(mesh).vertex_size);
+                pack->file().prefetch(pack->entry(mesh).index_offset, pack->entry(mesh).index_size);
+                return MeshSourceData{pack->vertex_data(mesh), pack->index_data(mesh), pack->mesh_settings(mesh, extra_mesh_settings), pack};
+            },
+            std::move(callback), priority);
+    }
+
+    void AssetStreamer::update() {
+        const auto device = m_rc->device();
+
+        // finish uploads first so their batches can be reused right away
+        for (auto it = m_in_flight.begin(); it != m_in_flight.end();) {
+            if (device.getFenceStatus(it->fence) != vk::Result::eSuccess) {
+                ++it;
+                continue;
+            }
+
+            complete(*it);
+            m_free_batches.push_back(std::move(*it));
+            it = m_in_flight.erase(it);
+        }
+
+        std::vector<MeshLoadedCallback> failed;
+        std::vector<StagedMesh>         ready;
+        {
+            std::lock_guard lock(m_mutex);
+            failed.swap(m_failed);
+
+            // the highest priorities go first, the rest wait for the next update
+            std::ranges::stable_sort(m_staged, std::greater{}, &StagedMesh::priority);
+
+            vk::DeviceSize bytes = 0;
+            size_t         count = 0;
+            while (count < m_staged.size() && (count == 0 || bytes + m_staged[count].staging.size <= m_settings.max_bytes_per_update)) {
+                bytes += m_staged[count++].staging.size;
+            }
+
+            ready.assign(std::make_move_iterator(m_staged.begin()), std::make_move_iterator(m_staged.begin() + static_cast<ptrdiff_t>(count)));
+            m_staged.erase(m_staged.begin(), m_staged.begin() + static_cast<ptrdiff_t>(count));
+        }
+
+        for (const auto &callback : failed) {
+            callback(nullptr);
+        }
+
+        if (!ready.empty()) {
+            submit(std::move(ready));
+        }
+    }
+
+    size_t AssetStreamer::pending() const {
+        std::lock_guard lock(m_mutex);
+        return m_requests.size() + m_loading + m_staged.size() + m_failed.size() + m_uploading;
+    }
+
+    void AssetStreamer::worker(const std::stop_token &stop) {
+        while (true) {
+            Request request;
+            {
+                std::unique_lock lock(m_mutex);
+                if (!m_request_cv.wait(lock, stop, [this] { return !m_requests.empty(); }))
+                    return;
+
+                std::ranges::pop_heap(m_requests, request_order<Request, Request>);
+                request = std::move(m_requests.back());
+                m_requests.pop_back();
+                m_loading++;
+            }
+
+            try {
+                StagedMesh staged = stage(request.loader());
+                staged.priority   = request.priority;
+                staged.callback   = std::move(request.callback);
+
+                std::lock_guard lock(m_mutex);
+                m_staged.push_back(std::move(staged));
+                m_loading--;
+            } catch (const std::exception &e) {
+                spdlog::error("Failed to load a streamed mesh: {}", e.what());
+
+                std::lock_guard lock(m_mutex);
+                m_failed.push_back(std::move(request.callback));
+                m_loading--;
+            }
+        }
+    }
+
+    AssetStreamer::StagedMesh AssetStreamer::stage(const MeshSourceData &data) const {
+        const vk::DeviceSize vertex_size = data.vertex_data.size();
+        const vk::DeviceSize index_size  = data.index_data.size();
+        if (vertex_size == 0) {
+            throw std::runtime_error("Streamed meshes need vertex data.");
+        }
+
+        StagedMesh staged{};
+        staged.settings = data.settings;
+
+        staged.staging = m_rc->create_buffer(vertex_size + index_size, nullptr, MemoryUsage::Auto, vk::BufferUsageFlagBits::eTransferSrc,
+                                             {.access_mode = MemoryAccessMode::Sequential, .category = AllocationCategory::Staging, .persistently_mapped = true});
+
+        auto *mapped = static_cast<std::byte *>(staged.staging.allocation_info.pMappedData);
+        std::memcpy(mapped, data.vertex_data.data(), vertex_size);
+        if (index_size > 0) {
+            std::memcpy(mapped + vertex_size, data.index_data.data(), index_size);
+        }
+        vmaFlushAllocation(m_rc->allocator(), staged.staging.allocation, 0, VK_WHOLE_SIZE);
+
+        // with separate families the buffers are released to the graphics family after the copy, so they don't need to be shared
+        const BufferOptions options{
+            .queue_families = m_transfers_ownership ? std::vector<uint32_t>{} : m_rc->graphics_transfer_queue_families(),
+            .category       = AllocationCategory::Mesh,
+            .residency      = data.settings.residency,
+        };
+
+        staged.vertex_buffer = m_rc->create_buffer(vertex_size, nullptr, MemoryUsage::DeviceOnly, Mesh::vertex_buffer_usage(data.settings), options);
+        if (index_size > 0) {
+            staged.index_buffer = m_rc->create_buffer(index_size, nullptr, MemoryUsage::DeviceOnly, Mesh::index_buffer_usage(data.settings), options);
+        }
+
+        return staged;
+    }
+
+    void AssetStreamer::submit(std::vector<StagedMesh> meshes) {
+        const auto device = m_rc->device();
+
+        UploadBatch batch;
+        if (!m_free_batches.empty()) {
+            batch = std::move(m_free_batches.back());
+            m_free_batches.pop_back();
+            device.resetFences(batch.fence);
+        } else {
+            batch.cmd   = device.allocateCommandBuffers(vk::CommandBufferAllocateInfo(m_pool, vk::CommandBufferLevel::ePrimary, 1))[0];
+            batch.fence = device.createFence({});
+        }
+
+        const auto families = m_rc->queue_families();
+        record_single_use_commands(
+            batch.cmd,
+            [&](const vk::CommandBuffer &cmd) {
+                std::vector<vk::BufferMemoryBarrier> releases;
+                for (const auto &mesh : meshes) {
+                    cmd.copyBuffer(mesh.staging.buffer, mesh.vertex_buffer.buffer, vk::BufferCopy(0, 0, mesh.vertex_buffer.size));
+                    if (mesh.index_buffer.has_value()) {
+                        cmd.copyBuffer(mesh.staging.buffer, mesh.index_buffer->buffer, vk::BufferCopy(mesh.vertex_buffer.size, 0, mesh.index_buffer->size));
+                    }
+
+                    if (!m_transfers_ownership)
+                        continue;
+
+                    releases.emplace_back(vk::AccessFlagBits::eTransferWrite, vk::AccessFlags{}, families.transfer, families.graphics, mesh.vertex_buffer.buffer, 0, vk::WholeSize);
+                    if (mesh.index_buffer.has_value()) {
+                        releases.emplace_back(vk::AccessFlagBits::eTransferWrite, vk::AccessFlags{}, families.transfer, families.graphics, mesh.index_buffer->buffer, 0,
+                                              vk::WholeSize);
+                    }
+                }
+
+                if (!releases.empty()) {
+                    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eBottomOfPipe, {}, {}, releases, {});
+                }
+            },
+            true);
+
+        m_rc->queues().transfer.submit(vk::SubmitInfo({}, {}, batch.cmd, {}), batch.fence);
+
+        {
+            std::lock_guard lock(m_mutex);
+            m_uploading += meshes.size();
+        }
+
+        batch.meshes = std::move(meshes);
+        m_in_flight.push_back(std::move(batch));
+    }
+
+    void AssetStreamer::complete(UploadBatch &batch) {
+        const auto families = m_rc->queue_families();
+
+        for (auto &mesh : batch.meshes) {
+            // without an ownership transfer this is just a barrier making the copy visible to vertex input
+            const uint32_t src_family = m_transfers_ownership ? families.transfer : vk::QueueFamilyIgnored;
+            const uint32_t dst_family = m_transfers_ownership ? families.graphics : vk::QueueFamilyIgnored;
+
+            m_rc->enqueue_ownership_acquire(vk::BufferMemoryBarrier({}, MESH_READ_ACCESS, src_family, dst_family, mesh.vertex_buffer.buffer, 0, vk::WholeSize), MESH_READ_STAGES);
+            if (mesh.index_buffer.has_value()) {
+                m_rc->enqueue_ownership_acquire(vk::BufferMemoryBarrier({}, MESH_READ_ACCESS, src_family, dst_family, mesh.index_buffer->buffer, 0, vk::WholeSize),
+                                                MESH_READ_STAGES);
+            }
+
+            // the copy has finished, so the staging buffer can go right away
+            m_rc->destroy_buffer(mesh.staging);
+
+            mesh.callback(Mesh::from_buffers(m_rc, mesh.vertex_buffer, mesh.index_buffer, mesh.settings, !m_transfers_ownership));
+        }
+
+        std::lock_guard lock(m_mutex);
+        m_uploading -= batch.meshes.size();
+        batch.meshes.clear();
+    }
+
+    void AssetStreamer::destroy_buffers(const StagedMesh &mesh) const {
+        m_rc->destroy_buffer(mesh.staging);
+        m_rc->destroy_buffer(mesh.vertex_buffer);
+        if (mesh.index_buffer.has_value()) {
+            m_rc->destroy_buffer(mesh.index_buffer.value());
+        }
+    }
+} // namespace vke
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include "vke/mesh.hpp"
+#include "vke/render_context.hpp"
+
+namespace vke {
+    class MeshPack;
+
+    // what a load request produces on a worker thread
+    struct MeshSourceData {
+        std::span<const std::byte> vertex_data;
+        std::span<const std::byte> index_data;
+        ExtraMeshSettings          settings;
+
+        // keeps whatever the spans point into alive until they have been copied into staging memory
+        std::shared_ptr<const void> owner;
+    };
+
+    using MeshLoader         = std::function<MeshSourceData()>;
+    using MeshLoadedCallback = std::function<void(std::shared_ptr<Mesh> mesh)>; // mesh is null if loading failed
+
+    struct AssetStreamerSettings {
+        uint32_t worker_count = 2;
+
+        // caps how much is submitted to the transfer queue per update, so a burst of requests is spread over several frames
+        vk::DeviceSize max_bytes_per_update = 64ull * 1024 * 1024;
+    };
+
+    /**
+     * @brief Streams meshes in on the transfer queue without blocking rendering.
+     *
+     * Requests are picked up by worker threads in priority order. A worker runs the request's loader (file I/O, decoding, etc), copies the result into a staging buffer and creates
+     * the device local destination buffers. update() then records the copies for everything staged so far into one transfer submission, which releases the buffers to the
+     * graphics family when it differs from the transfer family. Once the submission's fence signals the matching acquires are handed to RenderContext, which records them ahead of
+     * the next submit_for_rendering, and the callbacks get their meshes.
+     *
+     * When the transfer family differs from the graphics family the streamed buffers are owned exclusively by the graphics family, so the defragmenter leaves them alone.
+     */
+    class AssetStreamer {
+      public:
+        explicit AssetStreamer(const std::shared_ptr<RenderContext> &rc, const AssetStreamerSettings &settings = {});
+        ~AssetStreamer();
+
+        AssetStreamer(const AssetStreamer &other)                = delete;
+        AssetStreamer &operator=(const AssetStreamer &other)     = delete;
+        AssetStreamer(AssetStreamer &&other) noexcept            = delete;
+        AssetStreamer &operator=(AssetStreamer &&other) noexcept = delete;
+
+        // higher priorities are loaded first. the loader runs on a worker thread, the callback on the thread calling update.
+        void request(MeshLoader loader, MeshLoadedCallback callback, int priority = 0);
+        void request(const std::shared_ptr<const MeshPack> &pack, uint32_t mesh, MeshLoadedCallback callback, int priority = 0, const ExtraMeshSettings &extra_mesh_settings = {});
+
+        /**
+         * @brief Submits staged uploads and completes finished ones.
+         *
+         * Call this once per frame from inside RenderContext::render_frame, before the frame is submitted. Meshes handed to callbacks can be drawn in that same frame.
+         */
+        void update();
+
+        // requests which haven't been handed back yet
+        [[nodiscard]] size_t pending() const;
+
+      private:
+        struct Request {
+            int                priority;
+            uint64_t           sequence;
+            MeshLoader         loader;
+            MeshLoadedCallback callback;
+        };
+
+        struct StagedMesh {
+            int                       priority;
+            BufferInfo                staging;
+            BufferInfo                vertex_buffer;
+            std::optional<BufferInfo> index_buffer;
+            ExtraMeshSettings         settings;
+            MeshLoadedCallback        callback;
+        };
+
+        struct UploadBatch {
+            vk::CommandBuffer       cmd;
+            vk::Fence               fence;
+            std::vector<StagedMesh> meshes;
+        };
+
+        std::shared_ptr<RenderContext> m_rc;
+        AssetStreamerSettings          m_settings;
+        bool                           m_transfers_ownership;
+
+        // shared with the workers
+        mutable std::mutex              m_mutex;
+        std::condition_variable_any     m_request_cv;
+        std::vector<Request>            m_requests; // heap ordered by priority, then by request order
+        uint64_t                        m_next_sequence = 0;
+        size_t                          m_loading       = 0;
+        size_t                          m_uploading     = 0;
+        std::vector<StagedMesh>         m_staged;
+        std::vector<MeshLoadedCallback> m_failed;
+
+        // only touched by update
+        vk::CommandPool          m_pool;
+        std::vector<UploadBatch> m_in_flight;
+        std::vector<UploadBatch> m_free_batches;
+
+        std::vector<std::jthread> m_workers;
+
+        void       worker(const std::stop_token &stop);
+        StagedMesh stage(const MeshSourceData &data) const;
+        void       submit(std::vector<StagedMesh> meshes);
+        void       complete(UploadBatch &batch);
+        void       destroy_buffers(const StagedMesh &mesh) const;
+    };
+} // namespace vke
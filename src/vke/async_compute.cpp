@@ -0,0 +1,53 @@
+#include "async_compute.hpp"
+
+namespace vke {
+    AsyncComputeScheduler::AsyncComputeScheduler(const std::shared_ptr<RenderContext> &rc) : m_rc(rc) {
+        const auto device = m_rc->device();
+
+        m_pool            = device.createCommandPool(vk::CommandPoolCreateInfo(vk::CommandPoolCreateFlagBits::eResetCommandBuffer, m_rc->queue_families().compute));
+        m_command_buffers = device.allocateCommandBuffers(vk::CommandBufferAllocateInfo(m_pool, vk::CommandBufferLevel::ePrimary, RenderContext::MAX_FRAMES_IN_FLIGHT));
+
+        m_semaphores.resize(RenderContext::MAX_FRAMES_IN_FLIGHT);
+        for (auto &semaphore : m_semaphores) {
+            semaphore = device.createSemaphore({});
+        }
+    }
+
+    AsyncComputeScheduler::~AsyncComputeScheduler() {
+        const auto device = m_rc->device();
+
+        // the last submissions may still be running
+        m_rc->queues().compute.waitIdle();
+
+        for (const auto &semaphore : m_semaphores) {
+            device.destroy(semaphore);
+        }
+        device.destroy(m_pool);
+    }
+
+    void AsyncComputeScheduler::add_pass(std::function<void(const vk::CommandBuffer &cmd)> pass) {
+        m_passes.push_back(std::move(pass));
+    }
+
+    std::optional<SemaphoreWait> AsyncComputeScheduler::submit(const FrameInfo &frame_info, const vk::PipelineStageFlags graphics_wait_stages) {
+        if (m_passes.empty())
+            return std::nullopt;
+
+        // render_frame already waited on this frame's fence, and the graphics submission it guards waited on the compute work, so both are free again
+        const vk::CommandBuffer cmd       = m_command_buffers[frame_info.current_frame];
+        const vk::Semaphore     semaphore = m_semaphores[frame_info.current_frame];
+
+        record_single_use_commands(
+            cmd,
+            [this](const vk::CommandBuffer &c) {
+                for (const auto &pass : m_passes) {
+                    pass(c);
+                }
+            },
+            true);
+        m_passes.clear();
+
+        m_rc->queues().compute.submit(vk::SubmitInfo({}, {}, cmd, semaphore));
+        return SemaphoreWait{semaphore, graphics_wait_stages};
+    }
+} // namespace vke
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <functional>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "vke/render_context.hpp"
+
+namespace vke {
+    /**
+     * @brief Runs a frame's compute work on the compute queue so it can overlap with that frame's (or the previous frame's) rasterization.
+     *
+     * Each frame in flight has its own command buffer and semaphore. submit records and submits the frame's compute passes and returns a wait for the graphics submission, which
+     * has to be passed to RenderContext::submit_for_rendering for the same frame: the semaphore is binary, and the graphics fence is what tells us the command buffer can be
+     * reused.
+     *
+     * Resources written here and read by graphics (or the other way around) should be shared between both families (RenderContext::graphics_compute_queue_families), otherwise
+     * they need ownership transfers.
+     */
+    class AsyncComputeScheduler {
+      public:
+        explicit AsyncComputeScheduler(const std::shared_ptr<RenderContext> &rc);
+        ~AsyncComputeScheduler();
+
+        AsyncComputeScheduler(const AsyncComputeScheduler &other)                = delete;
+        AsyncComputeScheduler &operator=(const AsyncComputeScheduler &other)     = delete;
+        AsyncComputeScheduler(AsyncComputeScheduler &&other) noexcept            = delete;
+        AsyncComputeScheduler &operator=(AsyncComputeScheduler &&other) noexcept = delete;
+
+        // passes are recorded in the order they were added, into the next submit
+        void add_pass(std::function<void(const vk::CommandBuffer &cmd)> pass);
+
+        /**
+         * @param frame_info the frame being rendered
+         * @param graphics_wait_stages the first graphics stages which read results of the compute work
+         * @return what the frame's graphics submission has to wait on, or nothing if no passes were added
+         */
+        [[nodiscard]] std::optional<SemaphoreWait> submit(const FrameInfo &frame_info,
+                                                          vk::PipelineStageFlags graphics_wait_stages = vk::PipelineStageFlagBits::eVertexInput |
+                                                              vk::PipelineStageFlagBits::eVertexShader);
+
+      private:
+        std::shared_ptr<RenderContext> m_rc;
+
+        vk::CommandPool                m_pool;
+        std::vector<vk::CommandBuffer> m_command_buffers;
+        std::vector<vk::Semaphore>     m_semaphores;
+
+        std::vector<std::function<void(const vk::CommandBuffer &cmd)>> m_passes;
+    };
+} // namespace vke
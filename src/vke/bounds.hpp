@@ -0,0 +1,85 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+
+namespace vke {
+    struct BoundingSphere {
+        glm::vec3 center{0.0f};
+        float     radius = 0.0f;
+
+        // a sphere around this one after transform (which may scale, but not shear)
+        [[nodiscard]] inline BoundingSphere transformed(const glm::mat4 &transform) const {
+            const float scale2 = std::max({glm::dot(glm::vec3(transform[0]), glm::vec3(transform[0])), glm::dot(glm::vec3(transform[1]), glm::vec3(transform[1])),
+                                           glm::dot(glm::vec3(transform[2]), glm::vec3(transform[2]))});
+            return {glm::vec3(transform * glm::vec4(center, 1.0f)), radius * std::sqrt(scale2)};
+        }
+    };
+
+    struct Aabb {
+        glm::vec3 min{std::numeric_limits<float>::max()};
+        glm::vec3 max{std::numeric_limits<float>::lowest()}; // so an empty box grows into whatever is added first
+
+        [[nodiscard]] static inline Aabb from_sphere(const BoundingSphere &sphere) { return {sphere.center - sphere.radius, sphere.center + sphere.radius}; }
+
+        inline void grow(const glm::vec3 &point) {
+            min = glm::min(min, point);
+            max = glm::max(max, point);
+        }
+
+        inline void grow(const Aabb &other) {
+            min = glm::min(min, other.min);
+            max = glm::max(max, other.max);
+        }
+
+        [[nodiscard]] inline glm::vec3 center() const { return (min + max) * 0.5f; }
+
+        // 0 for an empty box
+        [[nodiscard]] inline float surface_area() const {
+            const glm::vec3 extent = glm::max(max - min, glm::vec3(0.0f));
+            return 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+        }
+    };
+
+    // six planes facing inwards (xyz is the normal, w the distance), so a point is inside when dot(plane.xyz, p) + plane.w >= 0 for all of them
+    struct Frustum {
+        enum Plane { Left, Right, Bottom, Top, Near, Far };
+
+        std::array<glm::vec4, 6> planes;
+
+        // vulkan clip space (depth from 0 to 1)
+        [[nodiscard]] static inline Frustum from_matrix(const glm::mat4 &view_projection) {
+            const auto row = [&](const int i) { return glm::vec4(view_projection[0][i], view_projection[1][i], view_projection[2][i], view_projection[3][i]); };
+
+            Frustum frustum{{row(3) + row(0), row(3) - row(0), row(3) + row(1), row(3) - row(1), row(2), row(3) - row(2)}};
+            for (auto &plane : frustum.planes) {
+                plane /= glm::length(glm::vec3(plane));
+            }
+
+            return frustum;
+        }
+
+        [[nodiscard]] inline bool intersects(const BoundingSphere &sphere) const {
+            return std::ranges::all_of(planes, [&](const glm::vec4 &plane) { return glm::dot(glm::vec3(plane), sphere.center) + plane.w >= -sphere.radius; });
+        }
+
+        // conservative, a box near a corner of the frustum can pass without touching it
+        [[nodiscard]] inline bool intersects(const Aabb &box) const {
+            return std::ranges::all_of(planes, [&](const glm::vec4 &plane) {
+                const glm::vec3 normal(plane);
+                return glm::dot(normal, glm::mix(box.min, box.max, glm::greaterThanEqual(normal, glm::vec3(0.0f)))) + plane.w >= 0.0f;
+            });
+        }
+
+        [[nodiscard]] inline bool contains(const Aabb &box) const {
+            return std::ranges::all_of(planes, [&](const glm::vec4 &plane) {
+                const glm::vec3 normal(plane);
+                return glm::dot(normal, glm::mix(box.max, box.min, glm::greaterThanEqual(normal, glm::vec3(0.0f)))) + plane.w >= 0.0f;
+            });
+        }
+    };
+} // namespace vke
@@ -0,0 +1,314 @@
+#include "bvh.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <span>
+
+namespace vke {
+    static constexpr uint32_t BIN_COUNT          = 16;
+    static constexpr uint32_t MAX_LEAF_SIZE      = 8;
+    static constexpr float    TRAVERSAL_COST     = 1.0f;  // relative to testing one primitive
+    static constexpr uint32_t PARALLEL_THRESHOLD = 16384; // smaller subtrees aren't worth a thread
+    static constexpr uint32_t MAX_DEPTH          = 64;    // nodes this deep are always leaves, so traversal stacks have a fixed size
+
+    // depth first traversal never has more than one pending sibling per level, plus the node being split
+    template <typename T>
+    using TraversalStack = std::array<T, MAX_DEPTH + 1>;
+
+    struct BuildPrimitive {
+        Aabb       bounds;
+        glm::vec3  centroid;
+        InstanceId id;
+    };
+
+    struct BuildContext {
+        std::span<BuildPrimitive> primitives;
+        std::span<BvhNode>        nodes;
+        std::atomic<uint32_t>     node_count;
+        uint32_t                  parallel_depth; // subtrees down to this depth are built on their own thread
+    };
+
+    struct SplitBinning {
+        uint32_t axis;
+        float    min;
+        float    scale; // bins per unit
+
+        [[nodiscard]] uint32_t bin(const glm::vec3 &centroid) const {
+            return std::min(static_cast<uint32_t>((centroid[static_cast<int>(axis)] - min) * scale), BIN_COUNT - 1);
+        }
+    };
+
+    struct Split {
+        SplitBinning binning;
+        uint32_t     last_left_bin;
+        float        cost;
+    };
+
+    static std::optional<Split> find_split(const std::span<const BuildPrimitive> primitives, const Aabb &centroid_bounds) {
+        std::optional<Split> best;
+        for (uint32_t axis = 0; axis < 3; axis++) {
+            const float extent = centroid_bounds.max[static_cast<int>(axis)] - centroid_bounds.min[static_cast<int>(axis)];
+            if (extent <= 0.0f)
+                continue;
+
+            const SplitBinning binning{axis, centroid_bounds.min[static_cast<int>(axis)], static_cast<float>(BIN_COUNT) / extent};
+
+            std::array<Aabb, BIN_COUNT>     bins{};
+            std::array<uint32_t, BIN_COUNT> counts{};
+            for (const auto &primitive : primitives) {
+                const uint32_t bin = binning.bin(primitive.centroid);
+                bins[bin].grow(primitive.bounds);
+                counts[bin]++;
+            }
+
+            // sweep from the right to get the cost of everything past each split, then from the left to add the rest
+            std::array<float, BIN_COUNT - 1> right_costs{};
+            Aabb                             right;
+            uint32_t                         right_count = 0;
+            for (uint32_t i = BIN_COUNT - 1; i > 0; i--) {
+                right.grow(bins[i]);
+                right_count += counts[i];
+                right_costs[i - 1] = static_cast<float>(right_count) * right.surface_area();
+            }
+
+            Aabb     left;
+            uint32_t left_count = 0;
+            for (uint32_t i = 0; i < BIN_COUNT - 1; i++) {
+                left.grow(bins[i]);
+                left_count += counts[i];
+                if (left_count == 0 || left_count == primitives.size())
+                    continue;
+
+                const float cost = static_cast<float>(left_count) * left.surface_area() + right_costs[i];
+                if (!best.has_value() || cost < best->cost)
+                    best = Split{binning, i, cost};
+            }
+        }
+
+        return best;
+    }
+
+    static void build_node(BuildContext &context, const uint32_t node_index, const uint32_t begin, const uint32_t end, const uint32_t depth) {
+        const auto primitives = context.primitives.subspan(begin, end - begin);
+
+        Aabb bounds, centroid_bounds;
+        for (const auto &primitive : primitives) {
+            bounds.grow(primitive.bounds);
+            centroid_bounds.grow(primitive.centroid);
+        }
+
+        BvhNode &node = context.nodes[node_index];
+        node.min      = bounds.min;
+        node.max      = bounds.max;
+        node.first    = begin;
+        node.count    = end - begin;
+
+        if (node.count <= 2 || depth == MAX_DEPTH)
+            return;
+
+        // the cost of a leaf is testing every primitive, and of a split traversing into the children
+        const std::optional<Split> split     = find_split(primitives, centroid_bounds);
+        const float                leaf_cost = static_cast<float>(node.count) * bounds.surface_area();
+        const bool split_worth_it = split.has_value() && split->cost + TRAVERSAL_COST * bounds.surface_area() < leaf_cost;
+        if (!split_worth_it && node.count <= MAX_LEAF_SIZE)
+            return;
+
+        uint32_t mid;
+        if (split.has_value()) {
+            const auto it = std::partition(primitives.begin(), primitives.end(), [&](const BuildPrimitive &p) { return split->binning.bin(p.centroid) <= split->last_left_bin; });
+            mid           = begin + static_cast<uint32_t>(it - primitives.begin());
+        } else {
+            // every centroid is in the same place, so any split is as good as another
+            mid = begin + node.count / 2;
+        }
+
+        const uint32_t children = context.node_count.fetch_add(2);
+        node.first              = children;
+        node.count              = 0;
+
+        if (depth < context.parallel_depth && end - begin >= PARALLEL_THRESHOLD) {
+            std::jthread left([&] { build_node(context, children, begin, mid, depth + 1); });
+            build_node(context, children + 1, mid, end, depth + 1);
+        } else {
+            build_node(context, children, begin, mid, depth + 1);
+            build_node(context, children + 1, mid, end, depth + 1);
+        }
+    }
+
+    void Bvh::build(const InstanceStore &store, const uint32_t thread_count) {
+        m_nodes.clear();
+        m_primitives.clear();
+        if (store.size() == 0)
+            return;
+
+        std::vector<BuildPrimitive> primitives(store.size());
+        for (uint32_t slot = 0; slot < primitives.size(); slot++) {
+            const InstanceId id   = store.id(slot);
+            const Aabb       aabb = Aabb::from_sphere(store.world_bounds(id));
+            primitives[slot]      = {aabb, aabb.center(), id};
+        }
+
+        // a binary tree never has more than 2n - 1 nodes, so the array is never reallocated while threads write into it
+        m_nodes.resize(primitives.size() * 2 - 1);
+
+        BuildContext context{primitives, m_nodes, 1, static_cast<uint32_t>(std::bit_width(std::max(thread_count, 1u))) - 1};
+        build_node(context, 0, 0, static_cast<uint32_t>(primitives.size()), 0);
+        m_nodes.resize(context.node_count);
+
+        m_primitives.reserve(primitives.size());
+        for (const auto &primitive : primitives) {
+            m_primitives.push_back(primitive.id);
+        }
+    }
+
+    void Bvh::refit(const InstanceStore &store) {
+        for (auto it = m_nodes.rbegin(); it != m_nodes.rend(); ++it) {
+            Aabb bounds;
+            if (it->is_leaf()) {
+                for (uint32_t i = it->first; i < it->first + it->count; i++) {
+                    if (store.contains(m_primitives[i]))
+                        bounds.grow(Aabb::from_sphere(store.world_bounds(m_primitives[i])));
+                }
+            } else {
+                bounds.grow(m_nodes[it->first].bounds());
+                bounds.grow(m_nodes[it->first + 1].bounds());
+            }
+
+            it->min = bounds.min;
+            it->max = bounds.max;
+        }
+    }
+
+    void Bvh::query(const Frustum &frustum, const InstanceStore &store, std::vector<InstanceId> &ids) const {
+        traverse(frustum, store, [&](const InstanceId id) { ids.push_back(id); });
+    }
+
+    void Bvh::traverse(const Frustum &frustum, const InstanceStore &store, const function_ref<void(InstanceId id)> f) const {
+        if (m_nodes.empty())
+            return;
+
+        // nodes inside the frustum don't need their children tested
+        struct Entry {
+            uint32_t node;
+            bool     contained;
+        };
+
+        TraversalStack<Entry> stack;
+        uint32_t              stack_size = 0;
+        stack[stack_size++]              = {0, false};
+        while (stack_size > 0) {
+            const auto [index, parent_contained] = stack[--stack_size];
+
+            const BvhNode &node      = m_nodes[index];
+            bool           contained = parent_contained;
+            if (!contained) {
+                if (!frustum.intersects(node.bounds()))
+                    continue;
+
+                contained = frustum.contains(node.bounds());
+            }
+
+            if (node.is_leaf()) {
+                for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                    if (store.contains(m_primitives[i]))
+                        f(m_primitives[i]);
+                }
+            } else {
+                stack[stack_size++] = {node.first, contained};
+                stack[stack_size++] = {node.first + 1, contained};
+            }
+        }
+    }
+
+    void Bvh::cull(const Frustum &frustum, InstanceStore &store, std::vector<uint32_t> &visible) const {
+        store.sort();
+
+        visible.clear();
+        traverse(frustum, store, [&](const InstanceId id) { visible.push_back(store.slot(id)); });
+
+        std::ranges::sort(visible);
+    }
+
+    // the distance to where the ray enters the box (0 if it starts inside), if it hits
+    static std::optional<float> intersect(const Ray &ray, const glm::vec3 &inverse_direction, const Aabb &box) {
+        const glm::vec3 t1 = (box.min - ray.origin) * inverse_direction;
+        const glm::vec3 t2 = (box.max - ray.origin) * inverse_direction;
+        const glm::vec3 near = glm::min(t1, t2), far = glm::max(t1, t2);
+
+        const float enter = std::max({near.x, near.y, near.z, 0.0f});
+        const float exit  = std::min({far.x, far.y, far.z});
+        if (exit < enter)
+            return std::nullopt;
+
+        return enter;
+    }
+
+    static std::optional<float> intersect(const Ray &ray, const BoundingSphere &sphere) {
+        const glm::vec3 offset       = ray.origin - sphere.center;
+        const float     b            = glm::dot(offset, ray.direction);
+        const float     discriminant = b * b - (glm::dot(offset, offset) - sphere.radius * sphere.radius);
+        if (discriminant < 0.0f)
+            return std::nullopt;
+
+        const float root = std::sqrt(discriminant);
+        if (-b + root < 0.0f) // behind the ray
+            return std::nullopt;
+
+        return std::max(-b - root, 0.0f);
+    }
+
+    std::optional<BvhHit> Bvh::pick(const Ray &ray, const InstanceStore &store, const float max_distance) const {
+        if (m_nodes.empty())
+            return std::nullopt;
+
+        const glm::vec3 inverse_direction = 1.0f / ray.direction;
+
+        std::optional<BvhHit> closest;
+        float                 closest_distance = max_distance;
+
+        TraversalStack<std::pair<uint32_t, float>> stack; // node, distance to it
+        uint32_t                                   stack_size = 0;
+        if (const auto distance = intersect(ray, inverse_direction, m_nodes[0].bounds()))
+            stack[stack_size++] = {0, *distance};
+
+        while (stack_size > 0) {
+            const auto [index, distance] = stack[--stack_size];
+
+            if (distance > closest_distance)
+                continue;
+
+            const BvhNode &node = m_nodes[index];
+            if (node.is_leaf()) {
+                for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                    if (!store.contains(m_primitives[i]))
+                        continue;
+
+                    const auto hit = intersect(ray, store.world_bounds(m_primitives[i]));
+                    if (hit.has_value() && *hit <= closest_distance) {
+                        closest          = BvhHit{m_primitives[i], *hit};
+                        closest_distance = *hit;
+                    }
+                }
+
+                continue;
+            }
+
+            // the nearer child goes on top, so it's searched first and can rule out the other one
+            auto left  = intersect(ray, inverse_direction, m_nodes[node.first].bounds());
+            auto right = intersect(ray, inverse_direction, m_nodes[node.first + 1].bounds());
+            if (left.has_value() && right.has_value() && *left < *right) {
+                stack[stack_size++] = {node.first + 1, *right};
+                stack[stack_size++] = {node.first, *left};
+            } else {
+                if (left.has_value())
+                    stack[stack_size++] = {node.first, *left};
+                if (right.has_value())
+                    stack[stack_size++] = {node.first + 1, *right};
+            }
+        }
+
+        return closest;
+    }
+} // namespace vke
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "vke/bounds.hpp"
+#include "vke/instance_store.hpp"
+#include "vke/util.hpp"
+
+namespace vke {
+    // direction has to be normalized
+    struct Ray {
+        glm::vec3 origin;
+        glm::vec3 direction;
+    };
+
+    struct BvhHit {
+        InstanceId id;
+        float      distance; // along the ray, to the instance's bounding sphere
+    };
+
+    struct BvhNode {
+        glm::vec3 min;
+        uint32_t  first; // first child (the second is first + 1) if count is 0, otherwise first primitive
+        glm::vec3 max;
+        uint32_t  count;
+
+        [[nodiscard]] bool is_leaf() const { return count != 0; }
+
+        [[nodiscard]] Aabb bounds() const { return {min, max}; }
+    };
+
+    static_assert(sizeof(BvhNode) == 32);
+
+    /**
+     * @brief Bounding volume hierarchy over an InstanceStore's bounding spheres, for frustum queries and picking without going through every instance.
+     *
+     * Built top down with binned SAH, with the biggest subtrees split across threads, into one array of 32 byte nodes. Children always come after their parent, which
+     * lets refit update every node in one backwards pass when instances move. Instances added after the build aren't in it until the next build, and ones
+     * removed since are skipped by everything (their ids stay in the tree until then, so if add reuses one the new instance is found where the old one was).
+     */
+    class Bvh {
+      public:
+        Bvh() = default;
+
+        void build(const InstanceStore &store, uint32_t thread_count = std::thread::hardware_concurrency());
+
+        // updates the bounds for instances which moved (through InstanceStore::set_transform) without changing the tree. it gets less efficient the further things move.
+        void refit(const InstanceStore &store);
+
+        // appends every instance in a leaf which intersects the frustum, so a few outside it may come along. ids is only appended to, so its capacity can be reused across frames
+        void query(const Frustum &frustum, const InstanceStore &store, std::vector<InstanceId> &ids) const;
+
+        // the same as InstanceStore::cull (visible is overwritten with slots, in slot order), but through the tree. doesn't allocate once visible has grown to fit
+        void cull(const Frustum &frustum, InstanceStore &store, std::vector<uint32_t> &visible) const;
+
+        // the closest instance whose bounding sphere the ray hits
+        [[nodiscard]] std::optional<BvhHit> pick(const Ray &ray, const InstanceStore &store, float max_distance = std::numeric_limits<float>::infinity()) const;
+
+        [[nodiscard]] const std::vector<BvhNode> &nodes() const { return m_nodes; }
+
+        [[nodiscard]] bool empty() const { return m_nodes.empty(); }
+
+      private:
+        std::vector<BvhNode>    m_nodes; // the root is first
+        std::vector<InstanceId> m_primitives; // leaves point into this
+
+        // calls f for every instance query would return
+        void traverse(const Frustum &frustum, const InstanceStore &store, function_ref<void(InstanceId id)> f) const;
+    };
+} // namespace vke
@@ -0,0 +1,261 @@
+#include "defragmenter.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <iterator>
+
+namespace vke {
+    Defragmenter::Defragmenter(RenderContext &rc) : m_rc(rc) {
+        const auto device = m_rc.device();
+
+        m_pool  = device.createCommandPool(vk::CommandPoolCreateInfo(vk::CommandPoolCreateFlagBits::eResetCommandBuffer, m_rc.queue_families().transfer));
+        m_cmd   = device.allocateCommandBuffers(vk::CommandBufferAllocateInfo(m_pool, vk::CommandBufferLevel::ePrimary, 1))[0];
+        m_fence = device.createFence({});
+    }
+
+    Defragmenter::~Defragmenter() {
+        {
+            std::lock_guard lock(m_mutex);
+            m_cancel_requested = true;
+
+            // the render context waits for the device to go idle before destroying us, so every remaining step can be completed right away
+            if (m_state == State::Copying) {
+                auto _ = m_rc.device().waitForFences(m_fence, true, UINT64_MAX);
+                finish_copies();
+            }
+
+            if (m_state == State::Retiring) {
+                end_pass();
+            }
+
+            if (m_state != State::Idle) {
+                finish();
+            }
+        }
+
+        m_rc.device().destroy(m_fence);
+        m_rc.device().destroy(m_pool);
+    }
+
+    void Defragmenter::track(BufferInfo &info) const {
+        assert(info.usage & vk::BufferUsageFlagBits::eTransferSrc && info.usage & vk::BufferUsageFlagBits::eTransferDst);
+        vmaSetAllocationUserData(m_rc.allocator(), info.allocation, &info);
+    }
+
+    void Defragmenter::start(const DefragmentationSettings &settings) {
+        std::lock_guard lock(m_mutex);
+        if (m_state != State::Idle)
+            return;
+
+        m_settings         = settings;
+        m_cancel_requested = false;
+
+        // a null pool means the default pools
+        m_pools = {VK_NULL_HANDLE};
+        std::ranges::copy(m_rc.memory_pools(), std::back_inserter(m_pools));
+        m_pool_index = 0;
+
+        begin_context();
+    }
+
+    void Defragmenter::cancel() {
+        // a pass which already started has to run to completion, since live buffers may already point at their new locations
+        std::lock_guard lock(m_mutex);
+        m_cancel_requested = true;
+    }
+
+    void Defragmenter::update() {
+        std::lock_guard lock(m_mutex);
+        const auto      deadline = std::chrono::steady_clock::now() + m_settings.frame_budget;
+
+        switch (m_state) {
+        case State::Idle:
+            break;
+        case State::BeginPass:
+            if (m_cancel_requested) {
+                finish();
+            } else {
+                begin_pass(deadline);
+            }
+            break;
+        case State::Copying:
+            if (m_rc.device().getFenceStatus(m_fence) == vk::Result::eSuccess) {
+                finish_copies();
+            }
+            break;
+        case State::Retiring:
+            if (m_rc.frame_number() >= m_retire_frame) {
+                end_pass();
+            }
+            break;
+        }
+    }
+
+    bool Defragmenter::release(const BufferInfo &info) {
+        std::lock_guard lock(m_mutex);
+        if (m_state != State::Copying && m_state != State::Retiring)
+            return false;
+
+        for (uint32_t i = 0; i < m_pass.moveCount; i++) {
+            auto &move = m_pass.pMoves[i];
+            if (move.srcAllocation != info.allocation)
+                continue;
+
+            // vma frees both the old and the reserved allocation when the pass ends. the buffers may still be in use by the copy or by frames in flight, so they wait too.
+            move.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_DESTROY;
+            for (auto &pending : m_moves) {
+                if (pending.move_index == i) {
+                    pending.target = nullptr;
+                    m_released_buffers.push_back(pending.old_buffer);
+                    m_released_buffers.push_back(pending.new_buffer);
+                    return true;
+                }
+            }
+
+            m_released_buffers.push_back(info.buffer);
+            return true;
+        }
+
+        return false;
+    }
+
+    void Defragmenter::begin_context() {
+        VmaDefragmentationInfo info{};
+        info.flags                 = m_settings.flags;
+        info.pool                  = m_pools[m_pool_index];
+        info.maxBytesPerPass       = m_settings.max_bytes_per_pass;
+        info.maxAllocationsPerPass = m_settings.max_allocations_per_pass;
+
+        if (vmaBeginDefragmentation(m_rc.allocator(), &info, &m_context) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to begin defragmentation.");
+        }
+
+        m_state = State::BeginPass;
+    }
+
+    void Defragmenter::begin_pass(const std::chrono::steady_clock::time_point deadline) {
+        const auto allocator = m_rc.allocator();
+        const auto device    = m_rc.device();
+
+        if (vmaBeginDefragmentationPass(allocator, m_context, &m_pass) == VK_SUCCESS) {
+            // nothing left to move
+            finish();
+            return;
+        }
+
+        const auto families = m_rc.graphics_transfer_queue_families();
+
+        m_moves.clear();
+        for (uint32_t i = 0; i < m_pass.moveCount; i++) {
+            auto &move = m_pass.pMoves[i];
+
+            VmaAllocationInfo allocation_info;
+            vmaGetAllocationInfo(allocator, move.srcAllocation, &allocation_info);
+            auto *target = static_cast<BufferInfo *>(allocation_info.pUserData);
+
+            // untracked allocations have nothing we can patch. we always attempt at least one move so a pass can't stall on a tiny budget.
+            if (target == nullptr || (!m_moves.empty() && std::chrono::steady_clock::now() >= deadline)) {
+                move.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+                continue;
+            }
+
+            vk::BufferCreateInfo buffer_ci({}, target->size, target->usage);
+            if (families.size() > 1) {
+                buffer_ci.setSharingMode(vk::SharingMode::eConcurrent);
+                buffer_ci.setQueueFamilyIndices(families);
+            }
+
+            const vk::Buffer new_buffer = device.createBuffer(buffer_ci);
+            if (vmaBindBufferMemory(allocator, move.dstTmpAllocation, new_buffer) != VK_SUCCESS) {
+                device.destroy(new_buffer);
+                move.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+                continue;
+            }
+
+            m_moves.push_back(PendingMove{i, target, target->buffer, new_buffer});
+        }
+
+        if (m_moves.empty()) {
+            // none of the proposed moves belong to tracked buffers, so there is nothing more we can do
+            vmaEndDefragmentationPass(allocator, m_context, &m_pass);
+            finish();
+            return;
+        }
+
+        m_cmd.reset();
+        record_single_use_commands(m_cmd, [&](const vk::CommandBuffer &cmd) {
+            for (const auto &move : m_moves) {
+                cmd.copyBuffer(move.old_buffer, move.new_buffer, vk::BufferCopy(0, 0, move.target->size));
+            }
+        });
+
+        device.resetFences(m_fence);
+        m_rc.queues().transfer.submit(vk::SubmitInfo({}, {}, m_cmd, {}), m_fence);
+
+        m_state = State::Copying;
+    }
+
+    void Defragmenter::finish_copies() {
+        // frames recorded from here on use the new buffers. the old ones stay alive until the frames which may still reference them are done.
+        for (const auto &move : m_moves) {
+            if (move.target != nullptr) {
+                move.target->buffer = move.new_buffer;
+                if (move.target->usage & vk::BufferUsageFlagBits::eShaderDeviceAddress) {
+                    move.target->address = m_rc.device().getBufferAddress(vk::BufferDeviceAddressInfo(move.new_buffer));
+                }
+            }
+        }
+
+        m_retire_frame = m_rc.frame_number() + RenderContext::MAX_FRAMES_IN_FLIGHT;
+        m_state        = State::Retiring;
+    }
+
+    void Defragmenter::end_pass() {
+        const auto allocator = m_rc.allocator();
+        const auto device    = m_rc.device();
+
+        for (const auto &move : m_moves) {
+            if (move.target != nullptr) {
+                device.destroy(move.old_buffer);
+            }
+        }
+
+        for (const auto &buffer : m_released_buffers) {
+            device.destroy(buffer);
+        }
+        m_released_buffers.clear();
+
+        const VkResult result = vmaEndDefragmentationPass(allocator, m_context, &m_pass);
+
+        for (const auto &move : m_moves) {
+            if (move.target != nullptr) {
+                vmaGetAllocationInfo(allocator, move.target->allocation, &move.target->allocation_info);
+            }
+        }
+        m_moves.clear();
+
+        if (result == VK_SUCCESS || m_cancel_requested) {
+            finish();
+        } else {
+            m_state = State::BeginPass;
+        }
+    }
+
+    void Defragmenter::finish() {
+        vmaEndDefragmentation(m_rc.allocator(), m_context, &m_last_stats);
+        m_context = VK_NULL_HANDLE;
+        m_pass    = {};
+
+        spdlog::info("Defragmentation moved {} allocations ({} bytes), freeing {} bytes and {} memory blocks", m_last_stats.allocationsMoved, m_last_stats.bytesMoved,
+                     m_last_stats.bytesFreed, m_last_stats.deviceMemoryBlocksFreed);
+
+        if (!m_cancel_requested && ++m_pool_index < m_pools.size()) {
+            begin_context();
+            return;
+        }
+
+        m_state            = State::Idle;
+        m_cancel_requested = false;
+    }
+} // namespace vke
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <vk_mem_alloc.h>
+
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+#include "vke/render_context.hpp"
+
+namespace vke {
+    struct DefragmentationSettings {
+        // cpu time update() may spend per frame. moves which don't fit are left for a later pass
+        std::chrono::microseconds frame_budget             = std::chrono::microseconds(500);
+        vk::DeviceSize            max_bytes_per_pass       = 32ull * 1024 * 1024;
+        uint32_t                  max_allocations_per_pass = 256;
+        VmaDefragmentationFlags   flags                    = VMA_DEFRAGMENTATION_FLAG_ALGORITHM_BALANCED_BIT;
+    };
+
+    /**
+     * @brief Incrementally compacts vma memory blocks while the application keeps rendering.
+     *
+     * The default pools are processed first, followed by every pool returned by RenderContext::memory_pools. Only buffers registered with track() are moved. Their BufferInfo is patched in place, so it has to stay at the same address for the lifetime of the buffer (Mesh does this for
+     * its own buffers). Tracked buffers need TRANSFER_SRC and TRANSFER_DST usage and must be shared between the graphics and transfer families when those differ, since the copies
+     * run on the transfer queue.
+     *
+     * Each pass goes through these steps, at most one step per frame and never blocking on the gpu:
+     * - begin a vma pass and record copies into freshly created buffers until the frame budget runs out, then submit them on the transfer queue.
+     * - once the transfer fence signals, point the tracked BufferInfos at the new buffers.
+     * - once every frame which could still reference the old buffers has finished, destroy them and end the vma pass.
+     */
+    class Defragmenter {
+      public:
+        explicit Defragmenter(RenderContext &rc);
+        ~Defragmenter();
+
+        Defragmenter(const Defragmenter &other)                = delete;
+        Defragmenter &operator=(const Defragmenter &other)     = delete;
+        Defragmenter(Defragmenter &&other) noexcept            = delete;
+        Defragmenter &operator=(Defragmenter &&other) noexcept = delete;
+
+        void track(BufferInfo &info) const;
+
+        void start(const DefragmentationSettings &settings = {});
+        void cancel();
+
+        // called once per frame by RenderContext::render_frame
+        void update();
+
+        /**
+         * @brief Takes over destruction of a buffer whose allocation is part of the current pass.
+         *
+         * @return false if the buffer isn't being moved, in which case the caller has to destroy it normally
+         */
+        bool release(const BufferInfo &info);
+
+        [[nodiscard]] bool running() const { return m_state != State::Idle; }
+
+        [[nodiscard]] VmaDefragmentationStats last_stats() const { return m_last_stats; }
+
+      private:
+        enum class State {
+            Idle,
+            BeginPass,
+            Copying,
+            Retiring,
+        };
+
+        struct PendingMove {
+            uint32_t    move_index;
+            BufferInfo *target;
+            vk::Buffer  old_buffer;
+            vk::Buffer  new_buffer;
+        };
+
+        RenderContext &m_rc;
+
+        vk::CommandPool   m_pool;
+        vk::CommandBuffer m_cmd;
+        vk::Fence         m_fence;
+
+        std::mutex                     m_mutex;
+        State                          m_state            = State::Idle;
+        bool                           m_cancel_requested = false;
+        DefragmentationSettings        m_settings;
+        std::vector<VmaPool>           m_pools;
+        size_t                         m_pool_index = 0;
+        VmaDefragmentationContext      m_context    = VK_NULL_HANDLE;
+        VmaDefragmentationPassMoveInfo m_pass{};
+        std::vector<PendingMove>       m_moves;
+        std::vector<vk::Buffer>        m_released_buffers; // destroyed when the pass ends
+        uint64_t                       m_retire_frame = 0;
+        VmaDefragmentationStats        m_last_stats{};
+
+        void begin_context();
+        void begin_pass(std::chrono::steady_clock::time_point deadline);
+        void finish_copies();
+        void end_pass();
+        void finish();
+    };
+} // namespace vke
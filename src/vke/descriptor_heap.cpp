@@ -0,0 +1,160 @@
+#include "descriptor_heap.hpp"
+
+#include <algorithm>
+
+namespace vke {
+    static DescriptorHeapSizes clamp_heap_sizes(const RenderContext &rc, const DescriptorHeapSizes &sizes) {
+        const auto  properties = rc.physical_device().getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceVulkan12Properties>();
+        const auto &v12p       = properties.get<vk::PhysicalDeviceVulkan12Properties>();
+
+        DescriptorHeapSizes clamped{
+            .storage_buffers = std::min({sizes.storage_buffers, v12p.maxDescriptorSetUpdateAfterBindStorageBuffers, v12p.maxPerStageDescriptorUpdateAfterBindStorageBuffers}),
+            .sampled_images  = std::min({sizes.sampled_images, v12p.maxDescriptorSetUpdateAfterBindSampledImages, v12p.maxPerStageDescriptorUpdateAfterBindSampledImages}),
+            .samplers        = std::min({sizes.samplers, v12p.maxDescriptorSetUpdateAfterBindSamplers, v12p.maxPerStageDescriptorUpdateAfterBindSamplers}),
+        };
+
+        // every binding is visible to every stage, so all of them together also count against the per stage (and per pool) resource limits
+        const uint64_t total = uint64_t{clamped.storage_buffers} + clamped.sampled_images + clamped.samplers;
+        const uint64_t limit = std::min(v12p.maxPerStageUpdateAfterBindResources, v12p.maxUpdateAfterBindDescriptorsInAllPools);
+        if (total > limit) {
+            clamped.storage_buffers = static_cast<uint32_t>(clamped.storage_buffers * limit / total);
+            clamped.sampled_images  = static_cast<uint32_t>(clamped.sampled_images * limit / total);
+            clamped.samplers        = static_cast<uint32_t>(clamped.samplers * limit / total);
+        }
+
+        return clamped;
+    }
+
+    DescriptorHeap::DescriptorHeap(const std::shared_ptr<RenderContext> &rc, const DescriptorHeapSizes &sizes)
+        : m_rc(rc), m_sizes(clamp_heap_sizes(*rc, sizes)), m_storage_buffers(m_sizes.storage_buffers), m_sampled_images(m_sizes.sampled_images), m_samplers(m_sizes.samplers) {
+        if (!m_rc->features().descriptor_indexing) {
+            throw std::runtime_error("The bindless descriptor heap requires descriptor indexing, which this device doesn't support.");
+        }
+
+        const auto device = m_rc->device();
+
+        const std::array pool_sizes = {
+            vk::DescriptorPoolSize(vk::DescriptorType::eStorageBuffer, m_sizes.storage_buffers),
+            vk::DescriptorPoolSize(vk::DescriptorType::eSampledImage, m_sizes.sampled_images),
+            vk::DescriptorPoolSize(vk::DescriptorType::eSampler, m_sizes.samplers),
+        };
+        m_pool = device.createDescriptorPool(vk::DescriptorPoolCreateInfo(vk::DescriptorPoolCreateFlagBits::eUpdateAfterBind, 1, pool_sizes));
+
+        const std::array bindings = {
+            vk::DescriptorSetLayoutBinding(STORAGE_BUFFER_BINDING, vk::DescriptorType::eStorageBuffer, m_sizes.storage_buffers, vk::ShaderStageFlagBits::eAll),
+            vk::DescriptorSetLayoutBinding(SAMPLED_IMAGE_BINDING, vk::DescriptorType::eSampledImage, m_sizes.sampled_images, vk::ShaderStageFlagBits::eAll),
+            vk::DescriptorSetLayoutBinding(SAMPLER_BINDING, vk::DescriptorType::eSampler, m_sizes.samplers, vk::ShaderStageFlagBits::eAll),
+        };
+
+        constexpr vk::DescriptorBindingFlags flags =
+            vk::DescriptorBindingFlagBits::ePartiallyBound | vk::DescriptorBindingFlagBits::eUpdateAfterBind | vk::DescriptorBindingFlagBits::eUpdateUnusedWhilePending;
+        const std::array binding_flags = {flags, flags, flags};
+
+        const vk::DescriptorSetLayoutBindingFlagsCreateInfo binding_flags_create_info(binding_flags);
+        m_set_layout =
+            device.createDescriptorSetLayout(vk::DescriptorSetLayoutCreateInfo(vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPool, bindings, &binding_flags_create_info));
+
+        m_set = device.allocateDescriptorSets(vk::DescriptorSetAllocateInfo(m_pool, m_set_layout))[0];
+
+        const vk::PushConstantRange push_constant_range(PUSH_CONSTANT_STAGES, 0, PUSH_CONSTANT_SIZE);
+        m_pipeline_layout = device.createPipelineLayout(vk::PipelineLayoutCreateInfo({}, m_set_layout, push_constant_range));
+    }
+
+    DescriptorHeap::~DescriptorHeap() {
+        const auto device = m_rc->device();
+        device.destroy(m_pipeline_layout);
+        device.destroy(m_set_layout);
+        device.destroy(m_pool);
+    }
+
+    uint32_t DescriptorHeap::add_storage_buffer(const vk::Buffer buffer, const vk::DeviceSize offset, const vk::DeviceSize range) {
+        std::lock_guard lock(m_mutex);
+        const uint32_t  index = allocate(m_storage_buffers);
+
+        const vk::DescriptorBufferInfo info(buffer, offset, range);
+        vk::WriteDescriptorSet         w{};
+        w.setDstSet(m_set).setDstBinding(STORAGE_BUFFER_BINDING).setDstArrayElement(index).setDescriptorType(vk::DescriptorType::eStorageBuffer).setBufferInfo(info);
+        write(w);
+
+        return index;
+    }
+
+    uint32_t DescriptorHeap::add_sampled_image(const vk::ImageView view, const vk::ImageLayout layout) {
+        std::lock_guard lock(m_mutex);
+        const uint32_t  index = allocate(m_sampled_images);
+
+        const vk::DescriptorImageInfo info({}, view, layout);
+        vk::WriteDescriptorSet        w{};
+        w.setDstSet(m_set).setDstBinding(SAMPLED_IMAGE_BINDING).setDstArrayElement(index).setDescriptorType(vk::DescriptorType::eSampledImage).setImageInfo(info);
+        write(w);
+
+        return index;
+    }
+
+    uint32_t DescriptorHeap::add_sampler(const vk::Sampler sampler) {
+        std::lock_guard lock(m_mutex);
+        const uint32_t  index = allocate(m_samplers);
+
+        const vk::DescriptorImageInfo info(sampler, {}, {});
+        vk::WriteDescriptorSet        w{};
+        w.setDstSet(m_set).setDstBinding(SAMPLER_BINDING).setDstArrayElement(index).setDescriptorType(vk::DescriptorType::eSampler).setImageInfo(info);
+        write(w);
+
+        return index;
+    }
+
+    void DescriptorHeap::free_storage_buffer(const uint32_t index) {
+        std::lock_guard lock(m_mutex);
+        release(m_storage_buffers, index);
+    }
+
+    void DescriptorHeap::free_sampled_image(const uint32_t index) {
+        std::lock_guard lock(m_mutex);
+        release(m_sampled_images, index);
+    }
+
+    void DescriptorHeap::free_sampler(const uint32_t index) {
+        std::lock_guard lock(m_mutex);
+        release(m_samplers, index);
+    }
+
+    uint32_t DescriptorHeap::allocate(FreeList &list) {
+        // recycle whatever is no longer referenced by frames in flight before handing out new indices
+        const uint64_t frame = m_rc->frame_number();
+        std::erase_if(m_pending_releases, [frame](const PendingRelease &pending) {
+            if (pending.frame > frame)
+                return false;
+
+            pending.list->release(pending.index);
+            return true;
+        });
+
+        return list.allocate();
+    }
+
+    void DescriptorHeap::release(FreeList &list, const uint32_t index) {
+        m_pending_releases.push_back(PendingRelease{m_rc->frame_number() + RenderContext::MAX_FRAMES_IN_FLIGHT, &list, index});
+    }
+
+    void DescriptorHeap::write(const vk::WriteDescriptorSet &write) const {
+        m_rc->device().updateDescriptorSets(write, {});
+    }
+
+    uint32_t DescriptorHeap::FreeList::allocate() {
+        if (!m_free.empty()) {
+            const uint32_t index = m_free.back();
+            m_free.pop_back();
+            return index;
+        }
+
+        if (m_next >= m_capacity) {
+            throw std::runtime_error("Descriptor heap is full.");
+        }
+
+        return m_next++;
+    }
+
+    void DescriptorHeap::FreeList::release(const uint32_t index) {
+        m_free.push_back(index);
+    }
+} // namespace vke
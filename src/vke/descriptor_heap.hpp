@@ -0,0 +1,103 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "vke/render_context.hpp"
+
+namespace vke {
+    struct DescriptorHeapSizes {
+        // clamped to the device's update after bind limits, per type and for all of them together
+        uint32_t storage_buffers = 16384;
+        uint32_t sampled_images  = 16384;
+        uint32_t samplers        = 256;
+    };
+
+    /**
+     * @brief One large update after bind descriptor set shared by every pipeline, so draws never have to bind descriptors.
+     *
+     * Resources are added to the heap and referenced from shaders by the index they get back, which stays valid until it is freed. The set layout is:
+     * - binding 0: storage buffers
+     * - binding 1: sampled images
+     * - binding 2: samplers
+     *
+     * Every binding is partially bound, so only the indices in use need valid descriptors. The shared pipeline layout also carries a single push constant range which covers every
+     * stage, used to pass resource indices (and device addresses) to shaders.
+     */
+    class DescriptorHeap {
+      public:
+        static constexpr uint32_t STORAGE_BUFFER_BINDING = 0;
+        static constexpr uint32_t SAMPLED_IMAGE_BINDING  = 1;
+        static constexpr uint32_t SAMPLER_BINDING        = 2;
+
+        static constexpr uint32_t             PUSH_CONSTANT_SIZE   = 128; // the minimum maxPushConstantsSize the spec guarantees
+        static constexpr vk::ShaderStageFlags PUSH_CONSTANT_STAGES = vk::ShaderStageFlagBits::eAll;
+
+        explicit DescriptorHeap(const std::shared_ptr<RenderContext> &rc, const DescriptorHeapSizes &sizes = {});
+        ~DescriptorHeap();
+
+        DescriptorHeap(const DescriptorHeap &other)                = delete;
+        DescriptorHeap &operator=(const DescriptorHeap &other)     = delete;
+        DescriptorHeap(DescriptorHeap &&other) noexcept            = delete;
+        DescriptorHeap &operator=(DescriptorHeap &&other) noexcept = delete;
+
+        [[nodiscard]] uint32_t add_storage_buffer(vk::Buffer buffer, vk::DeviceSize offset = 0, vk::DeviceSize range = vk::WholeSize);
+        [[nodiscard]] uint32_t add_sampled_image(vk::ImageView view, vk::ImageLayout layout = vk::ImageLayout::eShaderReadOnlyOptimal);
+        [[nodiscard]] uint32_t add_sampler(vk::Sampler sampler);
+
+        // indices are only recycled once every frame which could still be reading them is done
+        void free_storage_buffer(uint32_t index);
+        void free_sampled_image(uint32_t index);
+        void free_sampler(uint32_t index);
+
+        [[nodiscard]] vk::DescriptorSetLayout set_layout() const { return m_set_layout; }
+
+        [[nodiscard]] vk::DescriptorSet set() const { return m_set; }
+
+        [[nodiscard]] vk::PipelineLayout pipeline_layout() const { return m_pipeline_layout; }
+
+        [[nodiscard]] DescriptorHeapSizes sizes() const { return m_sizes; }
+
+      private:
+        class FreeList {
+          public:
+            explicit FreeList(uint32_t capacity) : m_capacity(capacity) {};
+
+            uint32_t allocate();
+            void     release(uint32_t index);
+
+          private:
+            uint32_t              m_capacity;
+            uint32_t              m_next = 0;
+            std::vector<uint32_t> m_free;
+        };
+
+        std::shared_ptr<RenderContext> m_rc;
+        DescriptorHeapSizes            m_sizes;
+
+        vk::DescriptorPool      m_pool;
+        vk::DescriptorSetLayout m_set_layout;
+        vk::DescriptorSet       m_set;
+        vk::PipelineLayout      m_pipeline_layout;
+
+        struct PendingRelease {
+            uint64_t  frame;
+            FreeList *list;
+            uint32_t  index;
+        };
+
+        // guards the free lists and writes to the set
+        std::mutex                  m_mutex;
+        FreeList                    m_storage_buffers;
+        FreeList                    m_sampled_images;
+        FreeList                    m_samplers;
+        std::vector<PendingRelease> m_pending_releases;
+
+        uint32_t allocate(FreeList &list);
+        void     release(FreeList &list, uint32_t index);
+        void     write(const vk::WriteDescriptorSet &write) const;
+    };
+} // namespace vke
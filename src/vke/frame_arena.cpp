@@ -0,0 +1,57 @@
+#include "frame_arena.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+
+namespace vke {
+    FrameArena::FrameArena(const size_t capacity) : m_block(allocate_block(capacity)), m_capacity(capacity) {}
+
+    void FrameArena::reset() {
+        if (!m_overflow.empty()) {
+            // grow to fit everything from this frame, rounded up so a slowly growing workload doesn't reallocate every frame
+            const size_t needed = m_head.load(std::memory_order_relaxed) + m_overflow_bytes;
+            m_capacity          = std::max(m_capacity * 2, (needed + BLOCK_ALIGNMENT - 1) & ~(BLOCK_ALIGNMENT - 1));
+            m_block             = allocate_block(m_capacity);
+            m_overflow.clear();
+            m_overflow_bytes = 0;
+
+            spdlog::debug("Frame arena grew to {} bytes", m_capacity);
+        }
+
+        m_head.store(0, std::memory_order_relaxed);
+    }
+
+    FrameArena::Block FrameArena::allocate_block(const size_t size) {
+        return Block(static_cast<std::byte *>(::operator new(std::max(size, size_t{1}), std::align_val_t{BLOCK_ALIGNMENT})));
+    }
+
+    void *FrameArena::do_allocate(const size_t bytes, const size_t alignment) {
+        if (alignment <= BLOCK_ALIGNMENT) {
+            size_t head = m_head.load(std::memory_order_relaxed);
+            size_t offset;
+            do {
+                offset = (head + alignment - 1) & ~(alignment - 1);
+                if (offset + bytes > m_capacity)
+                    break;
+            } while (!m_head.compare_exchange_weak(head, offset + bytes, std::memory_order_relaxed));
+
+            if (offset + bytes <= m_capacity)
+                return m_block.get() + offset;
+        }
+
+        std::lock_guard lock(m_overflow_mutex);
+        m_overflow_bytes += bytes + alignment;
+        const Block &block = m_overflow.emplace_back(allocate_block(bytes + alignment));
+
+        void  *p     = block.get();
+        size_t space = bytes + alignment;
+        return std::align(alignment, bytes, p, space);
+    }
+
+    void FrameArena::do_deallocate(void *, size_t, size_t) {
+        // everything is freed by reset
+    }
+
+    bool FrameArena::do_is_equal(const memory_resource &other) const noexcept { return this == &other; }
+} // namespace vke
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+namespace vke {
+    /**
+     * @brief Linear allocator for transient cpu data which only lives until the end of a frame (submit infos, barrier lists, culling results, etc.).
+     *
+     * Allocating bumps an offset and freeing does nothing, everything is released at once by reset. RenderContext owns one and resets it at the start of render_frame, so
+     * anything allocated while recording a frame is gone by the next one. It's a pmr memory resource, so std::pmr containers can use it directly.
+     *
+     * Allocations which don't fit go into separate overflow blocks, and the next reset grows the arena to fit all of them. After the first few frames it stops touching the heap.
+     * Allocating is thread safe, reset isn't.
+     */
+    class FrameArena final : public std::pmr::memory_resource {
+      public:
+        explicit FrameArena(size_t capacity = 256 * 1024);
+
+        FrameArena(const FrameArena &other)                = delete;
+        FrameArena &operator=(const FrameArena &other)     = delete;
+        FrameArena(FrameArena &&other) noexcept            = delete;
+        FrameArena &operator=(FrameArena &&other) noexcept = delete;
+
+        // invalidates everything allocated so far
+        void reset();
+
+        // uninitialized storage for count values of T
+        template <typename T>
+            requires std::is_trivially_destructible_v<T>
+        std::span<T> allocate_array(const size_t count) {
+            return {static_cast<T *>(allocate(count * sizeof(T), alignof(T))), count};
+        }
+
+        [[nodiscard]] size_t capacity() const { return m_capacity; }
+
+        [[nodiscard]] size_t used() const { return m_head.load(std::memory_order_relaxed) + m_overflow_bytes; }
+
+      private:
+        // blocks are aligned to this, so alignment can be computed from offsets
+        static constexpr size_t BLOCK_ALIGNMENT = 64;
+
+        struct BlockDeleter {
+            void operator()(std::byte *block) const { ::operator delete(block, std::align_val_t{BLOCK_ALIGNMENT}); }
+        };
+
+        using Block = std::unique_ptr<std::byte[], BlockDeleter>;
+
+        Block               m_block;
+        size_t              m_capacity;
+        std::atomic<size_t> m_head = 0;
+
+        std::mutex         m_overflow_mutex;
+        std::vector<Block> m_overflow;           // allocations which didn't fit into m_block this frame
+        size_t             m_overflow_bytes = 0; // guarded by m_overflow_mutex
+
+        static Block allocate_block(size_t size);
+
+        void *do_allocate(size_t bytes, size_t alignment) override;
+        void  do_deallocate(void *p, size_t bytes, size_t alignment) override;
+        bool  do_is_equal(const memory_resource &other) const noexcept override;
+    };
+} // namespace vke
@@ -0,0 +1,55 @@
+#include "frame_ring.hpp"
+
+#include <algorithm>
+
+namespace vke {
+    FrameRing::FrameRing(const std::shared_ptr<RenderContext> &rc, const vk::DeviceSize region_size, const vk::BufferUsageFlags usage) : m_rc(rc) {
+        const auto limits   = m_rc->physical_device().getProperties().limits;
+        m_default_alignment = std::max({limits.minUniformBufferOffsetAlignment, limits.minStorageBufferOffsetAlignment, vk::DeviceSize{16}});
+
+        // every region starts on an aligned offset, so alignment inside a region can be computed from buffer offsets
+        m_region_size = (region_size + m_default_alignment - 1) & ~(m_default_alignment - 1);
+
+        m_buffer = m_rc->create_buffer(m_region_size * RenderContext::MAX_FRAMES_IN_FLIGHT, nullptr, MemoryUsage::Auto, usage | vk::BufferUsageFlagBits::eShaderDeviceAddress,
+                                       {.access_mode = MemoryAccessMode::Sequential, .residency = ResidencyClass::RenderCritical, .persistently_mapped = true});
+        m_mapped = static_cast<unsigned char *>(m_buffer.allocation_info.pMappedData);
+        if (m_mapped == nullptr) {
+            throw std::runtime_error("Frame ring memory isn't host visible.");
+        }
+
+        m_region_end = m_region_size;
+    }
+
+    FrameRing::~FrameRing() {
+        // the last frames written may still be in flight
+        m_rc->defer_destruction([rc = m_rc.get(), buffer = m_buffer] { rc->destroy_buffer(buffer); });
+    }
+
+    void FrameRing::begin_frame(const FrameInfo &frame_info) {
+        m_region_start = frame_info.current_frame * m_region_size;
+        m_region_end   = m_region_start + m_region_size;
+        m_head.store(m_region_start, std::memory_order_relaxed);
+    }
+
+    void FrameRing::end_frame() const {
+        // this is a no-op on host coherent memory
+        vmaFlushAllocation(m_rc->allocator(), m_buffer.allocation, m_region_start, used());
+    }
+
+    RingAllocation FrameRing::allocate(const vk::DeviceSize size, vk::DeviceSize alignment) {
+        if (alignment == 0)
+            alignment = m_default_alignment;
+        assert((alignment & (alignment - 1)) == 0);
+
+        vk::DeviceSize head = m_head.load(std::memory_order_relaxed);
+        vk::DeviceSize offset;
+        do {
+            offset = (head + alignment - 1) & ~(alignment - 1);
+            if (offset + size > m_region_end) {
+                throw std::runtime_error("Frame ring region is full.");
+            }
+        } while (!m_head.compare_exchange_weak(head, offset + size, std::memory_order_relaxed));
+
+        return {m_mapped + offset, m_buffer.buffer, offset, size, m_buffer.address + offset};
+    }
+} // namespace vke
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <ranges>
+
+#include "vke/render_context.hpp"
+#include "vke/util.hpp"
+
+namespace vke {
+    struct RingAllocation {
+        void             *data;
+        vk::Buffer        buffer;
+        vk::DeviceSize    offset;
+        vk::DeviceSize    size;
+        vk::DeviceAddress address;
+
+        // for binding with dynamic uniform/storage buffer descriptors
+        [[nodiscard]] uint32_t dynamic_offset() const { return static_cast<uint32_t>(offset); }
+    };
+
+    /**
+     * @brief Persistently mapped linear allocator for data which is rewritten every frame (transforms, material parameters, instance data, etc.).
+     *
+     * The buffer is split into one region per frame in flight. Allocating bumps an offset in the current region and returns the slice's buffer, offset and device address, so it
+     * can be used with dynamic offsets, as a vertex stream, or through buffer_reference in shaders. begin_frame recycles the region belonging to the frame which just had its fence
+     * waited on, so it must be called from inside RenderContext::render_frame.
+     *
+     * Allocating is thread safe.
+     */
+    class FrameRing {
+      public:
+        static constexpr vk::BufferUsageFlags DEFAULT_USAGE = vk::BufferUsageFlagBits::eUniformBuffer | vk::BufferUsageFlagBits::eStorageBuffer |
+            vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eIndirectBuffer;
+
+        FrameRing(const std::shared_ptr<RenderContext> &rc, vk::DeviceSize region_size, vk::BufferUsageFlags usage = DEFAULT_USAGE);
+        ~FrameRing();
+
+        FrameRing(const FrameRing &other)                = delete;
+        FrameRing &operator=(const FrameRing &other)     = delete;
+        FrameRing(FrameRing &&other) noexcept            = delete;
+        FrameRing &operator=(FrameRing &&other) noexcept = delete;
+
+        void begin_frame(const FrameInfo &frame_info);
+
+        // flushes everything written to the current region. call before submitting the frame's commands.
+        void end_frame() const;
+
+        /**
+         * @param alignment must be a power of two. 0 uses the strictest of the device's uniform and storage buffer offset alignments.
+         */
+        [[nodiscard]] RingAllocation allocate(vk::DeviceSize size, vk::DeviceSize alignment = 0);
+
+        template <typename T>
+            requires std::is_trivially_copyable_v<T>
+        RingAllocation push(const T &value, const vk::DeviceSize alignment = 0) {
+            const RingAllocation allocation = allocate(sizeof(T), alignment);
+            std::memcpy(allocation.data, &value, sizeof(T));
+            return allocation;
+        }
+
+        template <std::ranges::contiguous_range Range>
+        RingAllocation push_range(Range &&range, const vk::DeviceSize alignment = 0) {
+            const RingAllocation allocation = allocate(byte_size(range), alignment);
+            std::memcpy(allocation.data, std::ranges::data(range), allocation.size);
+            return allocation;
+        }
+
+        [[nodiscard]] vk::Buffer buffer() const { return m_buffer.buffer; }
+
+        [[nodiscard]] vk::DeviceSize region_size() const { return m_region_size; }
+
+        [[nodiscard]] vk::DeviceSize used() const { return m_head.load(std::memory_order_relaxed) - m_region_start; }
+
+      private:
+        std::shared_ptr<RenderContext> m_rc;
+        BufferInfo                     m_buffer;
+        unsigned char                 *m_mapped;
+        vk::DeviceSize                 m_region_size;
+        vk::DeviceSize                 m_default_alignment;
+
+        vk::DeviceSize              m_region_start = 0;
+        vk::DeviceSize              m_region_end   = 0;
+        std::atomic<vk::DeviceSize> m_head         = 0;
+    };
+} // namespace vke
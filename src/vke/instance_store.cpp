@@ -0,0 +1,295 @@
+#include "instance_store.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define VKE_CULL_SSE
+#include <immintrin.h>
+#endif
+
+// avx is picked at runtime, which needs per function target attributes
+#if defined(VKE_CULL_SSE) && (defined(__GNUC__) || defined(__clang__))
+#define VKE_CULL_AVX
+#define VKE_TARGET_AVX __attribute__((target("avx")))
+#endif
+
+namespace vke {
+    struct CullInput {
+        const float *x;
+        const float *y;
+        const float *z;
+        const float *radius;
+        size_t       count;
+    };
+
+    // writes the indices of the visible spheres to out and returns how many there were
+    using CullKernel = size_t (*)(const CullInput &in, const Frustum &frustum, uint32_t *out);
+
+    static size_t cull_scalar_range(const CullInput &in, const Frustum &frustum, uint32_t *out, const size_t begin) {
+        size_t written = 0;
+        for (size_t i = begin; i < in.count; i++) {
+            bool inside = true;
+            for (const auto &plane : frustum.planes) {
+                inside &= in.x[i] * plane.x + in.y[i] * plane.y + in.z[i] * plane.z + plane.w >= -in.radius[i];
+            }
+
+            out[written] = static_cast<uint32_t>(i);
+            written += inside;
+        }
+
+        return written;
+    }
+
+#ifndef VKE_CULL_SSE
+    static size_t cull_scalar(const CullInput &in, const Frustum &frustum, uint32_t *out) { return cull_scalar_range(in, frustum, out, 0); }
+#else
+    static size_t cull_sse(const CullInput &in, const Frustum &frustum, uint32_t *out) {
+        const __m128 sign_mask = _mm_set1_ps(-0.0f);
+
+        size_t written = 0;
+        size_t i       = 0;
+        for (; i + 4 <= in.count; i += 4) {
+            const __m128 x          = _mm_loadu_ps(in.x + i);
+            const __m128 y          = _mm_loadu_ps(in.y + i);
+            const __m128 z          = _mm_loadu_ps(in.z + i);
+            const __m128 neg_radius = _mm_xor_ps(_mm_loadu_ps(in.radius + i), sign_mask);
+
+            __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for (const auto &plane : frustum.planes) {
+                const __m128 distance = _mm_add_ps(
+                    _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(plane.x)), _mm_mul_ps(y, _mm_set1_ps(plane.y))), _mm_mul_ps(z, _mm_set1_ps(plane.z))),
+                    _mm_set1_ps(plane.w));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, neg_radius));
+            }
+
+            for (auto mask = static_cast<uint32_t>(_mm_movemask_ps(inside)); mask != 0; mask &= mask - 1) {
+                out[written++] = static_cast<uint32_t>(i + std::countr_zero(mask));
+            }
+        }
+
+        return written + cull_scalar_range(in, frustum, out + written, i);
+    }
+#endif
+
+#ifdef VKE_CULL_AVX
+    VKE_TARGET_AVX static size_t cull_avx(const CullInput &in, const Frustum &frustum, uint32_t *out) {
+        const __m256 sign_mask = _mm256_set1_ps(-0.0f);
+
+        // the planes are loop invariant, so splat them once
+        __m256 plane_x[6], plane_y[6], plane_z[6], plane_w[6];
+        for (size_t p = 0; p < 6; p++) {
+            plane_x[p] = _mm256_set1_ps(frustum.planes[p].x);
+            plane_y[p] = _mm256_set1_ps(frustum.planes[p].y);
+            plane_z[p] = _mm256_set1_ps(frustum.planes[p].z);
+            plane_w[p] = _mm256_set1_ps(frustum.planes[p].w);
+        }
+
+        size_t written = 0;
+        size_t i       = 0;
+        for (; i + 8 <= in.count; i += 8) {
+            const __m256 x          = _mm256_loadu_ps(in.x + i);
+            const __m256 y          = _mm256_loadu_ps(in.y + i);
+            const __m256 z          = _mm256_loadu_ps(in.z + i);
+            const __m256 neg_radius = _mm256_xor_ps(_mm256_loadu_ps(in.radius + i), sign_mask);
+
+            __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+            for (size_t p = 0; p < 6; p++) {
+                const __m256 distance = _mm256_add_ps(
+                    _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, plane_x[p]), _mm256_mul_ps(y, plane_y[p])), _mm256_mul_ps(z, plane_z[p])), plane_w[p]);
+                inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, neg_radius, _CMP_GE_OQ));
+            }
+
+            for (auto mask = static_cast<uint32_t>(_mm256_movemask_ps(inside)); mask != 0; mask &= mask - 1) {
+                out[written++] = static_cast<uint32_t>(i + std::countr_zero(mask));
+            }
+        }
+
+        return written + cull_scalar_range(in, frustum, out + written, i);
+    }
+#endif
+
+    static CullKernel select_cull_kernel() {
+#ifdef VKE_CULL_AVX
+        if (__builtin_cpu_supports("avx"))
+            return cull_avx;
+#endif
+#ifdef VKE_CULL_SSE
+        return cull_sse;
+#else
+        return cull_scalar;
+#endif
+    }
+
+    InstanceId InstanceStore::add(const glm::mat4 &transform, const BoundingSphere &local_bounds, const uint32_t mesh_id, const uint32_t pipeline_id) {
+        InstanceId id;
+        if (!m_free_ids.empty()) {
+            id = m_free_ids.back();
+            m_free_ids.pop_back();
+        } else {
+            id = static_cast<InstanceId>(m_slots.size());
+            m_slots.push_back(NO_SLOT);
+        }
+
+        const auto slot = static_cast<uint32_t>(m_ids.size());
+        m_slots[id]     = slot;
+        m_ids.push_back(id);
+
+        m_transforms.push_back(transform);
+        m_local_bounds.push_back(local_bounds);
+        m_mesh_ids.push_back(mesh_id);
+        m_pipeline_ids.push_back(pipeline_id);
+
+        m_center_x.push_back(0.0f);
+        m_center_y.push_back(0.0f);
+        m_center_z.push_back(0.0f);
+        m_radius.push_back(0.0f);
+        update_bounds(slot);
+
+        m_unsorted = true;
+        return id;
+    }
+
+    void InstanceStore::remove(const InstanceId id) {
+        const uint32_t slot = m_slots[id];
+        const uint32_t last = static_cast<uint32_t>(m_ids.size()) - 1;
+
+        // swap the last instance into the hole
+        const auto move_last = [&](auto &values) {
+            values[slot] = values[last];
+            values.pop_back();
+        };
+
+        move_last(m_center_x);
+        move_last(m_center_y);
+        move_last(m_center_z);
+        move_last(m_radius);
+        move_last(m_transforms);
+        move_last(m_local_bounds);
+        move_last(m_mesh_ids);
+        move_last(m_pipeline_ids);
+        move_last(m_ids);
+
+        if (slot != last) {
+            m_slots[m_ids[slot]] = slot;
+            m_unsorted           = true;
+        }
+
+        m_slots[id] = NO_SLOT;
+        m_free_ids.push_back(id);
+    }
+
+    void InstanceStore::set_transform(const InstanceId id, const glm::mat4 &transform) {
+        const uint32_t slot = m_slots[id];
+        m_transforms[slot]  = transform;
+        update_bounds(slot);
+    }
+
+    void InstanceStore::cull(const Frustum &frustum, std::vector<uint32_t> &visible) {
+        static const CullKernel kernel = select_cull_kernel();
+
+        sort();
+
+        visible.resize(m_ids.size());
+        visible.resize(kernel(CullInput{m_center_x.data(), m_center_y.data(), m_center_z.data(), m_radius.data(), m_ids.size()}, frustum, visible.data()));
+    }
+
+    void InstanceStore::submit(const std::span<const uint32_t> visible, InstanceBatcher &batcher, const std::span<const GraphicsPipeline *const> pipelines,
+                               const std::span<const Mesh *const> meshes) const {
+        for (const uint32_t slot : visible) {
+            batcher.add(pipelines[m_pipeline_ids[slot]], meshes[m_mesh_ids[slot]], m_transforms[slot]);
+        }
+    }
+
+    void InstanceStore::submit(const std::span<const uint32_t> visible, InstanceBatcher &batcher, const std::span<const GraphicsPipeline *const> pipelines,
+                               const std::span<const Mesh *const> meshes, LodSelector &lods, const glm::vec3 &camera_position) const {
+        std::vector<std::pair<uint32_t, uint32_t>> run; // lod, slot
+
+        // visible is grouped by pipeline and mesh, within each group instances are ordered by lod so the batcher can merge them
+        for (size_t begin = 0; begin < visible.size();) {
+            const uint32_t first = visible[begin];
+            size_t         end   = begin + 1;
+            while (end < visible.size() && m_pipeline_ids[visible[end]] == m_pipeline_ids[first] && m_mesh_ids[visible[end]] == m_mesh_ids[first]) {
+                end++;
+            }
+
+            const GraphicsPipeline *pipeline = pipelines[m_pipeline_ids[first]];
+            const Mesh             *mesh     = meshes[m_mesh_ids[first]];
+
+            run.clear();
+            for (size_t i = begin; i < end; i++) {
+                const uint32_t  slot     = visible[i];
+                const glm::vec3 center   = {m_center_x[slot], m_center_y[slot], m_center_z[slot]};
+                const float     distance = std::max(glm::length(center - camera_position) - m_radius[slot], 0.0f);
+                const float     local    = m_local_bounds[slot].radius;
+                const float     scale    = local > 0.0f ? m_radius[slot] / local : 1.0f;
+                run.emplace_back(lods.select(m_ids[slot], *mesh, distance, scale), slot);
+            }
+            std::ranges::stable_sort(run, {}, &std::pair<uint32_t, uint32_t>::first);
+
+            for (const auto &[lod, slot] : run) {
+                batcher.add(pipeline, mesh, m_transforms[slot], lod);
+            }
+
+            begin = end;
+        }
+    }
+
+    void InstanceStore::update_bounds(const uint32_t slot) {
+        const BoundingSphere world = m_local_bounds[slot].transformed(m_transforms[slot]);
+        m_center_x[slot]           = world.center.x;
+        m_center_y[slot]           = world.center.y;
+        m_center_z[slot]           = world.center.z;
+        m_radius[slot]             = world.radius;
+    }
+
+    void InstanceStore::sort() {
+        if (!m_unsorted)
+            return;
+
+        // sorting packed keys keeps the comparisons in cache, going through the arrays for every one is several times slower
+        struct SortKey {
+            uint64_t draw; // pipeline, then mesh
+            uint32_t id;
+            uint32_t slot;
+        };
+
+        std::vector<SortKey> keys(m_ids.size());
+        for (uint32_t slot = 0; slot < m_ids.size(); slot++) {
+            keys[slot] = {static_cast<uint64_t>(m_pipeline_ids[slot]) << 32 | m_mesh_ids[slot], m_ids[slot], slot};
+        }
+        std::ranges::sort(keys, [](const SortKey &a, const SortKey &b) { return std::tie(a.draw, a.id) < std::tie(b.draw, b.id); });
+
+        std::vector<uint32_t> order(keys.size());
+        std::ranges::transform(keys, order.begin(), &SortKey::slot);
+
+        const auto permute = [&](auto &values) {
+            std::remove_reference_t<decltype(values)> sorted;
+            sorted.reserve(values.size());
+            for (const uint32_t slot : order) {
+                sorted.push_back(values[slot]);
+            }
+
+            values = std::move(sorted);
+        };
+
+        permute(m_center_x);
+        permute(m_center_y);
+        permute(m_center_z);
+        permute(m_radius);
+        permute(m_transforms);
+        permute(m_local_bounds);
+        permute(m_mesh_ids);
+        permute(m_pipeline_ids);
+        permute(m_ids);
+
+        for (uint32_t slot = 0; slot < m_ids.size(); slot++) {
+            m_slots[m_ids[slot]] = slot;
+        }
+
+        m_unsorted = false;
+    }
+} // namespace vke
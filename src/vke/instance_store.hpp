@@ -0,0 +1,89 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <vector>
+
+#include "vke/bounds.hpp"
+#include "vke/instancing.hpp"
+#include "vke/mesh_lod.hpp"
+
+namespace vke {
+    // stays the same for as long as the instance exists, unlike its slot
+    using InstanceId = uint32_t;
+
+    /**
+     * @brief Every instance in a scene, kept as structure of arrays so culling only touches the bounds.
+     *
+     * Instances are stored in slots ordered by pipeline and then mesh (re-sorted on the next cull after instances are added or removed), so the visible set comes out of
+     * cull already grouped the way InstanceBatcher merges draws. Mesh and pipeline ids are indices into whatever tables the caller keeps, see submit.
+     */
+    class InstanceStore {
+      public:
+        InstanceStore() = default;
+
+        InstanceId add(const glm::mat4 &transform, const BoundingSphere &local_bounds, uint32_t mesh_id, uint32_t pipeline_id);
+        void       remove(InstanceId id);
+
+        void set_transform(InstanceId id, const glm::mat4 &transform);
+
+        [[nodiscard]] const glm::mat4 &transform(const InstanceId id) const { return m_transforms[m_slots[id]]; }
+
+        [[nodiscard]] size_t size() const { return m_ids.size(); }
+
+        // false once the instance is removed (until add hands out its id again)
+        [[nodiscard]] bool contains(const InstanceId id) const { return id < m_slots.size() && m_slots[id] != NO_SLOT; }
+
+        /**
+         * @brief Finds every instance whose bounding sphere intersects the frustum, 8 at a time with AVX (4 with SSE, or one by one without either).
+         *
+         * visible is overwritten with their slots, in slot order. Slots are only valid until the store changes.
+         */
+        void cull(const Frustum &frustum, std::vector<uint32_t> &visible);
+
+        // adds the given slots to the batcher with their transforms (a glm::mat4) as instance data. pipelines is indexed by each instance's pipeline_id and meshes by its mesh_id.
+        void submit(std::span<const uint32_t> visible, InstanceBatcher &batcher, std::span<const GraphicsPipeline *const> pipelines, std::span<const Mesh *const> meshes) const;
+
+        // the same, but every instance gets a lod picked by lods (keyed by instance id) from its distance to the camera. call LodSelector::begin_frame first.
+        void submit(std::span<const uint32_t> visible, InstanceBatcher &batcher, std::span<const GraphicsPipeline *const> pipelines, std::span<const Mesh *const> meshes,
+                    LodSelector &lods, const glm::vec3 &camera_position) const;
+
+        // re-sorts the slots by pipeline and mesh if instances were added or removed since the last sort. cull does this itself.
+        void sort();
+
+        [[nodiscard]] InstanceId id(const uint32_t slot) const { return m_ids[slot]; }
+
+        [[nodiscard]] uint32_t slot(const InstanceId id) const { return m_slots[id]; }
+
+        [[nodiscard]] BoundingSphere world_bounds(const InstanceId id) const {
+            const uint32_t slot = m_slots[id];
+            return {{m_center_x[slot], m_center_y[slot], m_center_z[slot]}, m_radius[slot]};
+        }
+
+        [[nodiscard]] std::span<const glm::mat4> transforms() const { return m_transforms; }
+
+      private:
+        static constexpr uint32_t NO_SLOT = std::numeric_limits<uint32_t>::max();
+
+        // world space bounding spheres, the only thing cull reads
+        std::vector<float> m_center_x;
+        std::vector<float> m_center_y;
+        std::vector<float> m_center_z;
+        std::vector<float> m_radius;
+
+        std::vector<glm::mat4>      m_transforms;
+        std::vector<BoundingSphere> m_local_bounds;
+        std::vector<uint32_t>       m_mesh_ids;
+        std::vector<uint32_t>       m_pipeline_ids;
+
+        std::vector<InstanceId> m_ids;      // by slot
+        std::vector<uint32_t>   m_slots;    // by id, NO_SLOT once removed
+        std::vector<InstanceId> m_free_ids; // reused by add
+        bool                    m_unsorted = false;
+
+        void update_bounds(uint32_t slot);
+    };
+} // namespace vke
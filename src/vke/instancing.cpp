@@ -0,0 +1,77 @@
+#include "instancing.hpp"
+
+#include "vke/defragmenter.hpp"
+
+namespace vke {
+    InstanceBuffer::InstanceBuffer(const std::shared_ptr<RenderContext> &rc, const size_t size, const void *data, const uint32_t stride, const MeshType type)
+        : m_rc(rc), m_stride(stride), m_instance_count(static_cast<uint32_t>(size / stride)) {
+        const MemoryUsage memory_usage = type == MeshType::Static ? MemoryUsage::DeviceOnly : MemoryUsage::Auto;
+
+        // relocatable the same way mesh buffers are
+        const BufferOptions options{
+            .queue_families = m_rc->graphics_transfer_queue_families(),
+            .category       = AllocationCategory::Mesh,
+        };
+        constexpr vk::BufferUsageFlags usage = vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst;
+
+        m_buffer = m_rc->create_buffer(size, data, memory_usage, usage, options);
+        m_rc->defragmenter().track(m_buffer);
+    }
+
+    InstanceBuffer::~InstanceBuffer() {
+        m_rc->destroy_buffer(m_buffer);
+    }
+
+    InstanceStream InstanceBuffer::stream(const uint32_t first_instance) const {
+        return {m_buffer.buffer, static_cast<vk::DeviceSize>(first_instance) * m_stride};
+    }
+
+    InstanceBatcher::InstanceBatcher(const uint32_t instance_stride, const uint32_t instance_binding) : m_instance_stride(instance_stride), m_instance_binding(instance_binding) {}
+
+    void InstanceBatcher::add(const GraphicsPipeline *pipeline, const Mesh *mesh, const void *instance_data, const uint32_t lod) {
+        const auto *bytes = static_cast<const unsigned char *>(instance_data);
+        m_instance_data.insert(m_instance_data.end(), bytes, bytes + m_instance_stride);
+        m_draws++;
+
+        if (!m_batches.empty() && m_batches.back().pipeline == pipeline && m_batches.back().mesh == mesh && m_batches.back().lod == lod) {
+            m_batches.back().instance_count++;
+            return;
+        }
+
+        const uint32_t first_instance = m_batches.empty() ? 0 : m_batches.back().first_instance + m_batches.back().instance_count;
+        m_batches.push_back(Batch{pipeline, mesh, lod, first_instance, 1});
+    }
+
+    void InstanceBatcher::flush(const ActiveRenderer &renderer, FrameRing &ring) {
+        m_stats = {m_draws, static_cast<uint32_t>(m_batches.size())};
+        if (m_batches.empty())
+            return;
+
+        const InstanceStream stream = instance_stream(ring.push_range(m_instance_data));
+        renderer.bind_instance_streams(std::span(&stream, 1), m_instance_binding);
+
+        const GraphicsPipeline *bound_pipeline = nullptr;
+        const Mesh             *bound_mesh     = nullptr;
+        for (const auto &batch : m_batches) {
+            if (batch.pipeline != bound_pipeline) {
+                renderer.bind_graphics_pipeline(batch.pipeline);
+                bound_pipeline = batch.pipeline;
+            }
+
+            if (batch.mesh != bound_mesh) {
+                renderer.bind_mesh(batch.mesh);
+                bound_mesh = batch.mesh;
+            }
+
+            renderer.draw_lod(batch.mesh, batch.lod, batch.instance_count, batch.first_instance);
+        }
+
+        clear();
+    }
+
+    void InstanceBatcher::clear() {
+        m_batches.clear();
+        m_instance_data.clear();
+        m_draws = 0;
+    }
+} // namespace vke
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <memory>
+#include <ranges>
+#include <vector>
+
+#include "vke/frame_ring.hpp"
+#include "vke/mesh.hpp"
+#include "vke/renderer.hpp"
+#include "vke/util.hpp"
+
+namespace vke {
+    // for instance data which is rewritten every frame
+    [[nodiscard]] inline InstanceStream instance_stream(const RingAllocation &allocation) { return {allocation.buffer, allocation.offset}; }
+
+    // instance data which lives across frames (static placements, etc.)
+    class InstanceBuffer {
+      public:
+        InstanceBuffer(const std::shared_ptr<RenderContext> &rc, size_t size, const void *data, uint32_t stride, MeshType type = MeshType::Static);
+        ~InstanceBuffer();
+
+        template <std::ranges::contiguous_range Range>
+        InstanceBuffer(const std::shared_ptr<RenderContext> &rc, Range &&instances, const MeshType type = MeshType::Static)
+            : InstanceBuffer(rc, byte_size(instances), std::ranges::data(instances), sizeof(std::ranges::range_value_t<Range>), type) {}
+
+        InstanceBuffer(const InstanceBuffer &other)                = delete;
+        InstanceBuffer &operator=(const InstanceBuffer &other)     = delete;
+        InstanceBuffer(InstanceBuffer &&other) noexcept            = delete;
+        InstanceBuffer &operator=(InstanceBuffer &&other) noexcept = delete;
+
+        // the buffer can be moved by the defragmenter, so get a fresh stream every frame instead of holding on to one
+        [[nodiscard]] InstanceStream stream(uint32_t first_instance = 0) const;
+
+        [[nodiscard]] const BufferInfo &buffer() const { return m_buffer; }
+
+        [[nodiscard]] uint32_t instance_count() const { return m_instance_count; }
+
+        [[nodiscard]] uint32_t stride() const { return m_stride; }
+
+      private:
+        std::shared_ptr<RenderContext> m_rc;
+        BufferInfo                     m_buffer;
+        uint32_t                       m_stride;
+        uint32_t                       m_instance_count;
+    };
+
+    struct InstanceBatcherStats {
+        uint32_t draws   = 0; // calls to add
+        uint32_t batches = 0; // instanced draws actually recorded
+    };
+
+    /**
+     * @brief Merges consecutive draws of the same mesh with the same pipeline into single instanced draws.
+     *
+     * Instance data for every draw is gathered on the cpu and written to the frame ring in one go when flushed, then bound once as a single instance stream. Each batch draws its
+     * slice of that stream through firstInstance, so only meshes and pipelines get rebound between batches. Only consecutive draws are merged, so sort by pipeline and mesh first
+     * to get the most out of it.
+     *
+     * Every pipeline used has to read the instance data from a VertexBufferBinding with eInstance input rate at the batcher's instance binding.
+     */
+    class InstanceBatcher {
+      public:
+        explicit InstanceBatcher(uint32_t instance_stride, uint32_t instance_binding = 1);
+
+        // lod is drawn with ActiveRenderer::draw_lod, different lods of the same mesh are separate batches
+        void add(const GraphicsPipeline *pipeline, const Mesh *mesh, const void *instance_data, uint32_t lod = 0);
+
+        template <typename T>
+            requires std::is_trivially_copyable_v<T>
+        void add(const GraphicsPipeline *pipeline, const Mesh *mesh, const T &instance, const uint32_t lod = 0) {
+            assert(sizeof(T) == m_instance_stride);
+            add(pipeline, mesh, &instance, lod);
+        }
+
+        // records every batch and clears the batcher. the pipelines' descriptor sets must already be bound.
+        void flush(const ActiveRenderer &renderer, FrameRing &ring);
+
+        void clear();
+
+        // stats for the last flush
+        [[nodiscard]] InstanceBatcherStats stats() const { return m_stats; }
+
+      private:
+        struct Batch {
+            const GraphicsPipeline *pipeline;
+            const Mesh             *mesh;
+            uint32_t                lod;
+            uint32_t                first_instance;
+            uint32_t                instance_count;
+        };
+
+        uint32_t m_instance_stride;
+        uint32_t m_instance_binding;
+
+        std::vector<Batch>         m_batches;
+        std::vector<unsigned char> m_instance_data;
+        uint32_t                   m_draws = 0;
+
+        InstanceBatcherStats m_stats;
+    };
+} // namespace vke
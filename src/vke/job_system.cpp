@@ -0,0 +1,407 @@
+#include "job_system.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <exception>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace vke {
+    /**
+     * @brief Jobs handed out by one thread. Whichever thread runs a job pushes it back onto returned, and the owner takes all of them back once free runs out.
+     *
+     * The pool only grows, in chunks, so after the first frames jobs are recycled without touching the heap. Everything is freed along with the JobSystem.
+     */
+    struct JobPool {
+        static constexpr size_t CHUNK_SIZE = 64;
+
+        Job               *free     = nullptr; // only touched by the thread allocating from the pool
+        std::atomic<Job *> returned = nullptr;
+
+        std::vector<std::unique_ptr<Job[]>> chunks;
+
+        Job *take() {
+            if (free == nullptr)
+                free = returned.exchange(nullptr, std::memory_order_acquire);
+
+            if (free == nullptr) {
+                const auto &chunk = chunks.emplace_back(std::make_unique<Job[]>(CHUNK_SIZE));
+                for (size_t i = 0; i < CHUNK_SIZE; i++) {
+                    chunk[i].pool = this;
+                    chunk[i].next = i + 1 < CHUNK_SIZE ? &chunk[i + 1] : nullptr;
+                }
+                free = &chunk[0];
+            }
+
+            Job *job = free;
+            free     = job->next;
+            return job;
+        }
+
+        // only one thread takes from returned and it takes everything at once, so pushing can't run into ABA
+        static void give_back(Job *job) {
+            job->destroy(*job);
+            job->invoke = nullptr;
+
+            JobPool &pool = *job->pool;
+            job->next     = pool.returned.load(std::memory_order_relaxed);
+            while (!pool.returned.compare_exchange_weak(job->next, job, std::memory_order_release, std::memory_order_relaxed)) {
+            }
+        }
+    };
+
+    /**
+     * @brief Chase-Lev work stealing deque ("Correct and Efficient Work-Stealing for Weak Memory Models", Lê et al. 2013).
+     *
+     * Only the owning worker pushes and pops, at the bottom. Any thread may steal from the top. The array grows when full, old arrays are kept until the deque is destroyed since
+     * a thief may still be reading from one.
+     */
+    class JobDeque {
+      public:
+        JobDeque() { m_array.store(grow_to(INITIAL_CAPACITY), std::memory_order_relaxed); }
+
+        void push(Job *job) {
+            const int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+            const int64_t top    = m_top.load(std::memory_order_acquire);
+            Array        *array  = m_array.load(std::memory_order_relaxed);
+            if (bottom - top > static_cast<int64_t>(array->mask)) {
+                array = grow(array, top, bottom);
+            }
+
+            array->put(bottom, job);
+            std::atomic_thread_fence(std::memory_order_release);
+            m_bottom.store(bottom + 1, std::memory_order_relaxed);
+        }
+
+        Job *pop() {
+            const int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+            Array        *array  = m_array.load(std::memory_order_relaxed);
+            m_bottom.store(bottom, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t top = m_top.load(std::memory_order_relaxed);
+
+            if (top > bottom) {
+                // empty
+                m_bottom.store(bottom + 1, std::memory_order_relaxed);
+                return nullptr;
+            }
+
+            Job *job = array->get(bottom);
+            if (top == bottom) {
+                // the last job, which a thief may be taking at the same time
+                if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                    job = nullptr;
+
+                m_bottom.store(bottom + 1, std::memory_order_relaxed);
+            }
+
+            return job;
+        }
+
+        Job *steal() {
+            int64_t top = m_top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            const int64_t bottom = m_bottom.load(std::memory_order_acquire);
+            if (top >= bottom)
+                return nullptr;
+
+            Job *job = m_array.load(std::memory_order_acquire)->get(top);
+            if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                return nullptr; // lost the race to the owner or another thief
+
+            return job;
+        }
+
+      private:
+        static constexpr size_t INITIAL_CAPACITY = 256;
+
+        struct Array {
+            size_t                                mask; // capacity - 1, the capacity is a power of two
+            std::unique_ptr<std::atomic<Job *>[]> slots;
+
+            [[nodiscard]] Job *get(const int64_t index) const { return slots[static_cast<size_t>(index) & mask].load(std::memory_order_acquire); }
+
+            void put(const int64_t index, Job *job) const { slots[static_cast<size_t>(index) & mask].store(job, std::memory_order_release); }
+        };
+
+        // top and bottom on separate cache lines, since thieves hammer one and the owner the other
+        alignas(64) std::atomic<int64_t>    m_top    = 0;
+        alignas(64) std::atomic<int64_t>    m_bottom = 0;
+        std::atomic<Array *>                m_array;
+        std::vector<std::unique_ptr<Array>> m_arrays; // every array so far, only touched by the owner
+
+        Array *grow_to(const size_t capacity) {
+            auto array = std::make_unique<Array>(capacity - 1, std::make_unique<std::atomic<Job *>[]>(capacity));
+            return m_arrays.emplace_back(std::move(array)).get();
+        }
+
+        Array *grow(const Array *array, const int64_t top, const int64_t bottom) {
+            Array *grown = grow_to((array->mask + 1) * 2);
+            for (int64_t i = top; i < bottom; i++) {
+                grown->put(i, array->get(i));
+            }
+
+            m_array.store(grown, std::memory_order_release);
+            return grown;
+        }
+    };
+
+    struct JobSystem::Worker {
+        JobDeque     deque;
+        JobPool      pool;
+        uint32_t     steal_seed;
+        std::jthread thread;
+    };
+
+    // which system's worker the current thread is, if any
+    static thread_local const JobSystem *t_system       = nullptr;
+    static thread_local uint32_t         t_thread_index = 0;
+
+    static void pin_thread(std::jthread &thread, const uint32_t core) {
+#ifdef _WIN32
+        SetThreadAffinityMask(thread.native_handle(), DWORD_PTR{1} << core);
+#elif defined(__linux__)
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(core, &set);
+        pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+#else
+        (void)thread;
+        (void)core;
+#endif
+    }
+
+    JobSystem::JobSystem(const JobSystemSettings &settings) : m_external_pool(std::make_unique<JobPool>()) {
+        const uint32_t cores        = std::max(std::thread::hardware_concurrency(), 1u);
+        const uint32_t worker_count = settings.worker_count != 0 ? settings.worker_count : std::max(cores, 2u) - 1;
+
+        // every deque exists before any worker starts stealing from it
+        m_workers.reserve(worker_count);
+        for (uint32_t i = 0; i < worker_count; i++) {
+            m_workers.push_back(std::make_unique<Worker>());
+            m_workers.back()->steal_seed = i + 1;
+        }
+
+        for (uint32_t i = 0; i < worker_count; i++) {
+            m_workers[i]->thread = std::jthread([this, i] { worker_main(i + 1); });
+            if (settings.pin_threads && worker_count < cores) {
+                pin_thread(m_workers[i]->thread, i + 1);
+            }
+        }
+
+        spdlog::debug("Started {} job workers", worker_count);
+    }
+
+    JobSystem::~JobSystem() {
+        m_stopping.store(true, std::memory_order_release);
+        m_wake.fetch_add(1, std::memory_order_release);
+        m_wake.notify_all();
+
+        for (const auto &worker : m_workers) {
+            worker->thread.join();
+        }
+
+        // whatever is still holding a callable never ran, wherever it was queued (deques, the injected queue or a counter's waiting list)
+        const auto destroy_unfinished = [](const JobPool &pool) {
+            for (const auto &chunk : pool.chunks) {
+                for (size_t i = 0; i < JobPool::CHUNK_SIZE; i++) {
+                    if (chunk[i].invoke != nullptr)
+                        chunk[i].destroy(chunk[i]);
+                }
+            }
+        };
+
+        for (const auto &worker : m_workers) {
+            destroy_unfinished(worker->pool);
+        }
+        destroy_unfinished(*m_external_pool);
+    }
+
+    Job *JobSystem::allocate_job() {
+        if (const uint32_t index = thread_index(); index != 0)
+            return m_workers[index - 1]->pool.take();
+
+        std::lock_guard lock(m_external_pool_mutex);
+        return m_external_pool->take();
+    }
+
+    void JobSystem::submit(Job *job, JobCounter *counter) {
+        job->counter = counter;
+        if (counter != nullptr)
+            counter->m_count.fetch_add(1, std::memory_order_relaxed);
+
+        schedule(job);
+    }
+
+    void JobSystem::submit_after(JobCounter &dependency, Job *job, JobCounter *counter) {
+        job->counter = counter;
+        if (counter != nullptr)
+            counter->m_count.fetch_add(1, std::memory_order_relaxed);
+
+        {
+            std::lock_guard lock(dependency.m_mutex);
+            if (dependency.m_count.load(std::memory_order_acquire) != 0) {
+                job->next            = dependency.m_waiting;
+                dependency.m_waiting = job;
+                return;
+            }
+        }
+
+        schedule(job);
+    }
+
+    void JobSystem::wait(JobCounter &counter) {
+        const uint32_t index = thread_index();
+        while (!counter.done()) {
+            if (Job *job = find_job(index)) {
+                execute(job);
+            } else {
+                std::this_thread::yield();
+            }
+        }
+
+        // the job which brought the count to zero may still be handing off waiting jobs, which has to be done before the counter can go away
+        std::lock_guard lock(counter.m_mutex);
+    }
+
+    uint32_t JobSystem::thread_index() const { return t_system == this ? t_thread_index : 0; }
+
+    void JobSystem::schedule(Job *job) {
+        if (const uint32_t index = thread_index(); index != 0) {
+            m_workers[index - 1]->deque.push(job);
+        } else {
+            std::lock_guard lock(m_injected_mutex);
+            job->next = nullptr;
+            if (m_injected_tail != nullptr) {
+                m_injected_tail->next = job;
+            } else {
+                m_injected_head = job;
+            }
+            m_injected_tail = job;
+        }
+
+        m_wake.fetch_add(1, std::memory_order_release);
+        m_wake.notify_one();
+    }
+
+    Job *JobSystem::find_job(const uint32_t thread_index) {
+        // newest own job first, it's the most likely to still be in cache
+        if (thread_index != 0) {
+            if (Job *job = m_workers[thread_index - 1]->deque.pop())
+                return job;
+        }
+
+        if (Job *job = take_injected())
+            return job;
+
+        if (m_workers.empty())
+            return nullptr;
+
+        // steal, starting from a random worker so thieves spread out
+        uint32_t start = 0;
+        if (thread_index != 0) {
+            uint32_t &seed = m_workers[thread_index - 1]->steal_seed;
+            seed ^= seed << 13;
+            seed ^= seed >> 17;
+            seed ^= seed << 5;
+            start = seed;
+        }
+
+        for (uint32_t i = 0; i < m_workers.size(); i++) {
+            const uint32_t victim = (start + i) % static_cast<uint32_t>(m_workers.size());
+            if (victim + 1 == thread_index)
+                continue;
+
+            if (Job *job = m_workers[victim]->deque.steal())
+                return job;
+        }
+
+        return nullptr;
+    }
+
+    Job *JobSystem::take_injected() {
+        std::lock_guard lock(m_injected_mutex);
+        Job            *job = m_injected_head;
+        if (job != nullptr) {
+            m_injected_head = job->next;
+            if (m_injected_head == nullptr)
+                m_injected_tail = nullptr;
+        }
+        return job;
+    }
+
+    void JobSystem::execute(Job *job) {
+        try {
+            job->invoke(*job);
+        } catch (const std::exception &e) {
+            spdlog::error("Job threw an exception: {}", e.what());
+        } catch (...) {
+            spdlog::error("Job threw an unknown exception");
+        }
+
+        // the callable is destroyed before the counter drops, so nothing it captured outlives a wait on it
+        JobCounter *counter = job->counter;
+        JobPool::give_back(job);
+        if (counter != nullptr)
+            finish(*counter);
+    }
+
+    void JobSystem::finish(JobCounter &counter) {
+        Job *ready = nullptr;
+        {
+            std::lock_guard lock(counter.m_mutex);
+            if (counter.m_count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                ready = std::exchange(counter.m_waiting, nullptr);
+        }
+
+        while (ready != nullptr) {
+            Job *job = ready;
+            ready    = ready->next; // schedule reuses next
+            schedule(job);
+        }
+    }
+
+    void JobSystem::worker_main(const uint32_t index) {
+        t_system       = this;
+        t_thread_index = index;
+
+        // spin for a bit before sleeping, since more work usually shows up soon within a frame
+        static constexpr uint32_t SPIN_COUNT = 64;
+
+        while (!m_stopping.load(std::memory_order_acquire)) {
+            if (Job *job = find_job(index)) {
+                execute(job);
+                continue;
+            }
+
+            bool found = false;
+            for (uint32_t spin = 0; spin < SPIN_COUNT && !found; spin++) {
+                std::this_thread::yield();
+                if (Job *job = find_job(index)) {
+                    execute(job);
+                    found = true;
+                }
+            }
+            if (found)
+                continue;
+
+            // jobs queued after this load bump m_wake, so the wait returns right away instead of missing them
+            const uint32_t wake = m_wake.load(std::memory_order_acquire);
+            if (Job *job = find_job(index)) {
+                execute(job);
+                continue;
+            }
+
+            if (!m_stopping.load(std::memory_order_acquire))
+                m_wake.wait(wake, std::memory_order_acquire);
+        }
+    }
+} // namespace vke
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace vke {
+    class JobCounter;
+    struct JobPool;
+
+    /**
+     * @brief A queued job, recycled through the JobSystem's pools so queueing one doesn't go through the heap.
+     *
+     * Callables which fit into storage are kept inline, bigger ones are moved to the heap.
+     */
+    struct Job {
+        static constexpr size_t STORAGE_SIZE = 80;
+
+        alignas(64) std::byte storage[STORAGE_SIZE];
+        void (*invoke)(Job &job)  = nullptr; // null while the job is in a pool
+        void (*destroy)(Job &job) = nullptr;
+        JobCounter *counter       = nullptr;
+        JobPool    *pool          = nullptr; // the pool it goes back to once it has run
+        Job        *next          = nullptr; // links jobs in a pool, the injected queue or a counter's waiting list
+
+        template <typename F>
+        void store(F &&f) {
+            using T = std::decay_t<F>;
+            if constexpr (sizeof(T) <= STORAGE_SIZE && alignof(T) <= alignof(Job)) {
+                new (storage) T(std::forward<F>(f));
+                invoke  = [](Job &job) { (*std::launder(reinterpret_cast<T *>(job.storage)))(); };
+                destroy = [](Job &job) { std::destroy_at(std::launder(reinterpret_cast<T *>(job.storage))); };
+            } else {
+                new (storage) T *(new T(std::forward<F>(f)));
+                invoke  = [](Job &job) { (**std::launder(reinterpret_cast<T **>(job.storage)))(); };
+                destroy = [](Job &job) { delete *std::launder(reinterpret_cast<T **>(job.storage)); };
+            }
+        }
+    };
+
+    static_assert(sizeof(Job) == 128);
+
+    /**
+     * @brief Counts unfinished jobs, for waiting on them or running other jobs after them.
+     *
+     * Jobs given a counter increment it when they're queued and decrement it once they've run. It's fine to reuse a counter once it's back at zero. Don't destroy one while jobs
+     * still reference it, JobSystem::wait makes sure the last job is completely done with it. Jobs still held back by run_after on a destroyed counter never run, they're freed
+     * along with the JobSystem.
+     */
+    class JobCounter {
+      public:
+        JobCounter() = default;
+
+        JobCounter(const JobCounter &other)                = delete;
+        JobCounter &operator=(const JobCounter &other)     = delete;
+        JobCounter(JobCounter &&other) noexcept            = delete;
+        JobCounter &operator=(JobCounter &&other) noexcept = delete;
+
+        [[nodiscard]] bool done() const { return m_count.load(std::memory_order_acquire) == 0; }
+
+      private:
+        friend class JobSystem;
+
+        std::atomic<uint32_t> m_count = 0;
+        std::mutex            m_mutex;             // guards m_waiting, and is held while the count drops to zero
+        Job                  *m_waiting = nullptr; // queued once the count drops to zero
+    };
+
+    struct JobSystemSettings {
+        uint32_t worker_count = 0;    // 0 for one less than the hardware threads (at least 1), leaving a core for the thread recording frames
+        bool     pin_threads  = true; // pins worker n to core n + 1, so workers don't migrate between cores and lose their caches
+    };
+
+    /**
+     * @brief A work stealing job scheduler, for spreading a frame's work (culling, command recording, uploads, shader compilation) over every core.
+     *
+     * Every worker has its own Chase-Lev deque. Jobs queued from a worker go to the bottom of its deque and it takes its newest job first, which keeps related work on the same
+     * core while it's still in cache. Idle workers steal the oldest jobs from the top of other deques. Jobs queued from other threads go through a shared queue.
+     *
+     * Dependencies are expressed through counters: run_after holds a job back until a counter reaches zero, so a frame's passes can be chained into a graph without any thread
+     * blocking. wait helps with queued jobs instead of sleeping, so it can be called from inside a job as well.
+     *
+     * Jobs come from per-thread pools and are handed back to the pool they came from once they've run, so after the first frames queueing a job doesn't allocate unless its
+     * callable is bigger than Job::STORAGE_SIZE. Jobs shouldn't throw: an exception is logged and the job still counts as finished, so waits on its counter don't hang.
+     */
+    class JobSystem {
+      public:
+        explicit JobSystem(const JobSystemSettings &settings = {});
+
+        // jobs which haven't started yet are dropped, wait on their counters first. that includes ones still held back by run_after.
+        ~JobSystem();
+
+        JobSystem(const JobSystem &other)                = delete;
+        JobSystem &operator=(const JobSystem &other)     = delete;
+        JobSystem(JobSystem &&other) noexcept            = delete;
+        JobSystem &operator=(JobSystem &&other) noexcept = delete;
+
+        template <typename F>
+            requires std::is_invocable_v<std::decay_t<F> &>
+        void run(F &&f, JobCounter *counter = nullptr) {
+            Job *job = allocate_job();
+            job->store(std::forward<F>(f));
+            submit(job, counter);
+        }
+
+        // runs f once dependency reaches zero (right away if it already has)
+        template <typename F>
+            requires std::is_invocable_v<std::decay_t<F> &>
+        void run_after(JobCounter &dependency, F &&f, JobCounter *counter = nullptr) {
+            Job *job = allocate_job();
+            job->store(std::forward<F>(f));
+            submit_after(dependency, job, counter);
+        }
+
+        // calls f(begin, end) for batches of at most batch_size (at least 1) of [0, count). every batch gets its own copy of f, so capture big state by reference.
+        template <typename F>
+            requires std::is_invocable_v<std::decay_t<F> &, uint32_t, uint32_t> && std::copy_constructible<std::decay_t<F>>
+        void parallel_for(const uint32_t count, uint32_t batch_size, F &&f, JobCounter &counter) {
+            batch_size = std::max(batch_size, 1u);
+            for (uint32_t begin = 0; begin < count;) {
+                const uint32_t end = begin + std::min(batch_size, count - begin);
+                run([f, begin, end]() mutable { f(begin, end); }, &counter);
+                begin = end;
+            }
+        }
+
+        // runs queued jobs until the counter reaches zero
+        void wait(JobCounter &counter);
+
+        [[nodiscard]] uint32_t worker_count() const { return static_cast<uint32_t>(m_workers.size()); }
+
+        // 1 + the worker's index on this system's workers, 0 on any other thread. for per-thread resources (ie. command pools), worker_count() + 1 of them.
+        [[nodiscard]] uint32_t thread_index() const;
+
+      private:
+        struct Worker;
+
+        std::vector<std::unique_ptr<Worker>> m_workers;
+
+        std::mutex               m_external_pool_mutex;
+        std::unique_ptr<JobPool> m_external_pool; // jobs queued from threads which aren't workers
+
+        std::mutex m_injected_mutex;
+        Job       *m_injected_head = nullptr; // jobs queued from threads which aren't workers, taken oldest first
+        Job       *m_injected_tail = nullptr;
+
+        std::atomic<uint32_t> m_wake     = 0; // bumped whenever a job is queued, idle workers sleep on it
+        std::atomic<bool>     m_stopping = false;
+
+        Job *allocate_job();
+        void submit(Job *job, JobCounter *counter);
+        void submit_after(JobCounter &dependency, Job *job, JobCounter *counter);
+        void schedule(Job *job);
+        Job *find_job(uint32_t thread_index);
+        Job *take_injected();
+        void execute(Job *job);
+        void finish(JobCounter &counter);
+        void worker_main(uint32_t index);
+    };
+} // namespace vke
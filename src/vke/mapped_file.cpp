@@ -0,0 +1,140 @@
+#include "mapped_file.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace vke {
+#ifdef _WIN32
+    MappedFile::MappedFile(const std::filesystem::path &path) {
+        m_file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (m_file == INVALID_HANDLE_VALUE) {
+            m_file = nullptr;
+            throw std::runtime_error("Failed to open " + path.string());
+        }
+
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(m_file, &size)) {
+            close();
+            throw std::runtime_error("Failed to get the size of " + path.string());
+        }
+        m_size = static_cast<size_t>(size.QuadPart);
+
+        // empty files can't be mapped
+        if (m_size == 0)
+            return;
+
+        m_mapping = CreateFileMappingW(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (m_mapping != nullptr) {
+            m_data = static_cast<const std::byte *>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+        }
+
+        if (m_data == nullptr) {
+            close();
+            throw std::runtime_error("Failed to map " + path.string());
+        }
+    }
+
+    void MappedFile::close() {
+        if (m_data != nullptr)
+            UnmapViewOfFile(m_data);
+        if (m_mapping != nullptr)
+            CloseHandle(m_mapping);
+        if (m_file != nullptr)
+            CloseHandle(m_file);
+
+        m_data    = nullptr;
+        m_mapping = nullptr;
+        m_file    = nullptr;
+        m_size    = 0;
+    }
+
+    void MappedFile::prefetch(const size_t offset, const size_t size) const {
+        if (m_data == nullptr || offset >= m_size)
+            return;
+
+        WIN32_MEMORY_RANGE_ENTRY range{const_cast<std::byte *>(m_data + offset), std::min(size, m_size - offset)};
+        PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+    }
+#else
+    MappedFile::MappedFile(const std::filesystem::path &path) {
+        const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            throw std::runtime_error("Failed to open " + path.string());
+        }
+
+        struct stat st{};
+        if (fstat(fd, &st) != 0) {
+            ::close(fd);
+            throw std::runtime_error("Failed to get the size of " + path.string());
+        }
+        m_size = static_cast<size_t>(st.st_size);
+
+        // empty files can't be mapped
+        if (m_size == 0) {
+            ::close(fd);
+            return;
+        }
+
+        void *data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd); // the mapping keeps the file alive
+        if (data == MAP_FAILED) {
+            m_size = 0;
+            throw std::runtime_error("Failed to map " + path.string());
+        }
+
+        m_data = static_cast<const std::byte *>(data);
+        madvise(data, m_size, MADV_SEQUENTIAL);
+    }
+
+    void MappedFile::close() {
+        if (m_data != nullptr)
+            munmap(const_cast<std::byte *>(m_data), m_size);
+
+        m_data = nullptr;
+        m_size = 0;
+    }
+
+    void MappedFile::prefetch(const size_t offset, const size_t size) const {
+        if (m_data == nullptr || offset >= m_size)
+            return;
+
+        // madvise wants a page aligned start
+        const auto page  = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        const auto start = offset & ~(page - 1);
+        madvise(const_cast<std::byte *>(m_data + start), std::min(size, m_size - offset) + (offset - start), MADV_WILLNEED);
+    }
+#endif
+
+    MappedFile::~MappedFile() {
+        close();
+    }
+
+    MappedFile::MappedFile(MappedFile &&other) noexcept {
+        *this = std::move(other);
+    }
+
+    MappedFile &MappedFile::operator=(MappedFile &&other) noexcept {
+        if (this != &other) {
+            close();
+            m_data = std::exchange(other.m_data, nullptr);
+            m_size = std::exchange(other.m_size, 0);
+#ifdef _WIN32
+            m_file    = std::exchange(other.m_file, nullptr);
+            m_mapping = std::exchange(other.m_mapping, nullptr);
+#endif
+        }
+        return *this;
+    }
+} // namespace vke
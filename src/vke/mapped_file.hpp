@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <span>
+
+namespace vke {
+    // read only memory mapping of a whole file
+    class MappedFile {
+      public:
+        explicit MappedFile(const std::filesystem::path &path);
+        ~MappedFile();
+
+        MappedFile(const MappedFile &other)            = delete;
+        MappedFile &operator=(const MappedFile &other) = delete;
+        MappedFile(MappedFile &&other) noexcept;
+        MappedFile &operator=(MappedFile &&other) noexcept;
+
+        [[nodiscard]] const std::byte *data() const { return m_data; }
+
+        [[nodiscard]] size_t size() const { return m_size; }
+
+        [[nodiscard]] std::span<const std::byte> bytes() const { return {m_data, m_size}; }
+
+        // hints that a range is about to be read front to back, so the os can start reading ahead
+        void prefetch(size_t offset, size_t size) const;
+
+      private:
+        const std::byte *m_data = nullptr;
+        size_t           m_size = 0;
+
+#ifdef _WIN32
+        void *m_file    = nullptr;
+        void *m_mapping = nullptr;
+#endif
+
+        void close();
+    };
+} // namespace vke
@@ -0,0 +1,123 @@
+#include "memory_budget.hpp"
+
+#include <spdlog/spdlog.h>
+
+namespace vke {
+    MemoryBudget::MemoryBudget(const VmaAllocator allocator) : m_allocator(allocator) {
+        const VkPhysicalDeviceMemoryProperties *memory_properties;
+        vmaGetMemoryProperties(m_allocator, &memory_properties);
+
+        m_heap_flags.reserve(memory_properties->memoryHeapCount);
+        for (uint32_t i = 0; i < memory_properties->memoryHeapCount; i++) {
+            m_heap_flags.emplace_back(memory_properties->memoryHeaps[i].flags);
+        }
+    }
+
+    void MemoryBudget::poll() {
+        read_heap_budgets(m_polled_heaps);
+        const auto &heaps = m_polled_heaps;
+
+        std::vector<std::pair<BudgetThresholdCallback, BudgetThresholdEvent>> events;
+        {
+            std::lock_guard lock(m_threshold_mutex);
+            for (auto &threshold : m_thresholds) {
+                for (uint32_t i = 0; i < heaps.size(); i++) {
+                    if ((heaps[i].flags & threshold.heap_filter) != threshold.heap_filter || heaps[i].budget == 0)
+                        continue;
+
+                    const float fraction = heaps[i].usage_fraction();
+                    if (!threshold.exceeded[i] && fraction >= threshold.fraction) {
+                        threshold.exceeded[i] = true;
+                        events.emplace_back(threshold.callback, BudgetThresholdEvent{i, threshold.fraction, true, heaps[i]});
+                    } else if (threshold.exceeded[i] && fraction < threshold.fraction - THRESHOLD_HYSTERESIS) {
+                        threshold.exceeded[i] = false;
+                        events.emplace_back(threshold.callback, BudgetThresholdEvent{i, threshold.fraction, false, heaps[i]});
+                    }
+                }
+            }
+        }
+
+        // callbacks run outside of the lock so they are free to add or remove thresholds
+        for (const auto &[callback, event] : events) {
+            spdlog::debug("Heap {} usage {} {:.0f}% of budget ({} / {} bytes)", event.heap_index, event.rising ? "rose above" : "dropped below", event.threshold * 100.0f,
+                          event.heap.usage, event.heap.budget);
+            callback(event);
+        }
+    }
+
+    std::vector<HeapBudget> MemoryBudget::heap_budgets() const {
+        std::vector<HeapBudget> heaps;
+        read_heap_budgets(heaps);
+        return heaps;
+    }
+
+    void MemoryBudget::read_heap_budgets(std::vector<HeapBudget> &heaps) const {
+        std::array<VmaBudget, VK_MAX_MEMORY_HEAPS> budgets{};
+        vmaGetHeapBudgets(m_allocator, budgets.data());
+
+        heaps.clear();
+        heaps.reserve(m_heap_flags.size());
+        for (uint32_t i = 0; i < m_heap_flags.size(); i++) {
+            const auto &b = budgets[i];
+            heaps.push_back(HeapBudget{
+                .flags            = m_heap_flags[i],
+                .usage            = b.usage,
+                .budget           = b.budget,
+                .block_bytes      = b.statistics.blockBytes,
+                .allocation_bytes = b.statistics.allocationBytes,
+                .block_count      = b.statistics.blockCount,
+                .allocation_count = b.statistics.allocationCount,
+            });
+        }
+    }
+
+    MemoryStatistics MemoryBudget::calculate_statistics() const {
+        VmaTotalStatistics total{};
+        vmaCalculateStatistics(m_allocator, &total);
+
+        MemoryStatistics stats{};
+        stats.heaps = heap_budgets();
+        for (size_t i = 0; i < ALLOCATION_CATEGORY_COUNT; i++) {
+            stats.categories[i] = category_usage(static_cast<AllocationCategory>(i));
+        }
+
+        stats.block_count           = total.total.statistics.blockCount;
+        stats.allocation_count      = total.total.statistics.allocationCount;
+        stats.unused_range_count    = total.total.unusedRangeCount;
+        stats.block_bytes           = total.total.statistics.blockBytes;
+        stats.allocation_bytes      = total.total.statistics.allocationBytes;
+        stats.allocation_size_max   = total.total.allocationSizeMax;
+        stats.unused_range_size_max = total.total.unusedRangeSizeMax;
+
+        return stats;
+    }
+
+    CategoryUsage MemoryBudget::category_usage(const AllocationCategory category) const {
+        const auto i = static_cast<size_t>(category);
+        return {m_category_counts[i].load(std::memory_order_relaxed), m_category_bytes[i].load(std::memory_order_relaxed)};
+    }
+
+    uint32_t MemoryBudget::add_threshold(const float fraction, BudgetThresholdCallback callback, const vk::MemoryHeapFlags heap_filter) {
+        std::lock_guard lock(m_threshold_mutex);
+        const uint32_t  id = m_next_threshold_id++;
+        m_thresholds.push_back(Threshold{id, fraction, heap_filter, std::move(callback), std::vector<bool>(m_heap_flags.size(), false)});
+        return id;
+    }
+
+    void MemoryBudget::remove_threshold(const uint32_t id) {
+        std::lock_guard lock(m_threshold_mutex);
+        std::erase_if(m_thresholds, [id](const Threshold &threshold) { return threshold.id == id; });
+    }
+
+    void MemoryBudget::track_allocation(const AllocationCategory category, const vk::DeviceSize size) {
+        const auto i = static_cast<size_t>(category);
+        m_category_counts[i].fetch_add(1, std::memory_order_relaxed);
+        m_category_bytes[i].fetch_add(size, std::memory_order_relaxed);
+    }
+
+    void MemoryBudget::track_free(const AllocationCategory category, const vk::DeviceSize size) {
+        const auto i = static_cast<size_t>(category);
+        m_category_counts[i].fetch_sub(1, std::memory_order_relaxed);
+        m_category_bytes[i].fetch_sub(size, std::memory_order_relaxed);
+    }
+} // namespace vke
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <vk_mem_alloc.h>
+
+#include <array>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace vke {
+    enum class AllocationCategory : uint32_t {
+        Mesh,
+        Staging,
+        Image,
+        Other,
+    };
+
+    static constexpr size_t ALLOCATION_CATEGORY_COUNT = 4;
+
+    struct CategoryUsage {
+        uint32_t       allocation_count = 0;
+        vk::DeviceSize bytes            = 0;
+    };
+
+    struct HeapBudget {
+        vk::MemoryHeapFlags flags;
+        // usage and budget come from VK_EXT_memory_budget when it is available, otherwise they are estimated by vma
+        vk::DeviceSize usage;
+        vk::DeviceSize budget;
+        vk::DeviceSize block_bytes;
+        vk::DeviceSize allocation_bytes;
+        uint32_t       block_count;
+        uint32_t       allocation_count;
+
+        [[nodiscard]] float usage_fraction() const { return budget == 0 ? 0.0f : static_cast<float>(usage) / static_cast<float>(budget); }
+    };
+
+    struct MemoryStatistics {
+        std::vector<HeapBudget>                              heaps;
+        std::array<CategoryUsage, ALLOCATION_CATEGORY_COUNT> categories;
+
+        uint32_t       block_count;
+        uint32_t       allocation_count;
+        uint32_t       unused_range_count;
+        vk::DeviceSize block_bytes;
+        vk::DeviceSize allocation_bytes;
+        vk::DeviceSize allocation_size_max;
+        vk::DeviceSize unused_range_size_max;
+    };
+
+    struct BudgetThresholdEvent {
+        uint32_t   heap_index;
+        float      threshold;
+        bool       rising; // false when usage dropped back below the threshold
+        HeapBudget heap;
+    };
+
+    using BudgetThresholdCallback = std::function<void(const BudgetThresholdEvent &event)>;
+
+    /**
+     * @brief Tracks per heap usage against the budget reported by the driver and fires callbacks when usage crosses configured thresholds.
+     *
+     * Allocation counts per category are tracked by RenderContext::create_buffer and RenderContext::destroy_buffer. Anything allocating outside of those should report through
+     * track_allocation and track_free so the breakdown stays accurate.
+     */
+    class MemoryBudget {
+      public:
+        explicit MemoryBudget(VmaAllocator allocator);
+
+        /**
+         * @brief Queries the heap budgets and fires any threshold callbacks whose state changed since the last poll.
+         *
+         * This is cheap (it doesn't walk allocations) and is called once per frame by RenderContext::render_frame. Callbacks are invoked on the polling thread.
+         */
+        void poll();
+
+        [[nodiscard]] std::vector<HeapBudget> heap_budgets() const;
+
+        // this walks every allocation vma knows about, so don't call it every frame
+        [[nodiscard]] MemoryStatistics calculate_statistics() const;
+
+        [[nodiscard]] CategoryUsage category_usage(AllocationCategory category) const;
+
+        /**
+         * @param fraction the fraction of a heap's budget (0-1) which triggers the callback
+         * @param callback invoked once when usage rises past the threshold and once when it drops back below it
+         * @param heap_filter only heaps with all of these flags are checked. pass empty flags to check every heap.
+         * @return an id which can be passed to remove_threshold
+         */
+        uint32_t add_threshold(float fraction, BudgetThresholdCallback callback, vk::MemoryHeapFlags heap_filter = vk::MemoryHeapFlagBits::eDeviceLocal);
+        void     remove_threshold(uint32_t id);
+
+        void track_allocation(AllocationCategory category, vk::DeviceSize size);
+        void track_free(AllocationCategory category, vk::DeviceSize size);
+
+      private:
+        // usage has to drop this far below a threshold before it is considered uncrossed, so we don't spam callbacks when hovering right at it
+        static constexpr float THRESHOLD_HYSTERESIS = 0.01f;
+
+        struct Threshold {
+            uint32_t                id;
+            float                   fraction;
+            vk::MemoryHeapFlags     heap_filter;
+            BudgetThresholdCallback callback;
+            std::vector<bool>       exceeded;
+        };
+
+        VmaAllocator                     m_allocator;
+        std::vector<vk::MemoryHeapFlags> m_heap_flags;
+        std::vector<HeapBudget>          m_polled_heaps; // reused by poll, so polling every frame doesn't allocate
+
+        std::array<std::atomic<uint32_t>, ALLOCATION_CATEGORY_COUNT>       m_category_counts{};
+        std::array<std::atomic<vk::DeviceSize>, ALLOCATION_CATEGORY_COUNT> m_category_bytes{};
+
+        std::mutex             m_threshold_mutex;
+        std::vector<Threshold> m_thresholds;
+        uint32_t               m_next_threshold_id = 0;
+
+        void read_heap_budgets(std::vector<HeapBudget> &heaps) const;
+    };
+} // namespace vke
@@ -1,17 +1,130 @@
 #include "mesh.hpp"
 
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include "vke/defragmenter.hpp"
+
 namespace vke {
-    Mesh::Mesh(const std::shared_ptr<RenderContext> &rc, const size_t vertex_data_size, const void *vertex_data, const size_t index_data_size, const void *index_data,
-               const MeshType type, const ExtraMeshSettings &extra_mesh_settings)
+    static size_t index_size(const vk::IndexType type) {
+        switch (type) {
+        case vk::IndexType::eUint8EXT:
+            return 1;
+        case vk::IndexType::eUint16:
+            return 2;
+        case vk::IndexType::eUint32:
+        default:
+            return 4;
+        }
+    }
+
+    Mesh::Mesh(const std::shared_ptr<RenderContext> &rc, size_t vertex_data_size, const void *vertex_data, size_t index_data_size, const void *index_data, const MeshType type,
+               const ExtraMeshSettings &extra_mesh_settings)
         : m_rc(rc), m_index_type(extra_mesh_settings.index_type) {
+        std::optional<OptimizedMesh> optimized;
+        if (extra_mesh_settings.optimization.has_value() && index_data && index_data_size) {
+            optimized = optimize_mesh(std::span(static_cast<const std::byte *>(vertex_data), vertex_data_size), extra_mesh_settings.vertex_stride,
+                                      std::span(static_cast<const std::byte *>(index_data), index_data_size), m_index_type, extra_mesh_settings.optimization.value());
+
+            vertex_data          = optimized->vertices.data();
+            vertex_data_size     = optimized->vertices.size();
+            index_data           = optimized->indices.data();
+            index_data_size      = optimized->indices.size();
+            m_index_type         = optimized->index_type;
+            m_optimization_stats = optimized->stats;
+
+            const auto &stats = optimized->stats;
+            spdlog::debug("Optimized mesh: acmr {:.3f} -> {:.3f}, fetch ratio {:.3f} -> {:.3f}, {} -> {} vertices, {} -> {} indices", stats.acmr_before, stats.acmr_after,
+                          stats.fetch_ratio_before, stats.fetch_ratio_after, stats.vertex_count_before, stats.vertex_count_after, vk::to_string(stats.index_type_before),
+                          vk::to_string(stats.index_type_after));
+        }
+
+        // from the full detail level, so before the lods are appended
+        std::optional<MeshletData> meshlets;
+        if (extra_mesh_settings.meshlets.has_value() && index_data && index_data_size) {
+            meshlets = build_meshlets(std::span(static_cast<const std::byte *>(vertex_data), vertex_data_size), extra_mesh_settings.vertex_stride,
+                                      std::span(static_cast<const std::byte *>(index_data), index_data_size), m_index_type, extra_mesh_settings.meshlets.value());
+
+            spdlog::debug("Built {} meshlets, {:.1f} triangles per meshlet", meshlets->meshlets.size(),
+                          static_cast<float>(meshlets->triangle_count) / static_cast<float>(std::max<size_t>(meshlets->meshlets.size(), 1)));
+        }
+
+        std::optional<LodChain> lod_chain;
+        if (extra_mesh_settings.lod.has_value() && index_data && index_data_size) {
+            lod_chain = generate_lods(std::span(static_cast<const std::byte *>(vertex_data), vertex_data_size), extra_mesh_settings.vertex_stride,
+                                      std::span(static_cast<const std::byte *>(index_data), index_data_size), m_index_type, extra_mesh_settings.lod.value());
+
+            index_data      = lod_chain->indices.data();
+            index_data_size = lod_chain->indices.size();
+            m_lods          = std::move(lod_chain->levels);
+
+            spdlog::debug("Generated {} lods, {} -> {} triangles", m_lods.size(), m_lods.front().index_count / 3, m_lods.back().index_count / 3);
+        }
+
+        if (extra_mesh_settings.vertex_stride != 0) {
+            m_vertex_count = static_cast<uint32_t>(vertex_data_size / extra_mesh_settings.vertex_stride);
+        }
 
         const MemoryUsage vertex_mu = type == MeshType::Static ? MemoryUsage::DeviceOnly : MemoryUsage::Auto;
         const MemoryUsage index_mu  = extra_mesh_settings.index_separate_type.value_or(type) == MeshType::Static ? MemoryUsage::DeviceOnly : MemoryUsage::Auto;
 
-        m_vertex_buffer = m_rc->create_buffer(vertex_data_size, vertex_data, vertex_mu, extra_mesh_settings.vertex_usage_flags);
+        // mesh buffers can be moved around by the defragmenter, which copies on the transfer queue
+        const BufferOptions options{
+            .queue_families = m_rc->graphics_transfer_queue_families(),
+            .category       = AllocationCategory::Mesh,
+            .residency      = extra_mesh_settings.residency,
+        };
+
+        m_vertex_buffer = m_rc->create_buffer(vertex_data_size, vertex_data, vertex_mu, vertex_buffer_usage(extra_mesh_settings), options);
+        m_rc->defragmenter().track(m_vertex_buffer);
 
         if (index_data && index_data_size) {
-            m_index_buffer = m_rc->create_buffer(index_data_size, index_data, index_mu, extra_mesh_settings.index_usage_flags);
+            m_index_buffer = m_rc->create_buffer(index_data_size, index_data, index_mu, index_buffer_usage(extra_mesh_settings), options);
+            m_rc->defragmenter().track(m_index_buffer.value());
+            m_index_count = m_lods.empty() ? static_cast<uint32_t>(index_data_size / index_size(m_index_type)) : m_lods.front().index_count;
+        }
+
+        if (meshlets.has_value() && !meshlets->meshlets.empty()) {
+            const MeshletSettings &settings = extra_mesh_settings.meshlets.value();
+
+            m_meshlet_layout.vertices_offset  = byte_size(meshlets->meshlets);
+            m_meshlet_layout.triangles_offset = m_meshlet_layout.vertices_offset + byte_size(meshlets->vertices);
+            m_meshlet_layout.meshlet_count    = static_cast<uint32_t>(meshlets->meshlets.size());
+            m_meshlet_layout.triangle_count   = meshlets->triangle_count;
+            m_meshlet_layout.vertex_stride    = extra_mesh_settings.vertex_stride;
+            m_meshlet_layout.position_offset  = settings.position_offset;
+            m_meshlet_layout.uv_offset        = settings.uv_offset.value_or(MeshletBuffer::NO_UV);
+
+            std::vector<std::byte> data(m_meshlet_layout.triangles_offset + byte_size(meshlets->triangles));
+            std::memcpy(data.data(), meshlets->meshlets.data(), byte_size(meshlets->meshlets));
+            std::memcpy(data.data() + m_meshlet_layout.vertices_offset, meshlets->vertices.data(), byte_size(meshlets->vertices));
+            std::memcpy(data.data() + m_meshlet_layout.triangles_offset, meshlets->triangles.data(), byte_size(meshlets->triangles));
+
+            const vk::BufferUsageFlags usage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eShaderDeviceAddress |
+                vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst;
+            m_meshlet_buffer = m_rc->create_buffer(data, MemoryUsage::DeviceOnly, usage, options);
+            m_rc->defragmenter().track(m_meshlet_buffer.value());
+        }
+    }
+
+    Mesh::Mesh(const std::shared_ptr<RenderContext> &rc, const BufferInfo &vertex_buffer, const std::optional<BufferInfo> &index_buffer,
+               const ExtraMeshSettings &extra_mesh_settings, const bool relocatable)
+        : m_rc(rc), m_vertex_buffer(vertex_buffer), m_index_buffer(index_buffer), m_index_type(extra_mesh_settings.index_type) {
+        if (extra_mesh_settings.vertex_stride != 0) {
+            m_vertex_count = static_cast<uint32_t>(m_vertex_buffer.size / extra_mesh_settings.vertex_stride);
+        }
+
+        if (relocatable) {
+            m_rc->defragmenter().track(m_vertex_buffer);
+        }
+
+        if (m_index_buffer.has_value()) {
+            m_index_count = static_cast<uint32_t>(m_index_buffer->size / index_size(m_index_type));
+            if (relocatable) {
+                m_rc->defragmenter().track(m_index_buffer.value());
+            }
         }
     }
 
@@ -21,6 +134,10 @@ namespace vke {
         if (m_index_buffer.has_value()) {
             m_rc->destroy_buffer(m_index_buffer.value());
         }
+
+        if (m_meshlet_buffer.has_value()) {
+            m_rc->destroy_buffer(m_meshlet_buffer.value());
+        }
     }
 
     std::unique_ptr<Mesh> Mesh::create(const std::shared_ptr<RenderContext> &rc, const size_t vertex_data_size, const void *vertex_data, const size_t index_data_size,
@@ -43,5 +160,34 @@ namespace vke {
         return create_shared(rc, vertex_data_size, vertex_data, 0, nullptr, type, extra_mesh_settings);
     }
 
+    std::shared_ptr<Mesh> Mesh::from_buffers(const std::shared_ptr<RenderContext> &rc, const BufferInfo &vertex_buffer, const std::optional<BufferInfo> &index_buffer,
+                                             const ExtraMeshSettings &extra_mesh_settings, const bool relocatable) {
+        return std::shared_ptr<Mesh>(new Mesh(rc, vertex_buffer, index_buffer, extra_mesh_settings, relocatable));
+    }
+
+    std::optional<MeshletBuffer> Mesh::meshlets() const {
+        if (!m_meshlet_buffer.has_value())
+            return std::nullopt;
+
+        MeshletBuffer meshlets = m_meshlet_layout;
+        meshlets.buffer        = m_meshlet_buffer->buffer;
+        meshlets.address       = m_meshlet_buffer->address;
+        return meshlets;
+    }
+
+    // transfer src/dst lets the defragmenter relocate the buffers
+    vk::BufferUsageFlags Mesh::vertex_buffer_usage(const ExtraMeshSettings &extra_mesh_settings) {
+        vk::BufferUsageFlags usage = extra_mesh_settings.vertex_usage_flags | vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst;
+        if (extra_mesh_settings.vertex_pulling || extra_mesh_settings.meshlets.has_value()) {
+            usage |= vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eShaderDeviceAddress;
+        }
+
+        return usage;
+    }
+
+    vk::BufferUsageFlags Mesh::index_buffer_usage(const ExtraMeshSettings &extra_mesh_settings) {
+        return extra_mesh_settings.index_usage_flags | vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst;
+    }
+
 
 } // namespace vke
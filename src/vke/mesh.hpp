@@ -3,6 +3,9 @@
 #include <optional>
 #include <ranges>
 
+#include "vke/mesh_lod.hpp"
+#include "vke/mesh_optimizer.hpp"
+#include "vke/meshlet.hpp"
 #include "vke/render_context.hpp"
 
 #include "vke/util.hpp"
@@ -19,12 +22,30 @@ namespace vke {
         vk::BufferUsageFlags    vertex_usage_flags = vk::BufferUsageFlagBits::eVertexBuffer;
         vk::BufferUsageFlags    index_usage_flags  = vk::BufferUsageFlagBits::eIndexBuffer;
         std::optional<MeshType> index_separate_type;
-        vk::IndexType           index_type = vk::IndexType::eUint32;
+        vk::IndexType           index_type    = vk::IndexType::eUint32;
+        ResidencyClass          residency     = ResidencyClass::Streaming;
+        uint32_t                vertex_stride = 0; // only needed for vertex_count() (and so non-indexed instanced draws)
+
+        // makes the vertex buffer readable from shaders through its device address (see ActiveRenderer::bind_pulled_mesh)
+        bool vertex_pulling = false;
+
+        // reorders (and dedups) the vertices and indices before upload, see optimize_mesh. needs vertex_stride and index data, which has to be a triangle list.
+        // index_type may end up narrower than asked for, check Mesh::index_type.
+        std::optional<MeshOptimizationSettings> optimization;
+
+        // generates simplified index buffers after the full detail one, in the same index buffer. needs what optimization needs, see generate_lods.
+        std::optional<LodSettings> lod;
+
+        // splits the full detail level into meshlets for ActiveRenderer::draw_meshlets and MeshletExpander, see build_meshlets. needs what optimization needs, and
+        // makes the vertex buffer readable through its device address like vertex_pulling.
+        std::optional<MeshletSettings> meshlets;
     };
 
     class Mesh final {
         Mesh(const std::shared_ptr<RenderContext> &rc, size_t vertex_data_size, const void *vertex_data, size_t index_data_size, const void *index_data, MeshType type,
              const ExtraMeshSettings &extra_mesh_settings = {});
+        Mesh(const std::shared_ptr<RenderContext> &rc, const BufferInfo &vertex_buffer, const std::optional<BufferInfo> &index_buffer, const ExtraMeshSettings &extra_mesh_settings,
+             bool relocatable);
 
       public:
         ~Mesh();
@@ -39,6 +60,18 @@ namespace vke {
         static std::shared_ptr<Mesh> create_shared(const std::shared_ptr<RenderContext> &rc, size_t vertex_data_size, const void *vertex_data, MeshType type,
                                                    const ExtraMeshSettings &extra_mesh_settings = {});
 
+        /**
+         * @brief Wraps buffers which were already created and filled (ie. by AssetStreamer). The mesh takes ownership of them.
+         *
+         * The buffers should be created with vertex_buffer_usage and index_buffer_usage. Only pass relocatable = true if the defragmenter is allowed to move them, which needs them
+         * to be shared with the transfer queue (see RenderContext::graphics_transfer_queue_families).
+         */
+        static std::shared_ptr<Mesh> from_buffers(const std::shared_ptr<RenderContext> &rc, const BufferInfo &vertex_buffer, const std::optional<BufferInfo> &index_buffer,
+                                                  const ExtraMeshSettings &extra_mesh_settings, bool relocatable);
+
+        [[nodiscard]] static vk::BufferUsageFlags vertex_buffer_usage(const ExtraMeshSettings &extra_mesh_settings);
+        [[nodiscard]] static vk::BufferUsageFlags index_buffer_usage(const ExtraMeshSettings &extra_mesh_settings);
+
         template <std::ranges::contiguous_range Range>
         inline static std::unique_ptr<Mesh> create(const std::shared_ptr<RenderContext> &rc, Range &&data, const MeshType type, const ExtraMeshSettings &extra_mesh_settings = {}) {
             return create(rc, byte_size(data), std::data(data), 0, nullptr, type, extra_mesh_settings);
@@ -68,11 +101,37 @@ namespace vke {
 
         [[nodiscard]] vk::IndexType index_type() const { return m_index_type; }
 
+        // of the full detail level if the mesh has lods
+        [[nodiscard]] uint32_t index_count() const { return m_index_count; }
+
+        // empty unless ExtraMeshSettings::lod was set, otherwise the full detail level comes first
+        [[nodiscard]] std::span<const MeshLod> lods() const { return m_lods; }
+
+        // 0 unless ExtraMeshSettings::vertex_stride was set
+        [[nodiscard]] uint32_t vertex_count() const { return m_vertex_count; }
+
+        // 0 unless the mesh was created with vertex pulling enabled
+        [[nodiscard]] vk::DeviceAddress vertex_address() const { return m_vertex_buffer.address; }
+
+        // only set if the mesh was created with ExtraMeshSettings::meshlets. the addresses change if the defragmenter moves the buffer, so don't keep this around.
+        [[nodiscard]] std::optional<MeshletBuffer> meshlets() const;
+
+        // only set if the mesh was optimized when it was created
+        [[nodiscard]] const std::optional<MeshOptimizationStats> &optimization_stats() const { return m_optimization_stats; }
+
       private:
         std::shared_ptr<RenderContext> m_rc;
         BufferInfo                     m_vertex_buffer;
         std::optional<BufferInfo>      m_index_buffer;
         vk::IndexType                  m_index_type;
+        uint32_t                       m_index_count  = 0;
+        uint32_t                       m_vertex_count = 0;
+
+        std::optional<MeshOptimizationStats> m_optimization_stats;
+        std::vector<MeshLod>                 m_lods;
+
+        std::optional<BufferInfo> m_meshlet_buffer;
+        MeshletBuffer             m_meshlet_layout; // everything but the buffer itself
     };
 
 } // namespace vke
@@ -0,0 +1,108 @@
+#include "mesh_lod.hpp"
+
+#include <meshoptimizer.h>
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "vke/mesh.hpp"
+#include "vke/mesh_optimizer.hpp"
+
+namespace vke {
+    LodChain generate_lods(const std::span<const std::byte> vertex_data, const uint32_t vertex_stride, const std::span<const std::byte> index_data,
+                           const vk::IndexType index_type, const LodSettings &settings) {
+        if (vertex_stride == 0) {
+            throw std::runtime_error("Lod generation needs the vertex stride.");
+        }
+
+        if (settings.position_offset + 3 * sizeof(float) > vertex_stride) {
+            throw std::runtime_error("Lod generation position offset is outside the vertex.");
+        }
+
+        const std::vector<uint32_t> indices = read_indices(index_data, index_type);
+        if (indices.size() % 3 != 0) {
+            throw std::runtime_error("Lod generation only works on triangle lists.");
+        }
+
+        const size_t vertex_count = vertex_data.size() / vertex_stride;
+        const auto   positions    = reinterpret_cast<const float *>(vertex_data.data() + settings.position_offset);
+
+        // meshopt's errors are relative to the mesh's size
+        const float scale = meshopt_simplifyScale(positions, vertex_count, vertex_stride);
+
+        std::vector<uint32_t> chain = indices;
+        std::vector<MeshLod>  levels{{0, static_cast<uint32_t>(indices.size()), 0.0f}};
+
+        // every level is simplified from the full detail mesh, so errors don't add up along the chain
+        const uint32_t        max_levels = std::min(settings.max_levels, MAX_MESH_LODS);
+        const unsigned int    options    = settings.lock_border ? meshopt_SimplifyLockBorder : 0;
+        std::vector<uint32_t> level(indices.size());
+        size_t                target = indices.size();
+        while (levels.size() < max_levels) {
+            target = static_cast<size_t>(static_cast<float>(target) * settings.reduction) / 3 * 3;
+            if (target < 3)
+                break;
+
+            float        error = 0.0f;
+            const size_t count =
+                meshopt_simplify(level.data(), indices.data(), indices.size(), positions, vertex_count, vertex_stride, target, settings.max_error, options, &error);
+
+            // the error budget ran out before it got much simpler than the last level
+            if (count == 0 || static_cast<float>(count) > static_cast<float>(levels.back().index_count) * 0.95f)
+                break;
+
+            meshopt_optimizeVertexCache(level.data(), level.data(), count, vertex_count);
+
+            levels.push_back(MeshLod{static_cast<uint32_t>(chain.size()), static_cast<uint32_t>(count), std::max(error * scale, levels.back().error)});
+            chain.insert(chain.end(), level.begin(), level.begin() + static_cast<std::ptrdiff_t>(count));
+            target = count;
+        }
+
+        return LodChain{write_indices(chain, index_type), std::move(levels)};
+    }
+
+    void LodSelector::begin_frame(const glm::mat4 &projection, const float viewport_height) {
+        m_pixels_per_unit = viewport_height * 0.5f * std::abs(projection[1][1]);
+        m_last_stats      = m_stats;
+        m_stats           = {};
+    }
+
+    uint32_t LodSelector::select(const uint32_t instance, const Mesh &mesh, const float distance, const float scale) {
+        const std::span<const MeshLod> lods = mesh.lods();
+        if (lods.size() <= 1) {
+            m_stats.triangles_drawn += mesh.index_count() / 3;
+            return 0;
+        }
+
+        // errors only grow along the chain, so this is the last level under the threshold
+        const float pixels_per_unit = m_pixels_per_unit * scale / std::max(distance, 1e-4f);
+        const auto  coarsest_under  = [&](const float threshold) {
+            uint32_t lod = 0;
+            while (lod + 1 < lods.size() && lods[lod + 1].error * pixels_per_unit <= threshold) {
+                lod++;
+            }
+
+            return lod;
+        };
+
+        uint32_t lod = coarsest_under(m_settings.max_screen_error);
+
+        if (instance >= m_previous.size())
+            m_previous.resize(instance + 1, NO_LOD);
+
+        if (const uint8_t previous = m_previous[instance]; previous != NO_LOD && previous < lods.size()) {
+            if (lod > previous) {
+                lod = std::max<uint32_t>(previous, coarsest_under(m_settings.max_screen_error * (1.0f - m_settings.hysteresis)));
+            } else if (lod < previous && lods[previous].error * pixels_per_unit <= m_settings.max_screen_error * (1.0f + m_settings.hysteresis)) {
+                lod = previous;
+            }
+        }
+
+        m_previous[instance] = static_cast<uint8_t>(lod);
+
+        m_stats.triangles_drawn += lods[lod].index_count / 3;
+        m_stats.triangles_saved += (lods[0].index_count - lods[lod].index_count) / 3;
+        return lod;
+    }
+} // namespace vke
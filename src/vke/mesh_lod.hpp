@@ -0,0 +1,81 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace vke {
+    class Mesh;
+
+    static constexpr uint32_t MAX_MESH_LODS = 8;
+
+    struct LodSettings {
+        uint32_t position_offset = 0;     // offset of a vec3 (3 floats) position in each vertex
+        uint32_t max_levels      = 6;     // including the full detail level, at most MAX_MESH_LODS
+        float    reduction       = 0.5f;  // each level aims for this fraction of the previous level's triangles
+        float    max_error       = 0.05f; // how far (relative to the mesh's size) a level may deviate from the original, the chain ends before that
+        bool     lock_border     = false; // keeps open edges in place, for meshes which have to line up with their neighbours
+    };
+
+    struct MeshLod {
+        uint32_t first_index;
+        uint32_t index_count;
+        float    error; // in object space, 0 for the full detail level
+    };
+
+    struct LodChain {
+        std::vector<std::byte> indices; // every level back to back (in the source's index type), the full detail one first
+        std::vector<MeshLod>   levels;
+    };
+
+    // simplifies the mesh by edge collapse (meshoptimizer's quadric simplifier) into progressively coarser index buffers which all use the same vertices
+    [[nodiscard]] LodChain generate_lods(std::span<const std::byte> vertex_data, uint32_t vertex_stride, std::span<const std::byte> index_data, vk::IndexType index_type,
+                                         const LodSettings &settings = {});
+
+    struct LodSelectorSettings {
+        float max_screen_error = 1.0f;  // in pixels, the coarsest level under it is picked
+        float hysteresis       = 0.25f; // a level has to be this much (as a fraction of max_screen_error) past the threshold before switching
+    };
+
+    struct LodStats {
+        uint64_t triangles_drawn = 0;
+        uint64_t triangles_saved = 0; // compared to drawing everything at full detail
+    };
+
+    /**
+     * @brief Picks a level of detail per instance from its projected screen space error.
+     *
+     * The level picked for each instance last time is kept, and only changed when the new one is clearly better, so instances sitting right at a threshold don't flicker
+     * between levels every frame.
+     */
+    class LodSelector {
+      public:
+        explicit LodSelector(const LodSelectorSettings &settings = {}) : m_settings(settings) {}
+
+        // projection is the camera's (vulkan style) projection matrix. also starts counting the frame's stats.
+        void begin_frame(const glm::mat4 &projection, float viewport_height);
+
+        // distance is from the camera to the instance's bounds, scale how much the instance is scaled up from its mesh's object space
+        uint32_t select(uint32_t instance, const Mesh &mesh, float distance, float scale = 1.0f);
+
+        // for the frame so far
+        [[nodiscard]] const LodStats &stats() const { return m_stats; }
+
+        // for the last whole frame
+        [[nodiscard]] const LodStats &last_frame_stats() const { return m_last_stats; }
+
+      private:
+        static constexpr uint8_t NO_LOD = 0xff;
+
+        LodSelectorSettings  m_settings;
+        float                m_pixels_per_unit = 1.0f; // at distance 1
+        std::vector<uint8_t> m_previous;               // by instance, NO_LOD if there was none
+        LodStats             m_stats;
+        LodStats             m_last_stats;
+    };
+} // namespace vke
@@ -0,0 +1,124 @@
+#include "mesh_optimizer.hpp"
+
+#include <meshoptimizer.h>
+
+#include <cstring>
+#include <stdexcept>
+
+namespace vke {
+    static constexpr uint32_t ANALYSIS_CACHE_SIZE = 16;
+
+    template <typename T>
+    static std::vector<uint32_t> widen_indices(const std::span<const std::byte> data) {
+        std::vector<uint32_t> indices(data.size() / sizeof(T));
+        for (size_t i = 0; i < indices.size(); i++) {
+            T index;
+            std::memcpy(&index, data.data() + i * sizeof(T), sizeof(T));
+            indices[i] = index;
+        }
+
+        return indices;
+    }
+
+    template <typename T>
+    static std::vector<std::byte> narrow_indices(const std::span<const uint32_t> indices) {
+        std::vector<std::byte> data(indices.size() * sizeof(T));
+        for (size_t i = 0; i < indices.size(); i++) {
+            const auto index = static_cast<T>(indices[i]);
+            std::memcpy(data.data() + i * sizeof(T), &index, sizeof(T));
+        }
+
+        return data;
+    }
+
+    std::vector<uint32_t> read_indices(const std::span<const std::byte> data, const vk::IndexType type) {
+        switch (type) {
+        case vk::IndexType::eUint8EXT:
+            return widen_indices<uint8_t>(data);
+        case vk::IndexType::eUint16:
+            return widen_indices<uint16_t>(data);
+        case vk::IndexType::eUint32:
+            return widen_indices<uint32_t>(data);
+        default:
+            throw std::runtime_error("Unsupported index type.");
+        }
+    }
+
+    std::vector<std::byte> write_indices(const std::span<const uint32_t> indices, const vk::IndexType type) {
+        switch (type) {
+        case vk::IndexType::eUint8EXT:
+            return narrow_indices<uint8_t>(indices);
+        case vk::IndexType::eUint16:
+            return narrow_indices<uint16_t>(indices);
+        case vk::IndexType::eUint32:
+        default:
+            return narrow_indices<uint32_t>(indices);
+        }
+    }
+
+    OptimizedMesh optimize_mesh(const std::span<const std::byte> vertex_data, const uint32_t vertex_stride, const std::span<const std::byte> index_data,
+                                const vk::IndexType index_type, const MeshOptimizationSettings &settings) {
+        if (vertex_stride == 0) {
+            throw std::runtime_error("Mesh optimization needs the vertex stride.");
+        }
+
+        std::vector<uint32_t> indices = read_indices(index_data, index_type);
+        if (indices.size() % 3 != 0) {
+            throw std::runtime_error("Mesh optimization only works on triangle lists.");
+        }
+
+        size_t vertex_count = vertex_data.size() / vertex_stride;
+
+        MeshOptimizationStats stats{};
+        stats.acmr_before         = meshopt_analyzeVertexCache(indices.data(), indices.size(), vertex_count, ANALYSIS_CACHE_SIZE, 0, 0).acmr;
+        stats.fetch_ratio_before  = meshopt_analyzeVertexFetch(indices.data(), indices.size(), vertex_count, vertex_stride).overfetch;
+        stats.vertex_count_before = static_cast<uint32_t>(vertex_count);
+        stats.index_type_before   = index_type;
+
+        std::vector<std::byte> vertices(vertex_data.begin(), vertex_data.end());
+        if (settings.reorder_for_vertex_fetch) {
+            std::vector<uint32_t> remap(vertex_count);
+            vertex_count = meshopt_generateVertexRemap(remap.data(), indices.data(), indices.size(), vertex_data.data(), vertex_count, vertex_stride);
+
+            std::vector<std::byte> unique(vertex_count * vertex_stride);
+            meshopt_remapVertexBuffer(unique.data(), vertex_data.data(), remap.size(), vertex_stride, remap.data());
+            meshopt_remapIndexBuffer(indices.data(), indices.data(), indices.size(), remap.data());
+            vertices = std::move(unique);
+        }
+
+        if (settings.reorder_for_vertex_cache) {
+            meshopt_optimizeVertexCache(indices.data(), indices.data(), indices.size(), vertex_count);
+        }
+
+        // keeps the vertex cache order within clusters, so this has to come after it
+        if (settings.reorder_for_overdraw && settings.position_offset.has_value()) {
+            if (*settings.position_offset + 3 * sizeof(float) > vertex_stride) {
+                throw std::runtime_error("Mesh optimization position offset is outside the vertex.");
+            }
+
+            const auto positions = reinterpret_cast<const float *>(vertices.data() + *settings.position_offset);
+            meshopt_optimizeOverdraw(indices.data(), indices.data(), indices.size(), positions, vertex_count, vertex_stride, settings.overdraw_threshold);
+        }
+
+        // last, since it depends on the final triangle order
+        if (settings.reorder_for_vertex_fetch) {
+            std::vector<std::byte> fetch_ordered(vertices.size());
+            vertex_count = meshopt_optimizeVertexFetch(fetch_ordered.data(), indices.data(), indices.size(), vertices.data(), vertex_count, vertex_stride);
+            fetch_ordered.resize(vertex_count * vertex_stride);
+            vertices = std::move(fetch_ordered);
+        }
+
+        // 0xffff is left out so it can never be mistaken for a primitive restart
+        vk::IndexType out_index_type = index_type;
+        if (settings.narrow_indices && index_type == vk::IndexType::eUint32 && vertex_count < 0xffff) {
+            out_index_type = vk::IndexType::eUint16;
+        }
+
+        stats.acmr_after         = meshopt_analyzeVertexCache(indices.data(), indices.size(), vertex_count, ANALYSIS_CACHE_SIZE, 0, 0).acmr;
+        stats.fetch_ratio_after  = meshopt_analyzeVertexFetch(indices.data(), indices.size(), vertex_count, vertex_stride).overfetch;
+        stats.vertex_count_after = static_cast<uint32_t>(vertex_count);
+        stats.index_type_after   = out_index_type;
+
+        return OptimizedMesh{std::move(vertices), write_indices(indices, out_index_type), out_index_type, stats};
+    }
+} // namespace vke
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace vke {
+    // every step is done with meshoptimizer. only works on indexed triangle lists.
+    struct MeshOptimizationSettings {
+        bool reorder_for_vertex_cache = true;
+
+        // needs position_offset. the threshold is how much worse the vertex cache may get (as a factor of acmr) to cut down on overdraw.
+        bool                    reorder_for_overdraw = true;
+        float                   overdraw_threshold   = 1.05f;
+        std::optional<uint32_t> position_offset; // offset of a vec3 (3 floats) position in each vertex
+
+        // merges identical vertices, drops unreferenced ones and puts the rest in the order they're first used in
+        bool reorder_for_vertex_fetch = true;
+
+        // uses eUint16 indices if every vertex can be addressed with them
+        bool narrow_indices = true;
+    };
+
+    struct MeshOptimizationStats {
+        // average transformed vertices per triangle (with a 16 entry fifo cache), 0.5 is perfect and 3 is as bad as it gets
+        float acmr_before = 0.0f;
+        float acmr_after  = 0.0f;
+
+        // bytes fetched from the vertex buffer over its size, 1 is perfect
+        float fetch_ratio_before = 0.0f;
+        float fetch_ratio_after  = 0.0f;
+
+        uint32_t      vertex_count_before = 0;
+        uint32_t      vertex_count_after  = 0;
+        vk::IndexType index_type_before   = vk::IndexType::eUint32;
+        vk::IndexType index_type_after    = vk::IndexType::eUint32;
+    };
+
+    struct OptimizedMesh {
+        std::vector<std::byte> vertices;
+        std::vector<std::byte> indices;
+        vk::IndexType          index_type;
+        MeshOptimizationStats  stats;
+    };
+
+    // widens index_type indices to 32 bits, and back (truncating, so check they fit first)
+    [[nodiscard]] std::vector<uint32_t>  read_indices(std::span<const std::byte> data, vk::IndexType type);
+    [[nodiscard]] std::vector<std::byte> write_indices(std::span<const uint32_t> indices, vk::IndexType type);
+
+    // index_data is index_type indices, vertex_data is tightly packed vertex_stride byte vertices
+    [[nodiscard]] OptimizedMesh optimize_mesh(std::span<const std::byte> vertex_data, uint32_t vertex_stride, std::span<const std::byte> index_data, vk::IndexType index_type,
+                                              const MeshOptimizationSettings &settings = {});
+} // namespace vke
@@ -0,0 +1,232 @@
+#include "mesh_pack.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+namespace vke {
+    static_assert(std::is_trivially_copyable_v<MeshPackHeader> && std::is_trivially_copyable_v<MeshPackEntry>);
+    static_assert(sizeof(MeshPackHeader) == 56 && sizeof(MeshPackBinding) == 20 && sizeof(MeshPackAttribute) == 12 && sizeof(MeshPackEntry) == 144);
+
+    static constexpr uint64_t align_up(const uint64_t value, const uint64_t alignment) {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+
+    static bool in_bounds(const uint64_t offset, const uint64_t size, const uint64_t file_size) {
+        return offset <= file_size && size <= file_size - offset;
+    }
+
+    template <typename T>
+    static std::span<const T> table(const MappedFile &file, const uint64_t offset, const uint32_t count) {
+        if (offset % alignof(T) != 0 || !in_bounds(offset, static_cast<uint64_t>(count) * sizeof(T), file.size())) {
+            throw std::runtime_error("Mesh pack table is out of bounds.");
+        }
+
+        return {reinterpret_cast<const T *>(file.data() + offset), count};
+    }
+
+    MeshPack::MeshPack(const std::filesystem::path &path) : m_file(path) {
+        if (m_file.size() < sizeof(MeshPackHeader)) {
+            throw std::runtime_error(path.string() + " is too small to be a mesh pack.");
+        }
+
+        const auto &header = *reinterpret_cast<const MeshPackHeader *>(m_file.data());
+        if (header.magic != MAGIC) {
+            throw std::runtime_error(path.string() + " is not a mesh pack.");
+        }
+
+        if (header.version != VERSION) {
+            throw std::runtime_error(path.string() + " has an unsupported mesh pack version (" + std::to_string(header.version) + ").");
+        }
+
+        if (header.file_size != m_file.size()) {
+            throw std::runtime_error(path.string() + " is truncated.");
+        }
+
+        m_entries    = table<MeshPackEntry>(m_file, header.mesh_table_offset, header.mesh_count);
+        m_bindings   = table<MeshPackBinding>(m_file, header.binding_table_offset, header.binding_count);
+        m_attributes = table<MeshPackAttribute>(m_file, header.attribute_table_offset, header.attribute_count);
+
+        for (const auto &binding : m_bindings) {
+            if (!in_bounds(binding.first_attribute, binding.attribute_count, m_attributes.size())) {
+                throw std::runtime_error(path.string() + " has a binding with out of bounds attributes.");
+            }
+        }
+
+        for (const auto &entry : m_entries) {
+            if (!in_bounds(entry.first_binding, entry.binding_count, m_bindings.size()) || !in_bounds(entry.vertex_offset, entry.vertex_size, m_file.size()) ||
+                !in_bounds(entry.index_offset, entry.index_size, m_file.size()) || entry.name[sizeof(entry.name) - 1] != '\0') {
+                throw std::runtime_error(path.string() + " has a corrupt mesh entry.");
+            }
+        }
+    }
+
+    std::string_view MeshPack::name(const uint32_t mesh) const {
+        return m_entries[mesh].name;
+    }
+
+    std::optional<uint32_t> MeshPack::find(const std::string_view name) const {
+        for (uint32_t i = 0; i < m_entries.size(); i++) {
+            if (this->name(i) == name)
+                return i;
+        }
+
+        return std::nullopt;
+    }
+
+    std::vector<VertexBufferBinding> MeshPack::vertex_layout(const uint32_t mesh) const {
+        const auto &entry = m_entries[mesh];
+
+        std::vector<VertexBufferBinding> layout;
+        layout.reserve(entry.binding_count);
+        for (const auto &binding : m_bindings.subspan(entry.first_binding, entry.binding_count)) {
+            auto &out = layout.emplace_back(binding.binding, binding.stride, static_cast<vk::VertexInputRate>(binding.input_rate));
+            for (const auto &attribute : m_attributes.subspan(binding.first_attribute, binding.attribute_count)) {
+                out.attributes.emplace_back(attribute.location, static_cast<vk::Format>(attribute.format), attribute.offset);
+            }
+        }
+
+        return layout;
+    }
+
+    MeshBounds MeshPack::bounds(const uint32_t mesh) const {
+        const auto &entry = m_entries[mesh];
+        return {
+            {entry.bounds_min[0], entry.bounds_min[1], entry.bounds_min[2]},
+            {entry.bounds_max[0], entry.bounds_max[1], entry.bounds_max[2]},
+        };
+    }
+
+    std::span<const std::byte> MeshPack::vertex_data(const uint32_t mesh) const {
+        return m_file.bytes().subspan(m_entries[mesh].vertex_offset, m_entries[mesh].vertex_size);
+    }
+
+    std::span<const std::byte> MeshPack::index_data(const uint32_t mesh) const {
+        return m_file.bytes().subspan(m_entries[mesh].index_offset, m_entries[mesh].index_size);
+    }
+
+    std::unique_ptr<Mesh> MeshPack::load(const std::shared_ptr<RenderContext> &rc, const uint32_t mesh, const MeshType type,
+                                         const ExtraMeshSettings &extra_mesh_settings) const {
+        const auto vertices = vertex_data(mesh);
+        const auto indices  = index_data(mesh);
+
+        // start the os reading the index blob while the vertex blob is being copied
+        m_file.prefetch(m_entries[mesh].index_offset, indices.size());
+        return Mesh::create(rc, vertices.size(), vertices.data(), indices.size(), indices.data(), type, mesh_settings(mesh, extra_mesh_settings));
+    }
+
+    std::shared_ptr<Mesh> MeshPack::load_shared(const std::shared_ptr<RenderContext> &rc, const uint32_t mesh, const MeshType type,
+                                                const ExtraMeshSettings &extra_mesh_settings) const {
+        const auto vertices = vertex_data(mesh);
+        const auto indices  = index_data(mesh);
+
+        m_file.prefetch(m_entries[mesh].index_offset, indices.size());
+        return Mesh::create_shared(rc, vertices.size(), vertices.data(), indices.size(), indices.data(), type, mesh_settings(mesh, extra_mesh_settings));
+    }
+
+    ExtraMeshSettings MeshPack::mesh_settings(const uint32_t mesh, const ExtraMeshSettings &extra_mesh_settings) const {
+        const auto &entry = m_entries[mesh];
+
+        ExtraMeshSettings settings = extra_mesh_settings;
+        settings.index_type        = static_cast<vk::IndexType>(entry.index_type);
+        if (entry.binding_count > 0) {
+            settings.vertex_stride = m_bindings[entry.first_binding].stride;
+        }
+
+        return settings;
+    }
+
+    uint32_t MeshPackWriter::add(const std::string_view name, const std::span<const VertexBufferBinding> layout, const std::span<const std::byte> vertex_data,
+                                 const std::span<const std::byte> index_data, const vk::IndexType index_type, const MeshBounds &bounds) {
+        PendingMesh mesh{};
+        auto       &entry = mesh.entry;
+
+        if (name.size() >= sizeof(entry.name)) {
+            throw std::runtime_error("Mesh names in a mesh pack must be shorter than 64 characters.");
+        }
+        std::memcpy(entry.name, name.data(), name.size());
+
+        entry.first_binding = static_cast<uint32_t>(m_bindings.size());
+        entry.binding_count = static_cast<uint32_t>(layout.size());
+        for (const auto &binding : layout) {
+            m_bindings.push_back(MeshPackBinding{binding.binding, binding.stride, static_cast<uint32_t>(binding.input_rate), static_cast<uint32_t>(m_attributes.size()),
+                                                 static_cast<uint32_t>(binding.attributes.size())});
+            for (const auto &attribute : binding.attributes) {
+                m_attributes.push_back(MeshPackAttribute{attribute.location, static_cast<uint32_t>(attribute.format), attribute.offset});
+            }
+        }
+
+        const uint32_t index_size = index_type == vk::IndexType::eUint16 ? 2 : index_type == vk::IndexType::eUint8EXT ? 1 : 4;
+
+        entry.index_type   = static_cast<uint32_t>(index_type);
+        entry.vertex_count = layout.empty() || layout.front().stride == 0 ? 0 : static_cast<uint32_t>(vertex_data.size() / layout.front().stride);
+        entry.index_count  = static_cast<uint32_t>(index_data.size() / index_size);
+        entry.vertex_size  = vertex_data.size();
+        entry.index_size   = index_data.size();
+        std::memcpy(entry.bounds_min, &bounds.min, sizeof(entry.bounds_min));
+        std::memcpy(entry.bounds_max, &bounds.max, sizeof(entry.bounds_max));
+
+        mesh.vertex_data.assign(vertex_data.begin(), vertex_data.end());
+        mesh.index_data.assign(index_data.begin(), index_data.end());
+
+        m_meshes.push_back(std::move(mesh));
+        return static_cast<uint32_t>(m_meshes.size() - 1);
+    }
+
+    void MeshPackWriter::write(const std::filesystem::path &path) const {
+        MeshPackHeader header{};
+        header.magic           = MeshPack::MAGIC;
+        header.version         = MeshPack::VERSION;
+        header.mesh_count      = static_cast<uint32_t>(m_meshes.size());
+        header.binding_count   = static_cast<uint32_t>(m_bindings.size());
+        header.attribute_count = static_cast<uint32_t>(m_attributes.size());
+
+        uint64_t offset               = align_up(sizeof(MeshPackHeader), MeshPack::ALIGNMENT);
+        header.mesh_table_offset      = offset;
+        offset                        = align_up(offset + m_meshes.size() * sizeof(MeshPackEntry), MeshPack::ALIGNMENT);
+        header.binding_table_offset   = offset;
+        offset                        = align_up(offset + m_bindings.size() * sizeof(MeshPackBinding), MeshPack::ALIGNMENT);
+        header.attribute_table_offset = offset;
+        offset                        = align_up(offset + m_attributes.size() * sizeof(MeshPackAttribute), MeshPack::ALIGNMENT);
+
+        std::vector<MeshPackEntry> entries;
+        entries.reserve(m_meshes.size());
+        for (const auto &mesh : m_meshes) {
+            auto &entry         = entries.emplace_back(mesh.entry);
+            entry.vertex_offset = offset;
+            offset              = align_up(offset + mesh.vertex_data.size(), MeshPack::ALIGNMENT);
+            entry.index_offset  = offset;
+            offset              = align_up(offset + mesh.index_data.size(), MeshPack::ALIGNMENT);
+        }
+        header.file_size = offset;
+
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            throw std::runtime_error("Failed to open " + path.string() + " for writing.");
+        }
+
+        const auto write_at = [&out](const uint64_t at, const void *data, const size_t size) {
+            static constexpr char zeros[MeshPack::ALIGNMENT]{};
+
+            // pad up to the aligned offset
+            for (auto position = static_cast<uint64_t>(out.tellp()); position < at; position += std::min<uint64_t>(at - position, sizeof(zeros))) {
+                out.write(zeros, static_cast<std::streamsize>(std::min<uint64_t>(at - position, sizeof(zeros))));
+            }
+            out.write(static_cast<const char *>(data), static_cast<std::streamsize>(size));
+        };
+
+        write_at(0, &header, sizeof(header));
+        write_at(header.mesh_table_offset, entries.data(), entries.size() * sizeof(MeshPackEntry));
+        write_at(header.binding_table_offset, m_bindings.data(), m_bindings.size() * sizeof(MeshPackBinding));
+        write_at(header.attribute_table_offset, m_attributes.data(), m_attributes.size() * sizeof(MeshPackAttribute));
+        for (size_t i = 0; i < m_meshes.size(); i++) {
+            write_at(entries[i].vertex_offset, m_meshes[i].vertex_data.data(), m_meshes[i].vertex_data.size());
+            write_at(entries[i].index_offset, m_meshes[i].index_data.data(), m_meshes[i].index_data.size());
+        }
+        write_at(header.file_size, nullptr, 0);
+
+        if (!out) {
+            throw std::runtime_error("Failed to write " + path.string());
+        }
+    }
+} // namespace vke
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <glm/glm.hpp>
+
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "vke/mapped_file.hpp"
+#include "vke/mesh.hpp"
+#include "vke/renderer.hpp"
+
+namespace vke {
+    struct MeshBounds {
+        glm::vec3 min;
+        glm::vec3 max;
+    };
+
+    /*
+     * mesh pack layout (everything little endian, every table and blob aligned to MeshPack::ALIGNMENT):
+     *
+     * MeshPackHeader
+     * MeshPackEntry[mesh_count]
+     * MeshPackBinding[binding_count]     (each mesh references a range of these)
+     * MeshPackAttribute[attribute_count] (each binding references a range of these)
+     * vertex and index blobs
+     */
+
+    struct MeshPackHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t mesh_count;
+        uint32_t binding_count;
+        uint32_t attribute_count;
+        uint32_t reserved;
+        uint64_t mesh_table_offset;
+        uint64_t binding_table_offset;
+        uint64_t attribute_table_offset;
+        uint64_t file_size;
+    };
+
+    struct MeshPackBinding {
+        uint32_t binding;
+        uint32_t stride;
+        uint32_t input_rate; // VkVertexInputRate
+        uint32_t first_attribute;
+        uint32_t attribute_count;
+    };
+
+    struct MeshPackAttribute {
+        uint32_t location;
+        uint32_t format; // VkFormat
+        uint32_t offset;
+    };
+
+    struct MeshPackEntry {
+        char     name[64]; // null terminated
+        uint32_t first_binding;
+        uint32_t binding_count;
+        uint32_t index_type; // VkIndexType
+        uint32_t vertex_count;
+        uint32_t index_count;
+        uint32_t reserved;
+        uint64_t vertex_offset;
+        uint64_t vertex_size;
+        uint64_t index_offset;
+        uint64_t index_size; // 0 for meshes without indices
+        float    bounds_min[3];
+        float    bounds_max[3];
+    };
+
+    /**
+     * @brief Read only view of a mesh pack file, which is memory mapped rather than read.
+     *
+     * The tables are used in place and loading a mesh hands a pointer into the mapping straight to the upload, so vertex and index data are copied exactly once (from the page
+     * cache into staging or host visible memory). Opening validates every table and blob range, so a truncated or corrupt file throws instead of reading out of bounds.
+     */
+    class MeshPack {
+      public:
+        static constexpr uint32_t MAGIC     = 0x504d4b56; // "VKMP"
+        static constexpr uint32_t VERSION   = 1;
+        static constexpr uint64_t ALIGNMENT = 256;
+
+        explicit MeshPack(const std::filesystem::path &path);
+
+        [[nodiscard]] uint32_t mesh_count() const { return static_cast<uint32_t>(m_entries.size()); }
+
+        [[nodiscard]] const MeshPackEntry &entry(const uint32_t mesh) const { return m_entries[mesh]; }
+
+        [[nodiscard]] std::string_view name(uint32_t mesh) const;
+
+        [[nodiscard]] std::optional<uint32_t> find(std::string_view name) const;
+
+        // matches what the pipeline drawing this mesh needs in GraphicsPipelineBuilder::vertex_buffer_bindings
+        [[nodiscard]] std::vector<VertexBufferBinding> vertex_layout(uint32_t mesh) const;
+
+        [[nodiscard]] MeshBounds bounds(uint32_t mesh) const;
+
+        [[nodiscard]] std::span<const std::byte> vertex_data(uint32_t mesh) const;
+        [[nodiscard]] std::span<const std::byte> index_data(uint32_t mesh) const;
+
+        // the index type and vertex stride are taken from the pack, everything else in extra_mesh_settings is used as is
+        [[nodiscard]] ExtraMeshSettings mesh_settings(uint32_t mesh, const ExtraMeshSettings &extra_mesh_settings = {}) const;
+
+        [[nodiscard]] std::unique_ptr<Mesh> load(const std::shared_ptr<RenderContext> &rc, uint32_t mesh, MeshType type = MeshType::Static,
+                                                 const ExtraMeshSettings &extra_mesh_settings = {}) const;
+        [[nodiscard]] std::shared_ptr<Mesh> load_shared(const std::shared_ptr<RenderContext> &rc, uint32_t mesh, MeshType type = MeshType::Static,
+                                                        const ExtraMeshSettings &extra_mesh_settings = {}) const;
+
+        [[nodiscard]] const MappedFile &file() const { return m_file; }
+
+      private:
+        MappedFile                         m_file;
+        std::span<const MeshPackEntry>     m_entries;
+        std::span<const MeshPackBinding>   m_bindings;
+        std::span<const MeshPackAttribute> m_attributes;
+    };
+
+    // builds mesh packs offline. everything added is kept in memory until written.
+    class MeshPackWriter {
+      public:
+        uint32_t add(std::string_view name, std::span<const VertexBufferBinding> layout, std::span<const std::byte> vertex_data, std::span<const std::byte> index_data,
+                     vk::IndexType index_type, const MeshBounds &bounds);
+
+        template <std::ranges::contiguous_range Range, std::ranges::contiguous_range Range2>
+        uint32_t add(const std::string_view name, const std::span<const VertexBufferBinding> layout, Range &&vertices, Range2 &&indices, const MeshBounds &bounds) {
+            using Index = std::ranges::range_value_t<Range2>;
+            static_assert(sizeof(Index) == 2 || sizeof(Index) == 4);
+
+            return add(name, layout, std::as_bytes(std::span(vertices)), std::as_bytes(std::span(indices)),
+                       sizeof(Index) == 2 ? vk::IndexType::eUint16 : vk::IndexType::eUint32, bounds);
+        }
+
+        void write(const std::filesystem::path &path) const;
+
+      private:
+        struct PendingMesh {
+            MeshPackEntry          entry;
+            std::vector<std::byte> vertex_data;
+            std::vector<std::byte> index_data;
+        };
+
+        std::vector<PendingMesh>       m_meshes;
+        std::vector<MeshPackBinding>   m_bindings;
+        std::vector<MeshPackAttribute> m_attributes;
+    };
+} // namespace vke
@@ -0,0 +1,78 @@
+#include "meshlet.hpp"
+
+#include <meshoptimizer.h>
+
+#include <cstring>
+#include <stdexcept>
+
+#include "vke/mesh_optimizer.hpp"
+
+namespace vke {
+    MeshletData build_meshlets(const std::span<const std::byte> vertex_data, const uint32_t vertex_stride, const std::span<const std::byte> index_data,
+                               const vk::IndexType index_type, const MeshletSettings &settings) {
+        if (vertex_stride == 0) {
+            throw std::runtime_error("Meshlet building needs the vertex stride.");
+        }
+
+        if (settings.position_offset + 3 * sizeof(float) > vertex_stride) {
+            throw std::runtime_error("Meshlet building position offset is outside the vertex.");
+        }
+
+        if (settings.max_vertices < 3 || settings.max_vertices > MESHLET_MAX_VERTICES || settings.max_triangles > MESHLET_MAX_TRIANGLES || settings.max_triangles % 4 != 0) {
+            throw std::runtime_error("Meshlet size limits aren't supported by the meshlet shaders.");
+        }
+
+        const std::vector<uint32_t> indices = read_indices(index_data, index_type);
+        if (indices.size() % 3 != 0) {
+            throw std::runtime_error("Meshlet building only works on triangle lists.");
+        }
+
+        const size_t vertex_count = vertex_data.size() / vertex_stride;
+        const auto   positions    = reinterpret_cast<const float *>(vertex_data.data() + settings.position_offset);
+
+        const size_t                 max_meshlets = meshopt_buildMeshletsBound(indices.size(), settings.max_vertices, settings.max_triangles);
+        std::vector<meshopt_Meshlet> meshlets(max_meshlets);
+        std::vector<uint32_t>        meshlet_vertices(max_meshlets * settings.max_vertices);
+        std::vector<uint8_t>         meshlet_triangles(max_meshlets * settings.max_triangles * 3);
+
+        meshlets.resize(meshopt_buildMeshlets(meshlets.data(), meshlet_vertices.data(), meshlet_triangles.data(), indices.data(), indices.size(), positions, vertex_count,
+                                              vertex_stride, settings.max_vertices, settings.max_triangles, settings.cone_weight));
+
+        MeshletData data{};
+        if (meshlets.empty())
+            return data;
+
+        const meshopt_Meshlet &last = meshlets.back();
+        meshlet_vertices.resize(last.vertex_offset + last.vertex_count);
+        meshlet_triangles.resize(last.triangle_offset + ((last.triangle_count * 3 + 3) & ~3u)); // each meshlet's triangles are padded to 4 bytes
+
+        data.meshlets.reserve(meshlets.size());
+        for (const auto &meshlet : meshlets) {
+            uint32_t *vertices  = &meshlet_vertices[meshlet.vertex_offset];
+            uint8_t  *triangles = &meshlet_triangles[meshlet.triangle_offset];
+
+            // puts the vertices in the order the triangles first use them, so the mesh shader's vertex fetches are closer together
+            meshopt_optimizeMeshlet(vertices, triangles, meshlet.triangle_count, meshlet.vertex_count);
+
+            const meshopt_Bounds bounds = meshopt_computeMeshletBounds(vertices, triangles, meshlet.triangle_count, positions, vertex_count, vertex_stride);
+
+            data.meshlets.push_back(GpuMeshlet{
+                .center          = {bounds.center[0], bounds.center[1], bounds.center[2]},
+                .radius          = bounds.radius,
+                .cone_axis       = {bounds.cone_axis[0], bounds.cone_axis[1], bounds.cone_axis[2]},
+                .cone_cutoff     = bounds.cone_cutoff,
+                .vertex_offset   = meshlet.vertex_offset,
+                .triangle_offset = meshlet.triangle_offset,
+                .vertex_count    = meshlet.vertex_count,
+                .triangle_count  = meshlet.triangle_count,
+            });
+            data.triangle_count += meshlet.triangle_count;
+        }
+
+        data.vertices = std::move(meshlet_vertices);
+        data.triangles.resize((meshlet_triangles.size() + 3) / 4);
+        std::memcpy(data.triangles.data(), meshlet_triangles.data(), meshlet_triangles.size());
+
+        return data;
+    }
+} // namespace vke
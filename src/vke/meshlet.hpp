@@ -0,0 +1,87 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace vke {
+    // the meshlet shaders (res/meshlet.task, res/meshlet.mesh and res/meshlet_expand.comp) are written for these, so meshlets can't be any bigger
+    static constexpr uint32_t MESHLET_MAX_VERTICES  = 64;
+    static constexpr uint32_t MESHLET_MAX_TRIANGLES = 124;
+    static constexpr uint32_t MESHLETS_PER_TASK     = 32; // the task shader's workgroup size
+
+    struct MeshletSettings {
+        uint32_t                position_offset = 0; // offset of a vec3 (3 floats) position in each vertex
+        std::optional<uint32_t> uv_offset;           // a vec2 the mesh shader passes on to the fragment shader at location 0
+
+        // at most MESHLET_MAX_VERTICES and MESHLET_MAX_TRIANGLES, max_triangles has to be a multiple of 4
+        uint32_t max_vertices  = MESHLET_MAX_VERTICES;
+        uint32_t max_triangles = MESHLET_MAX_TRIANGLES;
+
+        // 0 groups triangles purely by locality, higher values give tighter normal cones (so more backface culling) at the cost of bigger bounds
+        float cone_weight = 0.25f;
+    };
+
+    // std430, matches the shaders
+    struct GpuMeshlet {
+        glm::vec3 center; // bounding sphere
+        float     radius;
+        glm::vec3 cone_axis; // the meshlet is facing away from the camera if dot(center - camera, cone_axis) >= cone_cutoff * distance + radius
+        float     cone_cutoff;
+        uint32_t  vertex_offset;   // into MeshletData::vertices
+        uint32_t  triangle_offset; // in bytes, into MeshletData::triangles
+        uint32_t  vertex_count;
+        uint32_t  triangle_count;
+    };
+
+    static_assert(sizeof(GpuMeshlet) == 48);
+
+    struct MeshletData {
+        std::vector<GpuMeshlet> meshlets;
+        std::vector<uint32_t>   vertices;  // indices into the mesh's vertex buffer
+        std::vector<uint32_t>   triangles; // 3 bytes per triangle indexing the meshlet's vertices, packed 4 bytes to a uint
+        uint32_t                triangle_count = 0;
+    };
+
+    // splits an indexed triangle list into meshlets (with meshoptimizer), and computes their culling bounds
+    [[nodiscard]] MeshletData build_meshlets(std::span<const std::byte> vertex_data, uint32_t vertex_stride, std::span<const std::byte> index_data, vk::IndexType index_type,
+                                             const MeshletSettings &settings = {});
+
+    // a mesh's meshlets on the gpu, see ExtraMeshSettings::meshlets
+    struct MeshletBuffer {
+        static constexpr uint32_t NO_UV = 0xffffffff;
+
+        vk::Buffer        buffer; // the meshlets, then their vertices, then their triangles
+        vk::DeviceAddress address          = 0;
+        vk::DeviceSize    vertices_offset  = 0;
+        vk::DeviceSize    triangles_offset = 0;
+        uint32_t          meshlet_count    = 0;
+        uint32_t          triangle_count   = 0; // over every meshlet
+        uint32_t          vertex_stride    = 0;
+        uint32_t          position_offset  = 0;
+        uint32_t          uv_offset        = NO_UV;
+    };
+
+    // push constants of res/meshlet.task and res/meshlet.mesh. exactly DescriptorHeap::PUSH_CONSTANT_SIZE, so they fit the heap's layout.
+    struct MeshletDrawConstants {
+        glm::mat4         mvp;
+        vk::DeviceAddress meshlets;
+        vk::DeviceAddress meshlet_vertices;
+        vk::DeviceAddress meshlet_triangles;
+        vk::DeviceAddress vertices;
+        glm::vec3         camera_position; // in the mesh's object space
+        uint32_t          meshlet_count;
+        uint32_t          vertex_stride;
+        uint32_t          position_offset;
+        uint32_t          uv_offset;
+        uint32_t          padding = 0;
+    };
+
+    static_assert(sizeof(MeshletDrawConstants) == 128);
+} // namespace vke
@@ -0,0 +1,75 @@
+#include "meshlet_expander.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+namespace vke {
+    // the spec only guarantees this many workgroups per dimension, bigger meshes spill over into y
+    static constexpr uint32_t MAX_DISPATCH_WIDTH = 65535;
+
+    MeshletExpansion::MeshletExpansion(const std::shared_ptr<RenderContext> &rc, const Mesh &mesh) : m_rc(rc) {
+        const std::optional<MeshletBuffer> meshlets = mesh.meshlets();
+        if (!meshlets.has_value()) {
+            throw std::runtime_error("Mesh has no meshlets to expand.");
+        }
+
+        const vk::BufferUsageFlags usage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eShaderDeviceAddress;
+        m_indices      = m_rc->create_buffer(meshlets->triangle_count * 3 * sizeof(uint32_t), nullptr, MemoryUsage::DeviceOnly, usage | vk::BufferUsageFlagBits::eIndexBuffer);
+        m_draw_command = m_rc->create_buffer(sizeof(vk::DrawIndexedIndirectCommand), nullptr, MemoryUsage::DeviceOnly,
+                                             usage | vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eTransferDst);
+    }
+
+    MeshletExpansion::~MeshletExpansion() {
+        m_rc->defer_destruction([rc = m_rc, indices = m_indices, draw_command = m_draw_command] {
+            rc->destroy_buffer(indices);
+            rc->destroy_buffer(draw_command);
+        });
+    }
+
+    static ComputePipelineBuilder expand_pipeline_builder(const vk::ShaderModule module) {
+        ComputePipelineBuilder builder{};
+        builder.module               = module;
+        builder.push_constant_ranges = {vk::PushConstantRange{vk::ShaderStageFlagBits::eCompute, 0, sizeof(MeshletExpandConstants)}};
+        return builder;
+    }
+
+    MeshletExpander::MeshletExpander(const std::shared_ptr<RenderContext> &rc, const vk::ShaderModule module)
+        : m_rc(rc), m_pipeline(rc->device(), expand_pipeline_builder(module)) {}
+
+    void MeshletExpander::record(const vk::CommandBuffer cmd, const Mesh &mesh, const MeshletExpansion &expansion, const glm::mat4 &mvp, const glm::vec3 &camera_position,
+                                 const uint32_t instance_count, const uint32_t first_instance) const {
+        const std::optional<MeshletBuffer> meshlets = mesh.meshlets();
+        assert(meshlets.has_value());
+
+        // the shader counts the indices it writes into index_count
+        const vk::DrawIndexedIndirectCommand draw{0, instance_count, 0, 0, first_instance};
+        cmd.updateBuffer(expansion.draw_command().buffer, 0, sizeof(draw), &draw);
+        cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader, {},
+                            vk::MemoryBarrier(vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite), {}, {});
+
+        const MeshletExpandConstants constants{
+            .mvp               = mvp,
+            .meshlets          = meshlets->address,
+            .meshlet_vertices  = meshlets->address + meshlets->vertices_offset,
+            .meshlet_triangles = meshlets->address + meshlets->triangles_offset,
+            .indices           = expansion.indices().address,
+            .camera_position   = camera_position,
+            .meshlet_count     = meshlets->meshlet_count,
+            .draw_command      = expansion.draw_command().address,
+        };
+
+        cmd.bindPipeline(vk::PipelineBindPoint::eCompute, m_pipeline.get());
+        cmd.pushConstants(m_pipeline.layout(), vk::ShaderStageFlagBits::eCompute, 0, sizeof(MeshletExpandConstants), &constants);
+        cmd.dispatch(std::min(meshlets->meshlet_count, MAX_DISPATCH_WIDTH), (meshlets->meshlet_count + MAX_DISPATCH_WIDTH - 1) / MAX_DISPATCH_WIDTH, 1);
+
+        cmd.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eVertexInput, {},
+                            vk::MemoryBarrier(vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eIndirectCommandRead | vk::AccessFlagBits::eIndexRead), {}, {});
+    }
+
+    void MeshletExpander::draw(const ActiveRenderer &renderer, const Mesh &mesh, const MeshletExpansion &expansion) {
+        renderer->bindVertexBuffers(0, mesh.vertex_buffer().buffer, 0ULL);
+        renderer->bindIndexBuffer(expansion.indices().buffer, 0, vk::IndexType::eUint32);
+        renderer->drawIndexedIndirect(expansion.draw_command().buffer, 0, 1, sizeof(vk::DrawIndexedIndirectCommand));
+    }
+} // namespace vke
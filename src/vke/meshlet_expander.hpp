@@ -0,0 +1,75 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <glm/glm.hpp>
+
+#include <memory>
+
+#include "vke/mesh.hpp"
+#include "vke/render_context.hpp"
+#include "vke/renderer.hpp"
+
+namespace vke {
+    // push constants of res/meshlet_expand.comp
+    struct MeshletExpandConstants {
+        glm::mat4         mvp;
+        vk::DeviceAddress meshlets;
+        vk::DeviceAddress meshlet_vertices;
+        vk::DeviceAddress meshlet_triangles;
+        vk::DeviceAddress indices;
+        glm::vec3         camera_position; // in the mesh's object space
+        uint32_t          meshlet_count;
+        vk::DeviceAddress draw_command;
+    };
+
+    static_assert(sizeof(MeshletExpandConstants) == 120);
+
+    // where MeshletExpander writes a mesh's surviving triangles, big enough for all of them
+    class MeshletExpansion {
+      public:
+        MeshletExpansion(const std::shared_ptr<RenderContext> &rc, const Mesh &mesh);
+        ~MeshletExpansion();
+
+        MeshletExpansion(const MeshletExpansion &other)                = delete;
+        MeshletExpansion &operator=(const MeshletExpansion &other)     = delete;
+        MeshletExpansion(MeshletExpansion &&other) noexcept            = delete;
+        MeshletExpansion &operator=(MeshletExpansion &&other) noexcept = delete;
+
+        [[nodiscard]] const BufferInfo &indices() const { return m_indices; }
+
+        [[nodiscard]] const BufferInfo &draw_command() const { return m_draw_command; }
+
+      private:
+        std::shared_ptr<RenderContext> m_rc;
+        BufferInfo                     m_indices;      // 32 bit indices into the mesh's vertex buffer
+        BufferInfo                     m_draw_command; // a vk::DrawIndexedIndirectCommand
+    };
+
+    /**
+     * @brief The fallback for ActiveRenderer::draw_meshlets on devices without mesh shaders.
+     *
+     * A compute pass (res/meshlet_expand.comp, one workgroup per meshlet) does the same frustum and cone culling as the task shader, and writes the triangles of every meshlet
+     * which survives into an index buffer along with an indirect draw. That is then drawn with an ordinary vertex pipeline, so the vertex shader only runs for visible clusters.
+     * An expansion is written on the gpu every frame, so each frame in flight needs its own.
+     */
+    class MeshletExpander {
+      public:
+        MeshletExpander(const std::shared_ptr<RenderContext> &rc, vk::ShaderModule module);
+
+        /**
+         * @brief Records culling the mesh's meshlets into expansion. This is a dispatch, so it has to be recorded outside of rendering.
+         *
+         * mvp and camera_position are the same as for ActiveRenderer::draw_meshlets. Includes the barriers for draw to read the results.
+         */
+        void record(vk::CommandBuffer cmd, const Mesh &mesh, const MeshletExpansion &expansion, const glm::mat4 &mvp, const glm::vec3 &camera_position,
+                    uint32_t instance_count = 1, uint32_t first_instance = 0) const;
+
+        // binds the mesh's vertex buffer and the expanded indices, and draws them indirectly
+        static void draw(const ActiveRenderer &renderer, const Mesh &mesh, const MeshletExpansion &expansion);
+
+      private:
+        std::shared_ptr<RenderContext> m_rc;
+        ComputePipeline                m_pipeline;
+    };
+} // namespace vke
@@ -0,0 +1,211 @@
+#include "pipeline_library.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <iterator>
+
+namespace vke {
+    static constexpr std::array PIPELINE_PARTS = {
+        vk::GraphicsPipelineLibraryFlagBitsEXT::eVertexInputInterface,
+        vk::GraphicsPipelineLibraryFlagBitsEXT::ePreRasterizationShaders,
+        vk::GraphicsPipelineLibraryFlagBitsEXT::eFragmentShader,
+        vk::GraphicsPipelineLibraryFlagBitsEXT::eFragmentOutputInterface,
+    };
+
+    // only the state a part is built from, so pipelines which share that state share the part's library
+    static GraphicsPipelineBuilder part_key(const GraphicsPipelineBuilder &key, const vk::GraphicsPipelineLibraryFlagBitsEXT part) {
+        GraphicsPipelineBuilder part_builder{};
+        part_builder.dynamic_states = key.dynamic_states;
+        part_builder.render_pass    = key.render_pass;
+
+        const auto copy_multisample_state = [&] {
+            part_builder.enable_sample_shading    = key.enable_sample_shading;
+            part_builder.rasterization_samples    = key.rasterization_samples;
+            part_builder.min_sample_shading       = key.min_sample_shading;
+            part_builder.sample_mask              = key.sample_mask;
+            part_builder.enable_alpha_to_coverage = key.enable_alpha_to_coverage;
+            part_builder.enable_alpha_to_one      = key.enable_alpha_to_one;
+        };
+
+        const auto copy_view_mask = [&] {
+            if (key.dynamic_rendering_info.has_value())
+                part_builder.dynamic_rendering_info = DynamicRenderingInfo{.view_mask = key.dynamic_rendering_info->view_mask};
+        };
+
+        switch (part) {
+        case vk::GraphicsPipelineLibraryFlagBitsEXT::eVertexInputInterface:
+            part_builder.vertex_buffer_bindings   = key.vertex_buffer_bindings;
+            part_builder.topology                 = key.topology;
+            part_builder.enable_primitive_restart = key.enable_primitive_restart;
+            break;
+        case vk::GraphicsPipelineLibraryFlagBitsEXT::ePreRasterizationShaders:
+            std::ranges::copy_if(key.stages, std::back_inserter(part_builder.stages), [](const ShaderStage &stage) { return stage.stage != vk::ShaderStageFlagBits::eFragment; });
+            part_builder.viewports                 = key.viewports;
+            part_builder.scissors                  = key.scissors;
+            part_builder.enable_depth_clamp        = key.enable_depth_clamp;
+            part_builder.discard_rasterizer_output = key.discard_rasterizer_output;
+            part_builder.polygon_mode              = key.polygon_mode;
+            part_builder.cull_mode                 = key.cull_mode;
+            part_builder.front_face                = key.front_face;
+            part_builder.line_width                = key.line_width;
+            part_builder.depth_bias                = key.depth_bias;
+            part_builder.layout                    = key.layout;
+            copy_view_mask();
+            break;
+        case vk::GraphicsPipelineLibraryFlagBitsEXT::eFragmentShader:
+            std::ranges::copy_if(key.stages, std::back_inserter(part_builder.stages), [](const ShaderStage &stage) { return stage.stage == vk::ShaderStageFlagBits::eFragment; });
+            part_builder.layout = key.layout;
+            copy_multisample_state();
+            copy_view_mask();
+            break;
+        case vk::GraphicsPipelineLibraryFlagBitsEXT::eFragmentOutputInterface:
+            part_builder.color_blend_attachments = key.color_blend_attachments;
+            part_builder.logic_op                = key.logic_op;
+            part_builder.blend_constants         = key.blend_constants;
+            part_builder.dynamic_rendering_info  = key.dynamic_rendering_info;
+            copy_multisample_state();
+            break;
+        }
+
+        return part_builder;
+    }
+
+    GraphicsPipelineLinker::GraphicsPipelineLinker(const std::shared_ptr<RenderContext> &rc, const vk::PipelineCache cache) : m_rc(rc), m_cache(cache) {
+        if (uses_libraries())
+            m_thread = std::jthread([this](const std::stop_token &stop) { run(stop); });
+    }
+
+    GraphicsPipelineLinker::~GraphicsPipelineLinker() {
+        if (m_thread.joinable()) {
+            m_thread.request_stop();
+            m_thread.join();
+        }
+
+        // frames in flight may still be using these
+        m_rc->defer_destruction([pipelines = std::move(m_pipelines), libraries = std::move(m_libraries)]() mutable {
+            pipelines.clear();
+            for (auto &part : libraries) {
+                part.clear();
+            }
+        });
+    }
+
+    std::shared_ptr<ReloadablePipeline> GraphicsPipelineLinker::get(const GraphicsPipelineBuilder &builder) {
+        GraphicsPipelineBuilder key = PipelineRegistry::canonical(builder);
+
+        {
+            std::lock_guard lock(m_mutex);
+            if (const auto it = m_pipelines.find(key); it != m_pipelines.end())
+                return it->second;
+        }
+
+        if (!uses_libraries()) {
+            auto pipeline = std::make_shared<ReloadablePipeline>(std::make_shared<GraphicsPipeline>(m_rc->device(), builder, m_cache));
+
+            std::lock_guard lock(m_mutex);
+            return m_pipelines.try_emplace(std::move(key), std::move(pipeline)).first->second;
+        }
+
+        const Libraries                      parts = libraries(key);
+        std::array<vk::Pipeline, PART_COUNT> handles;
+        std::ranges::transform(parts, handles.begin(), &GraphicsPipeline::get);
+
+        auto pipeline = std::make_shared<ReloadablePipeline>(std::make_shared<GraphicsPipeline>(m_rc->device(), handles, key.layout, false, m_cache));
+
+        std::lock_guard lock(m_mutex);
+        const auto [it, inserted] = m_pipelines.try_emplace(key, std::move(pipeline));
+        if (inserted) {
+            std::lock_guard queue_lock(m_queue_mutex);
+            m_queue.push_back(OptimizeRequest{it->second, parts, key.layout});
+            m_queue_cv.notify_one();
+        }
+
+        return it->second;
+    }
+
+    void GraphicsPipelineLinker::prepare(const GraphicsPipelineBuilder &builder) {
+        if (uses_libraries())
+            (void)libraries(PipelineRegistry::canonical(builder));
+    }
+
+    void GraphicsPipelineLinker::update() {
+        std::vector<Optimized> optimized;
+        {
+            std::lock_guard lock(m_queue_mutex);
+            optimized.swap(m_optimized);
+        }
+
+        for (auto &[target, pipeline] : optimized) {
+            // frames in flight may still be using the fast linked pipeline
+            m_rc->defer_destruction([old = target->replace(std::move(pipeline))]() mutable { old.reset(); });
+        }
+    }
+
+    size_t GraphicsPipelineLinker::library_count() const {
+        std::lock_guard lock(m_mutex);
+
+        size_t count = 0;
+        for (const auto &part : m_libraries) {
+            count += part.size();
+        }
+
+        return count;
+    }
+
+    GraphicsPipelineLinker::Libraries GraphicsPipelineLinker::libraries(const GraphicsPipelineBuilder &key) {
+        Libraries parts;
+        for (size_t i = 0; i < PART_COUNT; i++) {
+            GraphicsPipelineBuilder part = part_key(key, PIPELINE_PARTS[i]);
+
+            {
+                std::lock_guard lock(m_mutex);
+                if (const auto it = m_libraries[i].find(part); it != m_libraries[i].end()) {
+                    parts[i] = it->second;
+                    continue;
+                }
+            }
+
+            // compiled outside the lock so other parts and pipelines aren't stuck behind it. if another thread made the same library first, this one is dropped.
+            auto library = std::make_shared<GraphicsPipeline>(m_rc->device(), part, PIPELINE_PARTS[i], m_cache);
+
+            std::lock_guard lock(m_mutex);
+            parts[i] = m_libraries[i].try_emplace(std::move(part), std::move(library)).first->second;
+        }
+
+        return parts;
+    }
+
+    void GraphicsPipelineLinker::run(const std::stop_token &stop) {
+        while (true) {
+            OptimizeRequest request;
+            {
+                std::unique_lock lock(m_queue_mutex);
+                if (!m_queue_cv.wait(lock, stop, [this] { return !m_queue.empty(); }))
+                    return;
+
+                request = std::move(m_queue.front());
+                m_queue.pop_front();
+            }
+
+            if (request.target.expired())
+                continue;
+
+            std::array<vk::Pipeline, PART_COUNT> handles;
+            std::ranges::transform(request.libraries, handles.begin(), &GraphicsPipeline::get);
+
+            std::shared_ptr<GraphicsPipeline> pipeline;
+            try {
+                pipeline = std::make_shared<GraphicsPipeline>(m_rc->device(), handles, request.layout, true, m_cache);
+            } catch (const vk::SystemError &e) {
+                spdlog::warn("Optimized pipeline link failed, keeping the fast linked pipeline: {}", e.what());
+                continue;
+            }
+
+            if (auto target = request.target.lock()) {
+                std::lock_guard lock(m_queue_mutex);
+                m_optimized.push_back(Optimized{std::move(target), std::move(pipeline)});
+            }
+        }
+    }
+} // namespace vke
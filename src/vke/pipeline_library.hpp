@@ -0,0 +1,88 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <array>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "vke/pipeline_registry.hpp"
+#include "vke/render_context.hpp"
+#include "vke/renderer.hpp"
+
+namespace vke {
+    /**
+     * @brief Builds graphics pipelines out of separately cached pipeline libraries (VK_EXT_graphics_pipeline_library).
+     *
+     * A builder is split into its vertex input, pre-rasterization, fragment shader and fragment output parts, each compiled once into a library and shared by every pipeline
+     * with the same state for that part. get links the four into a pipeline straight away, which is quick enough to do mid-frame once the libraries exist, and queues an
+     * optimized link on a background thread. update swaps the optimized pipeline in when it's done.
+     *
+     * Without the extension every pipeline is compiled monolithically in get, same as constructing a GraphicsPipeline.
+     */
+    class GraphicsPipelineLinker {
+      public:
+        explicit GraphicsPipelineLinker(const std::shared_ptr<RenderContext> &rc, vk::PipelineCache cache = VK_NULL_HANDLE);
+        ~GraphicsPipelineLinker();
+
+        GraphicsPipelineLinker(const GraphicsPipelineLinker &other)                = delete;
+        GraphicsPipelineLinker &operator=(const GraphicsPipelineLinker &other)     = delete;
+        GraphicsPipelineLinker(GraphicsPipelineLinker &&other) noexcept            = delete;
+        GraphicsPipelineLinker &operator=(GraphicsPipelineLinker &&other) noexcept = delete;
+
+        [[nodiscard]] inline bool uses_libraries() const { return m_rc->features().graphics_pipeline_library; }
+
+        // the same builder (ignoring dynamic state, see PipelineRegistry::canonical) always gives back the same pipeline
+        [[nodiscard]] std::shared_ptr<ReloadablePipeline> get(const GraphicsPipelineBuilder &builder);
+
+        // compiles the libraries for a builder ahead of time (ie. at load), so get only has to link. does nothing without the extension.
+        void prepare(const GraphicsPipelineBuilder &builder);
+
+        // swaps in optimized pipelines. call this at a frame boundary, it never waits on the background thread.
+        void update();
+
+        [[nodiscard]] size_t library_count() const;
+
+      private:
+        static constexpr size_t PART_COUNT = 4;
+
+        using Libraries = std::array<std::shared_ptr<GraphicsPipeline>, PART_COUNT>;
+
+        template <typename T>
+        using BuilderMap = std::unordered_map<GraphicsPipelineBuilder, T, GraphicsPipelineBuilderHash>;
+
+        struct OptimizeRequest {
+            std::weak_ptr<ReloadablePipeline> target;
+            Libraries                         libraries;
+            vk::PipelineLayout                layout;
+        };
+
+        struct Optimized {
+            std::shared_ptr<ReloadablePipeline> target;
+            std::shared_ptr<GraphicsPipeline>   pipeline;
+        };
+
+        std::shared_ptr<RenderContext> m_rc;
+        vk::PipelineCache              m_cache;
+
+        mutable std::mutex                                                    m_mutex;
+        std::array<BuilderMap<std::shared_ptr<GraphicsPipeline>>, PART_COUNT> m_libraries; // by part
+        BuilderMap<std::shared_ptr<ReloadablePipeline>>                       m_pipelines;
+
+        std::mutex                  m_queue_mutex;
+        std::condition_variable_any m_queue_cv;
+        std::deque<OptimizeRequest> m_queue;
+        std::vector<Optimized>      m_optimized; // also guarded by m_queue_mutex
+
+        std::jthread m_thread;
+
+        [[nodiscard]] Libraries libraries(const GraphicsPipelineBuilder &key);
+
+        void run(const std::stop_token &stop);
+    };
+} // namespace vke
@@ -0,0 +1,246 @@
+#include "pipeline_registry.hpp"
+
+#include <algorithm>
+#include <ranges>
+#include <span>
+#include <string_view>
+
+#include "vke/util.hpp"
+
+namespace vke {
+    template <typename E>
+        requires std::is_enum_v<E>
+    static void hash_enum(size_t &seed, const E value) {
+        hash_combine(seed, static_cast<std::underlying_type_t<E>>(value));
+    }
+
+    template <typename F>
+    static void hash_flags(size_t &seed, const vk::Flags<F> value) {
+        hash_combine(seed, static_cast<typename vk::Flags<F>::MaskType>(value));
+    }
+
+    static void hash_blend_function(size_t &seed, const BlendFunction &function) {
+        hash_enum(seed, function.src);
+        hash_enum(seed, function.dst);
+        hash_enum(seed, function.op);
+    }
+
+    size_t GraphicsPipelineBuilderHash::operator()(const GraphicsPipelineBuilder &builder) const {
+        size_t seed = 0;
+
+        for (const auto &stage : builder.stages) {
+            hash_enum(seed, stage.stage);
+            hash_combine(seed, stage.entry_point);
+            hash_combine(seed, stage.module);
+
+            const auto specialization = stage.specialization.info();
+            for (const auto &entry : std::span(specialization.pMapEntries, specialization.mapEntryCount)) {
+                hash_combine(seed, entry.constantID);
+                hash_combine(seed, entry.offset);
+            }
+            hash_combine(seed, std::string_view(static_cast<const char *>(specialization.pData), specialization.dataSize));
+        }
+
+        for (const auto state : builder.dynamic_states) {
+            hash_enum(seed, state);
+        }
+
+        for (const auto &binding : builder.vertex_buffer_bindings) {
+            hash_combine(seed, binding.binding);
+            hash_combine(seed, binding.stride);
+            hash_enum(seed, binding.input_rate);
+            for (const auto &attribute : binding.attributes) {
+                hash_combine(seed, attribute.location);
+                hash_enum(seed, attribute.format);
+                hash_combine(seed, attribute.offset);
+            }
+        }
+
+        hash_enum(seed, builder.topology);
+        hash_combine(seed, builder.enable_primitive_restart);
+
+        for (const auto &viewport : builder.viewports) {
+            hash_combine(seed, viewport.x);
+            hash_combine(seed, viewport.y);
+            hash_combine(seed, viewport.width);
+            hash_combine(seed, viewport.height);
+            hash_combine(seed, viewport.minDepth);
+            hash_combine(seed, viewport.maxDepth);
+        }
+
+        for (const auto &scissor : builder.scissors) {
+            hash_combine(seed, scissor.offset.x);
+            hash_combine(seed, scissor.offset.y);
+            hash_combine(seed, scissor.extent.width);
+            hash_combine(seed, scissor.extent.height);
+        }
+
+        hash_combine(seed, builder.enable_depth_clamp);
+        hash_combine(seed, builder.discard_rasterizer_output);
+        hash_enum(seed, builder.polygon_mode);
+        hash_flags(seed, builder.cull_mode);
+        hash_enum(seed, builder.front_face);
+        hash_combine(seed, builder.line_width);
+        if (builder.depth_bias.has_value()) {
+            hash_combine(seed, builder.depth_bias->constant_factor);
+            hash_combine(seed, builder.depth_bias->clamp);
+            hash_combine(seed, builder.depth_bias->slope_factor);
+        }
+
+        hash_combine(seed, builder.enable_sample_shading);
+        hash_enum(seed, builder.rasterization_samples);
+        hash_combine(seed, builder.min_sample_shading);
+        for (const auto mask : builder.sample_mask) {
+            hash_combine(seed, mask);
+        }
+        hash_combine(seed, builder.enable_alpha_to_coverage);
+        hash_combine(seed, builder.enable_alpha_to_one);
+
+        for (const auto &attachment : builder.color_blend_attachments) {
+            hash_flags(seed, attachment.color_write_mask);
+            hash_combine(seed, attachment.enable_blending);
+            hash_blend_function(seed, attachment.color);
+            hash_blend_function(seed, attachment.alpha);
+        }
+        if (builder.logic_op.has_value())
+            hash_enum(seed, builder.logic_op.value());
+        for (const auto constant : builder.blend_constants) {
+            hash_combine(seed, constant);
+        }
+
+        hash_combine(seed, builder.layout);
+
+        if (builder.dynamic_rendering_info.has_value()) {
+            for (const auto format : builder.dynamic_rendering_info->color_formats) {
+                hash_enum(seed, format);
+            }
+            hash_enum(seed, builder.dynamic_rendering_info->depth_format);
+            hash_enum(seed, builder.dynamic_rendering_info->stencil_format);
+            hash_combine(seed, builder.dynamic_rendering_info->view_mask);
+        }
+
+        if (builder.render_pass.has_value()) {
+            hash_combine(seed, builder.render_pass->first);
+            hash_combine(seed, builder.render_pass->second);
+        }
+
+        return seed;
+    }
+
+    PipelineRegistry::PipelineRegistry(const std::shared_ptr<RenderContext> &rc, const vk::PipelineCache cache) : m_rc(rc), m_cache(cache) {}
+
+    PipelineRegistry::~PipelineRegistry() {
+        // anything still held outside is kept alive by its owners, the rest may be in use by a frame in flight
+        for (auto &entry : m_entries | std::views::values) {
+            m_rc->defer_destruction([pipeline = std::move(entry.pipeline)]() mutable { pipeline.reset(); });
+        }
+    }
+
+    std::shared_ptr<GraphicsPipeline> PipelineRegistry::get(const GraphicsPipelineBuilder &builder) {
+        GraphicsPipelineBuilder key = canonical(builder);
+
+        {
+            std::lock_guard lock(m_mutex);
+            if (const auto it = m_entries.find(key); it != m_entries.end()) {
+                it->second.uses++;
+                m_stats.hits++;
+                return it->second.pipeline;
+            }
+        }
+
+        const auto start    = std::chrono::steady_clock::now();
+        auto       pipeline = std::make_shared<GraphicsPipeline>(m_rc->device(), builder, m_cache);
+        const auto end      = std::chrono::steady_clock::now();
+
+        std::lock_guard lock(m_mutex);
+        const auto it = m_entries.try_emplace(std::move(key), PipelineRegistryEntry{std::move(pipeline), 0, end, end - start}).first;
+        it->second.uses++;
+        m_stats.misses++;
+        m_stats.creation_time += end - start;
+
+        // if another thread created the same state first, ours was never used and is just dropped
+        return it->second.pipeline;
+    }
+
+    size_t PipelineRegistry::release_unused() {
+        std::lock_guard lock(m_mutex);
+        return std::erase_if(m_entries, [this](auto &entry) {
+            if (entry.second.pipeline.use_count() > 1)
+                return false;
+
+            m_rc->defer_destruction([pipeline = std::move(entry.second.pipeline)]() mutable { pipeline.reset(); });
+            return true;
+        });
+    }
+
+    std::vector<PipelineRegistryEntry> PipelineRegistry::entries() const {
+        std::lock_guard lock(m_mutex);
+        const auto      values = m_entries | std::views::values;
+        return {values.begin(), values.end()};
+    }
+
+    PipelineRegistryStats PipelineRegistry::stats() const {
+        std::lock_guard lock(m_mutex);
+        return m_stats;
+    }
+
+    size_t PipelineRegistry::size() const {
+        std::lock_guard lock(m_mutex);
+        return m_entries.size();
+    }
+
+    GraphicsPipelineBuilder PipelineRegistry::canonical(const GraphicsPipelineBuilder &builder) {
+        GraphicsPipelineBuilder key        = builder;
+        const auto              is_dynamic = [&](const vk::DynamicState state) { return std::ranges::contains(builder.dynamic_states, state); };
+
+        // order doesn't matter to the pipeline
+        std::ranges::sort(key.dynamic_states);
+
+        // the pipeline only keeps the counts of dynamic viewports and scissors
+        if (is_dynamic(vk::DynamicState::eViewport))
+            std::ranges::fill(key.viewports, vk::Viewport{});
+        if (is_dynamic(vk::DynamicState::eScissor))
+            std::ranges::fill(key.scissors, vk::Rect2D{});
+        if (is_dynamic(vk::DynamicState::eBlendConstants))
+            key.blend_constants = {};
+        if (is_dynamic(vk::DynamicState::eLineWidth))
+            key.line_width = 1.0f;
+
+        // extended dynamic state. the topology stays in the key, since it can only change within its class.
+        if (is_dynamic(vk::DynamicState::eCullMode))
+            key.cull_mode = vk::CullModeFlagBits::eBack;
+        if (is_dynamic(vk::DynamicState::eFrontFace))
+            key.front_face = vk::FrontFace::eClockwise;
+        if (is_dynamic(vk::DynamicState::ePrimitiveRestartEnable))
+            key.enable_primitive_restart = false;
+        if (is_dynamic(vk::DynamicState::eRasterizerDiscardEnable))
+            key.discard_rasterizer_output = false;
+        if (is_dynamic(vk::DynamicState::eDepthBias) && key.depth_bias.has_value())
+            key.depth_bias = DepthBias{};
+        if (is_dynamic(vk::DynamicState::eDepthBiasEnable) && is_dynamic(vk::DynamicState::eDepthBias))
+            key.depth_bias = std::nullopt;
+        if (is_dynamic(vk::DynamicState::ePolygonModeEXT))
+            key.polygon_mode = vk::PolygonMode::eFill;
+        if (is_dynamic(vk::DynamicState::eDepthClampEnableEXT))
+            key.enable_depth_clamp = false;
+        for (auto &attachment : key.color_blend_attachments) {
+            if (is_dynamic(vk::DynamicState::eColorBlendEnableEXT))
+                attachment.enable_blending = ColorBlendAttachment{}.enable_blending;
+            if (is_dynamic(vk::DynamicState::eColorBlendEquationEXT)) {
+                attachment.color = ColorBlendAttachment{}.color;
+                attachment.alpha = ColorBlendAttachment{}.alpha;
+            }
+            if (is_dynamic(vk::DynamicState::eColorWriteMaskEXT))
+                attachment.color_write_mask = ColorBlendAttachment{}.color_write_mask;
+        }
+
+        // mesh shader pipelines ignore the vertex input and input assembly state
+        if (key.uses_mesh_shaders()) {
+            key.vertex_buffer_bindings.clear();
+            key.topology                 = vk::PrimitiveTopology::eTriangleList;
+            key.enable_primitive_restart = false;
+        }
+
+        return key;
+    }
+} // namespace vke
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "vke/render_context.hpp"
+#include "vke/renderer.hpp"
+
+namespace vke {
+    // hashes everything in the builder which ends up in the pipeline, including module handles (so identical code in two modules still makes two pipelines)
+    struct GraphicsPipelineBuilderHash {
+        size_t operator()(const GraphicsPipelineBuilder &builder) const;
+    };
+
+    struct PipelineRegistryEntry {
+        std::shared_ptr<GraphicsPipeline>     pipeline;
+        uint64_t                              uses; // how many times the state was asked for, including the first time
+        std::chrono::steady_clock::time_point created_at;
+        std::chrono::nanoseconds              creation_time;
+    };
+
+    struct PipelineRegistryStats {
+        uint64_t                 hits   = 0;
+        uint64_t                 misses = 0;
+        std::chrono::nanoseconds creation_time{}; // spent creating pipelines, in total
+    };
+
+    /**
+     * @brief Deduplicates graphics pipelines by their full builder state, so identical builders share one pipeline.
+     *
+     * State which is dynamic is left out of the key (for viewports and scissors only their count matters then), so a resize or a different cull mode doesn't create a new
+     * pipeline. Thread safe, pipelines are created outside the lock.
+     */
+    class PipelineRegistry {
+      public:
+        explicit PipelineRegistry(const std::shared_ptr<RenderContext> &rc, vk::PipelineCache cache = VK_NULL_HANDLE);
+        ~PipelineRegistry();
+
+        PipelineRegistry(const PipelineRegistry &other)                = delete;
+        PipelineRegistry &operator=(const PipelineRegistry &other)     = delete;
+        PipelineRegistry(PipelineRegistry &&other) noexcept            = delete;
+        PipelineRegistry &operator=(PipelineRegistry &&other) noexcept = delete;
+
+        [[nodiscard]] std::shared_ptr<GraphicsPipeline> get(const GraphicsPipelineBuilder &builder);
+
+        // drops pipelines only the registry still holds, they're destroyed once no frame in flight can be using them. returns how many were dropped.
+        size_t release_unused();
+
+        [[nodiscard]] std::vector<PipelineRegistryEntry> entries() const;
+
+        [[nodiscard]] PipelineRegistryStats stats() const;
+
+        [[nodiscard]] size_t size() const;
+
+        // the builder with the state which doesn't affect the pipeline cleared, so builders which make the same pipeline compare equal
+        [[nodiscard]] static GraphicsPipelineBuilder canonical(const GraphicsPipelineBuilder &builder);
+
+      private:
+        std::shared_ptr<RenderContext> m_rc;
+        vk::PipelineCache              m_cache;
+
+        mutable std::mutex                                                                              m_mutex;
+        std::unordered_map<GraphicsPipelineBuilder, PipelineRegistryEntry, GraphicsPipelineBuilderHash> m_entries;
+        PipelineRegistryStats                                                                           m_stats;
+    };
+} // namespace vke
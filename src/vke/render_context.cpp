@@ -2,7 +2,7 @@
 #include <vk_mem_alloc.h>
 
 #include "render_context.hpp"
-#include <shaderc/shaderc.hpp>
+#include "defragmenter.hpp"
 #include <spdlog/sinks/stdout_color_sinks.h>
 #include <spdlog/spdlog.h>
 
@@ -128,6 +128,11 @@ namespace vke {
             bool amd_device_coherent_memory = false;
         } vma_extension_support;
 
+        bool extended_dynamic_state3   = false;
+        bool graphics_pipeline_library = false;
+        bool shader_object             = false;
+        bool mesh_shader               = false;
+
         {
             std::unordered_set<uint32_t> queue_families;
             queue_families.insert(m_queue_families.graphics);
@@ -158,17 +163,46 @@ namespace vke {
                     vma_extension_support.memory_budget = true;
                 }
 
+                // the extension alone does nothing, priorities are only used once the memoryPriority feature is enabled too
                 if (strcmp(extension.extensionName, VK_EXT_MEMORY_PRIORITY_EXTENSION_NAME) == 0) {
-                    device_extensions.push_back(VK_EXT_MEMORY_PRIORITY_EXTENSION_NAME);
-                    vma_extension_support.memory_priority = true;
+                    const auto chain = m_physical_device.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceMemoryPriorityFeaturesEXT>();
+                    if (chain.get<vk::PhysicalDeviceMemoryPriorityFeaturesEXT>().memoryPriority) {
+                        device_extensions.push_back(VK_EXT_MEMORY_PRIORITY_EXTENSION_NAME);
+                        vma_extension_support.memory_priority = true;
+                    }
                 }
 
                 if (strcmp(extension.extensionName, VK_AMD_DEVICE_COHERENT_MEMORY_EXTENSION_NAME) == 0) {
                     device_extensions.push_back(VK_AMD_DEVICE_COHERENT_MEMORY_EXTENSION_NAME);
                     vma_extension_support.amd_device_coherent_memory = true;
                 }
+
+                if (strcmp(extension.extensionName, VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME) == 0) {
+                    device_extensions.push_back(VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME);
+                    extended_dynamic_state3 = true;
+                }
+
+                // VK_KHR_pipeline_library is a dependency, and is always there alongside it
+                if (strcmp(extension.extensionName, VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME) == 0) {
+                    device_extensions.push_back(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME);
+                    device_extensions.push_back(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME);
+                    graphics_pipeline_library = true;
+                }
+
+                if (strcmp(extension.extensionName, VK_EXT_SHADER_OBJECT_EXTENSION_NAME) == 0) {
+                    device_extensions.push_back(VK_EXT_SHADER_OBJECT_EXTENSION_NAME);
+                    shader_object = true;
+                }
+
+                if (strcmp(extension.extensionName, VK_EXT_MESH_SHADER_EXTENSION_NAME) == 0) {
+                    device_extensions.push_back(VK_EXT_MESH_SHADER_EXTENSION_NAME);
+                    mesh_shader = true;
+                }
             }
 
+            const auto  supported      = m_physical_device.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan12Features>();
+            const auto &supported_v12f = supported.get<vk::PhysicalDeviceVulkan12Features>();
+
             vk::PhysicalDeviceFeatures2        f2{};
             vk::PhysicalDeviceVulkan11Features v11f{};
             vk::PhysicalDeviceVulkan12Features v12f{};
@@ -182,6 +216,84 @@ namespace vke {
             v11f.pNext = &v12f;
             v12f.pNext = &v13f;
 
+            // everything the bindless descriptor heap needs
+            m_features.descriptor_indexing = supported_v12f.descriptorIndexing && supported_v12f.runtimeDescriptorArray && supported_v12f.descriptorBindingPartiallyBound &&
+                supported_v12f.descriptorBindingUpdateUnusedWhilePending && supported_v12f.descriptorBindingStorageBufferUpdateAfterBind &&
+                supported_v12f.descriptorBindingSampledImageUpdateAfterBind && supported_v12f.shaderStorageBufferArrayNonUniformIndexing &&
+                supported_v12f.shaderSampledImageArrayNonUniformIndexing;
+            if (m_features.descriptor_indexing) {
+                v12f.descriptorIndexing                            = true;
+                v12f.runtimeDescriptorArray                        = true;
+                v12f.descriptorBindingPartiallyBound               = true;
+                v12f.descriptorBindingUpdateUnusedWhilePending     = true;
+                v12f.descriptorBindingStorageBufferUpdateAfterBind = true;
+                v12f.descriptorBindingSampledImageUpdateAfterBind  = true;
+                v12f.shaderStorageBufferArrayNonUniformIndexing    = true;
+                v12f.shaderSampledImageArrayNonUniformIndexing     = true;
+            }
+
+            vk::PhysicalDeviceMemoryPriorityFeaturesEXT memory_priority_features{};
+            if (vma_extension_support.memory_priority) {
+                memory_priority_features.memoryPriority = true;
+                memory_priority_features.pNext          = f2.pNext;
+                f2.pNext                                = &memory_priority_features;
+            }
+            m_features.memory_priority = vma_extension_support.memory_priority;
+
+            // only the extended dynamic state 3 features ActiveRenderer has setters for
+            vk::PhysicalDeviceExtendedDynamicState3FeaturesEXT eds3_features{};
+            if (extended_dynamic_state3) {
+                const auto  chain = m_physical_device.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceExtendedDynamicState3FeaturesEXT>();
+                const auto &eds3  = chain.get<vk::PhysicalDeviceExtendedDynamicState3FeaturesEXT>();
+
+                m_features.dynamic_polygon_mode = eds3.extendedDynamicState3PolygonMode;
+                m_features.dynamic_depth_clamp  = eds3.extendedDynamicState3DepthClampEnable;
+                m_features.dynamic_color_blend  = eds3.extendedDynamicState3ColorBlendEnable && eds3.extendedDynamicState3ColorBlendEquation &&
+                    eds3.extendedDynamicState3ColorWriteMask;
+
+                eds3_features.extendedDynamicState3PolygonMode        = m_features.dynamic_polygon_mode;
+                eds3_features.extendedDynamicState3DepthClampEnable   = m_features.dynamic_depth_clamp;
+                eds3_features.extendedDynamicState3ColorBlendEnable   = m_features.dynamic_color_blend;
+                eds3_features.extendedDynamicState3ColorBlendEquation = m_features.dynamic_color_blend;
+                eds3_features.extendedDynamicState3ColorWriteMask     = m_features.dynamic_color_blend;
+                eds3_features.pNext                                   = f2.pNext;
+                f2.pNext                                              = &eds3_features;
+            }
+
+            vk::PhysicalDeviceGraphicsPipelineLibraryFeaturesEXT gpl_features{};
+            if (graphics_pipeline_library) {
+                const auto chain = m_physical_device.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceGraphicsPipelineLibraryFeaturesEXT>();
+                m_features.graphics_pipeline_library = chain.get<vk::PhysicalDeviceGraphicsPipelineLibraryFeaturesEXT>().graphicsPipelineLibrary;
+
+                gpl_features.graphicsPipelineLibrary = m_features.graphics_pipeline_library;
+                gpl_features.pNext                   = f2.pNext;
+                f2.pNext                             = &gpl_features;
+            }
+
+            vk::PhysicalDeviceShaderObjectFeaturesEXT shader_object_features{};
+            if (shader_object) {
+                const auto chain         = m_physical_device.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceShaderObjectFeaturesEXT>();
+                m_features.shader_object = chain.get<vk::PhysicalDeviceShaderObjectFeaturesEXT>().shaderObject;
+
+                shader_object_features.shaderObject = m_features.shader_object;
+                shader_object_features.pNext        = f2.pNext;
+                f2.pNext                            = &shader_object_features;
+            }
+
+            // only task and mesh shaders themselves, the multiview and shading rate parts aren't used
+            vk::PhysicalDeviceMeshShaderFeaturesEXT mesh_shader_features{};
+            if (mesh_shader) {
+                const auto  chain = m_physical_device.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceMeshShaderFeaturesEXT>();
+                const auto &mesh  = chain.get<vk::PhysicalDeviceMeshShaderFeaturesEXT>();
+
+                m_features.mesh_shader = mesh.taskShader && mesh.meshShader;
+
+                mesh_shader_features.taskShader = m_features.mesh_shader;
+                mesh_shader_features.meshShader = m_features.mesh_shader;
+                mesh_shader_features.pNext      = f2.pNext;
+                f2.pNext                        = &mesh_shader_features;
+            }
+
             m_device = m_physical_device.createDevice(vk::DeviceCreateInfo({}, queue_create_infos, {}, device_extensions, nullptr, &f2));
             VULKAN_HPP_DEFAULT_DISPATCHER.init(m_device);
         }
@@ -211,11 +323,15 @@ namespace vke {
             vmaCreateAllocator(&allocator_create_info, &m_allocator);
         }
 
+        m_memory_budget = std::make_unique<MemoryBudget>(m_allocator);
+
         m_queues.graphics = m_device.getQueue(m_queue_families.graphics, 0);
         m_queues.present  = m_device.getQueue(m_queue_families.present, 0);
         m_queues.transfer = m_device.getQueue(m_queue_families.transfer, 0);
         m_queues.compute  = m_device.getQueue(m_queue_families.compute, 0);
 
+        m_defragmenter = std::make_unique<Defragmenter>(*this);
+
         spdlog::info("Vulkan init complete");
 
         m_image_available_semaphores.resize(MAX_FRAMES_IN_FLIGHT);
@@ -232,11 +348,16 @@ namespace vke {
         m_graphics_pool = m_device.createCommandPool(vk::CommandPoolCreateInfo(vk::CommandPoolCreateFlagBits::eResetCommandBuffer, m_queue_families.graphics));
         m_transfer_pool = m_device.createCommandPool(vk::CommandPoolCreateInfo(vk::CommandPoolCreateFlagBits::eResetCommandBuffer, m_queue_families.transfer));
         m_compute_pool  = m_device.createCommandPool(vk::CommandPoolCreateInfo(vk::CommandPoolCreateFlagBits::eResetCommandBuffer, m_queue_families.compute));
+
+        m_acquire_command_buffers = create_graphics_command_buffers(MAX_FRAMES_IN_FLIGHT);
     }
 
     RenderContext::~RenderContext() {
         m_device.waitIdle();
 
+        m_defragmenter.reset();
+        run_deferred_destructions(true);
+
         m_device.destroy(m_graphics_pool);
         m_device.destroy(m_transfer_pool);
         m_device.destroy(m_compute_pool);
@@ -254,6 +375,11 @@ namespace vke {
 
         m_device.destroy(m_swapchain);
 
+        for (const auto &pool : m_priority_pools | std::views::values) {
+            vmaDestroyPool(m_allocator, pool);
+        }
+
+        m_memory_budget.reset();
         vmaDestroyAllocator(m_allocator);
         m_device.destroy();
         m_instance.destroy(m_surface);
@@ -358,7 +484,7 @@ namespace vke {
         m_swapchain_reloaded = true;
     }
 
-    void RenderContext::render_frame(GLFWwindow *window, const std::function<void(const FrameInfo &info)> &f) {
+    void RenderContext::render_frame(GLFWwindow *window, const function_ref<void(const FrameInfo &info)> f) {
         m_frame_info.current_frame   = m_current_frame;
         m_frame_info.in_flight       = m_in_flight_fences[m_current_frame];
         m_frame_info.image_available = m_image_available_semaphores[m_current_frame];
@@ -369,6 +495,14 @@ namespace vke {
                 "something bad"); // something bad happened probably because the only options here should be success or timeout, and if we timeout on 2^64 thats worrying.
         }
 
+        // advancing the frame index lets vma refresh its budget from VK_EXT_memory_budget
+        vmaSetCurrentFrameIndex(m_allocator, static_cast<uint32_t>(++m_frame_number));
+        m_memory_budget->poll();
+
+        m_frame_arena.reset();
+        run_deferred_destructions(false);
+        m_defragmenter->update();
+
         try {
             auto r = m_device.acquireNextImageKHR(m_swapchain, UINT64_MAX, m_frame_info.image_available);
             if (r.result != vk::Result::eSuccess) {
@@ -432,9 +566,55 @@ namespace vke {
         cmd.pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::PipelineStageFlagBits::eBottomOfPipe, {}, {}, {}, imb);
     }
 
-    void RenderContext::submit_for_rendering(vk::CommandBuffer cmd, const FrameInfo &frame_info) const {
-        constexpr vk::PipelineStageFlags dst_stage = vk::PipelineStageFlagBits::eTopOfPipe;
-        m_queues.graphics.submit(vk::SubmitInfo(frame_info.image_available, dst_stage, cmd, frame_info.render_finished), frame_info.in_flight);
+    void RenderContext::submit_for_rendering(const vk::CommandBuffer cmd, const FrameInfo &frame_info) {
+        submit_for_rendering(cmd, frame_info, {});
+    }
+
+    void RenderContext::submit_for_rendering(const vk::CommandBuffer cmd, const FrameInfo &frame_info, const std::span<const SemaphoreWait> extra_waits) {
+        const std::span<vk::Semaphore>          wait_semaphores = m_frame_arena.allocate_array<vk::Semaphore>(extra_waits.size() + 1);
+        const std::span<vk::PipelineStageFlags> wait_stages     = m_frame_arena.allocate_array<vk::PipelineStageFlags>(extra_waits.size() + 1);
+
+        wait_semaphores[0] = frame_info.image_available;
+        wait_stages[0]     = vk::PipelineStageFlagBits::eTopOfPipe;
+        for (size_t i = 0; i < extra_waits.size(); i++) {
+            wait_semaphores[i + 1] = extra_waits[i].semaphore;
+            wait_stages[i + 1]     = extra_waits[i].stages;
+        }
+
+        // this frame's fence was waited on in render_frame, so its acquire command buffer is free to reuse
+        const vk::CommandBuffer acquire_cmd = m_acquire_command_buffers[frame_info.current_frame];
+        acquire_cmd.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+        const bool has_acquires = record_ownership_acquires(acquire_cmd);
+        acquire_cmd.end();
+
+        if (has_acquires) {
+            const std::array cmds = {acquire_cmd, cmd};
+            m_queues.graphics.submit(vk::SubmitInfo(wait_semaphores, wait_stages, cmds, frame_info.render_finished), frame_info.in_flight);
+        } else {
+            m_queues.graphics.submit(vk::SubmitInfo(wait_semaphores, wait_stages, cmd, frame_info.render_finished), frame_info.in_flight);
+        }
+    }
+
+    void RenderContext::enqueue_ownership_acquire(const vk::BufferMemoryBarrier &barrier, const vk::PipelineStageFlags dst_stages) {
+        std::lock_guard lock(m_acquire_mutex);
+        m_pending_acquires.push_back(barrier);
+        m_pending_acquire_stages |= dst_stages;
+    }
+
+    bool RenderContext::record_ownership_acquires(const vk::CommandBuffer cmd) {
+        vk::PipelineStageFlags dst_stages;
+        {
+            std::lock_guard lock(m_acquire_mutex);
+            m_recording_acquires.swap(m_pending_acquires);
+            dst_stages = std::exchange(m_pending_acquire_stages, {});
+        }
+
+        if (m_recording_acquires.empty())
+            return false;
+
+        cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, dst_stages, {}, {}, m_recording_acquires, {});
+        m_recording_acquires.clear();
+        return true;
     }
 
     vk::Rect2D RenderContext::swapchain_area() const {
@@ -482,7 +662,7 @@ namespace vke {
         return VK_FALSE;
     }
 
-    void record_single_use_commands(const vk::CommandBuffer &cmd, const std::function<void(const vk::CommandBuffer &)> &f, const bool reset) {
+    void record_single_use_commands(const vk::CommandBuffer &cmd, const function_ref<void(const vk::CommandBuffer &)> f, const bool reset) {
         if (reset)
             cmd.reset();
         cmd.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
@@ -491,25 +671,13 @@ namespace vke {
     }
 
     vk::ShaderModule RenderContext::load_shader_module(const std::filesystem::path &path, const SourceType source_type) const {
-        switch (source_type) {
-        case SourceType::GLSL: {
-            std::ifstream f(path, std::ios::in | std::ios::ate);
-            if (!f.is_open()) {
-                throw std::runtime_error("Failed to open file '" + path.string() + "'.");
-            }
-
-            const auto size = f.tellg();
-            const auto buf  = new char[size];
-            std::memset(buf, 0, size);
-            f.seekg(0, std::ios::beg);
-            f.read(buf, size);
-            f.close();
-
-            const std::string text = buf;
-            delete[] buf;
+        return load_spirv_shader(load_shader_code(path, source_type));
+    }
 
-            return compile_glsl_shader(text, path.string());
-        }
+    std::vector<uint32_t> RenderContext::load_shader_code(const std::filesystem::path &path, const SourceType source_type, const ShaderCompileOptions &options) const {
+        switch (source_type) {
+        case SourceType::GLSL:
+            return compile_glsl_to_spirv(read_text_file(path), path.string(), options);
         case SourceType::SPIRV: {
             std::ifstream f(path, std::ios::in | std::ios::ate | std::ios::binary);
             if (!f.is_open()) {
@@ -522,28 +690,19 @@ namespace vke {
             f.read(reinterpret_cast<char *>(code.data()), static_cast<std::streamsize>(size * sizeof(uint32_t)));
             f.close();
 
-            return load_spirv_shader(code);
+            return code;
         }
         default:
             throw std::runtime_error("Unknown source type.");
         }
     }
 
-    vk::ShaderModule RenderContext::compile_glsl_shader(const std::string &source, const std::string &filename) const {
-        const shaderc::Compiler       compiler;
-        const shaderc::CompileOptions options;
-
-        const auto result = compiler.CompileGlslToSpv(source, shaderc_glsl_infer_from_source, filename.c_str(), options);
-        if (result.GetCompilationStatus() != shaderc_compilation_status_success) {
-            spdlog::critical("Failed to compiler shader: {}", result.GetErrorMessage());
-            throw std::runtime_error("Failed to compile shader.");
-        }
-
-        return load_spirv_shader(std::vector(result.cbegin(), result.cend()));
+    vk::ShaderModule RenderContext::compile_glsl_shader(const std::string &source, const std::string &filename, const ShaderCompileOptions &options) const {
+        return load_spirv_shader(compile_glsl_to_spirv(source, filename, options));
     }
 
-    vk::ShaderModule RenderContext::load_spirv_shader(const std::vector<uint32_t> &code) const {
-        return m_device.createShaderModule(vk::ShaderModuleCreateInfo({}, code));
+    vk::ShaderModule RenderContext::load_spirv_shader(const std::span<const uint32_t> code) const {
+        return m_device.createShaderModule(vk::ShaderModuleCreateInfo({}, code.size_bytes(), code.data()));
     }
 
     BufferInfo RenderContext::create_buffer(const size_t size, const void *data, // NOLINT(*-no-recursion)
@@ -586,12 +745,28 @@ namespace vke {
         VmaAllocation            allocation;
         VmaAllocationInfo        allocation_info;
 
+        if (options.persistently_mapped) {
+            aci.flags |= VMA_ALLOCATION_CREATE_MAPPED_BIT;
+        }
+
+        const float priority = options.priority.value_or(residency_priority(options.residency));
+        aci.priority         = priority;
+
+        if (options.dedicated == DedicatedAllocation::Always || (options.dedicated == DedicatedAllocation::Auto && size >= options.dedicated_threshold)) {
+            aci.flags |= VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
+        } else if (m_features.memory_priority && priority != residency_priority(ResidencyClass::Streaming)) {
+            // without VK_EXT_memory_priority vma ignores the priority, so separate pools would only fragment memory
+            aci.pool = priority_pool(bci, aci, priority);
+        }
+
         vmaCreateBuffer(m_allocator, &bci, &aci, &buffer, &allocation, &allocation_info);
+        m_memory_budget->track_allocation(options.category, allocation_info.size);
 
         if (data != nullptr) {
             if (memory_usage == MemoryUsage::DeviceOnly) {
                 // needs to stage the data so this is a bit weirder
-                const auto staging = create_buffer(size, data, MemoryUsage::Auto, vk::BufferUsageFlagBits::eTransferSrc, {.access_mode = MemoryAccessMode::Sequential});
+                const auto staging = create_buffer(size, data, MemoryUsage::Auto, vk::BufferUsageFlagBits::eTransferSrc,
+                                                   {.access_mode = MemoryAccessMode::Sequential, .category = AllocationCategory::Staging});
                 copy_buffer_to_buffer(staging.buffer, buffer, size, 0);
                 destroy_buffer(staging);
             } else {
@@ -599,10 +774,15 @@ namespace vke {
             }
         }
 
-        return {buffer, allocation, allocation_info};
+        vk::DeviceAddress address = 0;
+        if (buffer_ci.usage & vk::BufferUsageFlagBits::eShaderDeviceAddress) {
+            address = m_device.getBufferAddress(vk::BufferDeviceAddressInfo(buffer));
+        }
+
+        return {buffer, allocation, allocation_info, options.category, size, buffer_ci.usage, address};
     }
 
-    void RenderContext::run_transfer_commands_and_wait(const std::function<void(const vk::CommandBuffer &cmd)> &f) const {
+    void RenderContext::run_transfer_commands_and_wait(const function_ref<void(const vk::CommandBuffer &cmd)> f) const {
         const vk::Fence         fence = m_device.createFence({});
         const vk::CommandBuffer cmd   = m_device.allocateCommandBuffers(vk::CommandBufferAllocateInfo(m_transfer_pool, vk::CommandBufferLevel::ePrimary, 1))[0];
         record_single_use_commands(cmd, f);
@@ -614,7 +794,7 @@ namespace vke {
         m_device.freeCommandBuffers(m_transfer_pool, cmd);
     }
 
-    void RenderContext::run_graphics_commands_and_wait(const std::function<void(const vk::CommandBuffer &cmd)> &f) const {
+    void RenderContext::run_graphics_commands_and_wait(const function_ref<void(const vk::CommandBuffer &cmd)> f) const {
         const vk::Fence         fence = m_device.createFence({});
         const vk::CommandBuffer cmd   = m_device.allocateCommandBuffers(vk::CommandBufferAllocateInfo(m_graphics_pool, vk::CommandBufferLevel::ePrimary, 1))[0];
         record_single_use_commands(cmd, f);
@@ -626,7 +806,7 @@ namespace vke {
         m_device.freeCommandBuffers(m_graphics_pool, cmd);
     }
 
-    void RenderContext::run_compute_commands_and_wait(const std::function<void(const vk::CommandBuffer &cmd)> &f) const {
+    void RenderContext::run_compute_commands_and_wait(const function_ref<void(const vk::CommandBuffer &cmd)> f) const {
         const vk::Fence         fence = m_device.createFence({});
         const vk::CommandBuffer cmd   = m_device.allocateCommandBuffers(vk::CommandBufferAllocateInfo(m_compute_pool, vk::CommandBufferLevel::ePrimary, 1))[0];
         record_single_use_commands(cmd, f);
@@ -649,9 +829,83 @@ namespace vke {
     }
 
     void RenderContext::destroy_buffer(const BufferInfo &info) const {
+        m_memory_budget->track_free(info.category, info.allocation_info.size);
+        if (m_defragmenter->release(info))
+            return;
+
         vmaDestroyBuffer(m_allocator, info.buffer, info.allocation);
     }
 
+    void RenderContext::defer_destruction(std::function<void()> f) {
+        std::lock_guard lock(m_deferred_destruction_mutex);
+        m_deferred_destructions.emplace_back(m_frame_number.load(std::memory_order_relaxed) + MAX_FRAMES_IN_FLIGHT, std::move(f));
+    }
+
+    void RenderContext::run_deferred_destructions(const bool all) {
+        std::vector<std::function<void()>> ready;
+        {
+            std::lock_guard lock(m_deferred_destruction_mutex);
+            const uint64_t  frame = m_frame_number.load(std::memory_order_relaxed);
+            while (!m_deferred_destructions.empty() && (all || m_deferred_destructions.front().first <= frame)) {
+                ready.push_back(std::move(m_deferred_destructions.front().second));
+                m_deferred_destructions.pop_front();
+            }
+        }
+
+        // run outside of the lock since destroying things may queue up more destruction
+        for (const auto &f : ready) {
+            f();
+        }
+    }
+
+    std::vector<VmaPool> RenderContext::memory_pools() const {
+        std::lock_guard lock(m_pool_mutex);
+
+        std::vector<VmaPool> pools;
+        pools.reserve(m_priority_pools.size());
+        for (const auto &pool : m_priority_pools | std::views::values) {
+            pools.push_back(pool);
+        }
+
+        return pools;
+    }
+
+    VmaPool RenderContext::priority_pool(const VkBufferCreateInfo &buffer_ci, const VmaAllocationCreateInfo &aci, const float priority) {
+        uint32_t memory_type;
+        if (vmaFindMemoryTypeIndexForBufferInfo(m_allocator, &buffer_ci, &aci, &memory_type) != VK_SUCCESS) {
+            return VK_NULL_HANDLE; // let the allocation fall back to the default pools
+        }
+
+        std::lock_guard lock(m_pool_mutex);
+        if (const auto it = m_priority_pools.find({memory_type, priority}); it != m_priority_pools.end()) {
+            return it->second;
+        }
+
+        VmaPoolCreateInfo pool_ci{};
+        pool_ci.memoryTypeIndex = memory_type;
+        pool_ci.priority        = priority;
+
+        VmaPool pool;
+        if (vmaCreatePool(m_allocator, &pool_ci, &pool) != VK_SUCCESS) {
+            return VK_NULL_HANDLE;
+        }
+
+        m_priority_pools.emplace(std::make_pair(memory_type, priority), pool);
+        return pool;
+    }
+
+    std::vector<uint32_t> RenderContext::graphics_transfer_queue_families() const {
+        if (m_queue_families.graphics == m_queue_families.transfer)
+            return {};
+        return {m_queue_families.graphics, m_queue_families.transfer};
+    }
+
+    std::vector<uint32_t> RenderContext::graphics_compute_queue_families() const {
+        if (m_queue_families.graphics == m_queue_families.compute)
+            return {};
+        return {m_queue_families.graphics, m_queue_families.compute};
+    }
+
     void RenderContext::write_to_memory(const VmaAllocation allocation, const size_t size, const void *const data, const ptrdiff_t dst_offset) const {
         write_to_memory(allocation, size, data, 0, dst_offset);
     }
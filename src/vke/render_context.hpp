@@ -5,14 +5,25 @@
 #include <GLFW/glfw3.h>
 #include <filesystem>
 #include <glm/glm.hpp>
-#include <shaderc/shaderc.hpp>
 #include <vk_mem_alloc.h>
 
 #include <ranges>
 
+#include <deque>
 #include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <span>
+
+#include "vke/frame_arena.hpp"
+#include "vke/memory_budget.hpp"
+#include "vke/shader_compiler.hpp"
+#include "vke/util.hpp"
 
 namespace vke {
+    class Defragmenter;
+
     enum class SourceType {
         SPIRV,
         GLSL,
@@ -26,6 +37,21 @@ namespace vke {
         uint32_t graphics, present, transfer, compute;
     };
 
+    // optional device features, detected and enabled when the device is created
+    struct DeviceFeatures {
+        bool descriptor_indexing = false; // everything needed by DescriptorHeap
+        bool memory_priority     = false;
+
+        // VK_EXT_extended_dynamic_state3, for the states ActiveRenderer can set. extended dynamic state 1 and 2 are core in 1.3.
+        bool dynamic_polygon_mode = false;
+        bool dynamic_depth_clamp  = false;
+        bool dynamic_color_blend  = false; // blend enable, equation and write mask
+
+        bool graphics_pipeline_library = false; // see GraphicsPipelineLinker
+        bool shader_object             = false; // see ShaderObject and ActiveRenderer::bind_shaders
+        bool mesh_shader               = false; // task and mesh shaders (VK_EXT_mesh_shader), see ActiveRenderer::draw_meshlets
+    };
+
     struct SwapchainConfiguration {
         vk::Format        format;
         vk::ColorSpaceKHR color_space;
@@ -44,6 +70,12 @@ namespace vke {
         bool          swapchain_reloaded;
     };
 
+    // an extra semaphore for a submission to wait on, and the stages which wait for it
+    struct SemaphoreWait {
+        vk::Semaphore          semaphore;
+        vk::PipelineStageFlags stages;
+    };
+
     enum class MemoryUsage {
         DeviceOnly,
         Auto,
@@ -51,18 +83,57 @@ namespace vke {
 
     enum class MemoryAccessMode { Sequential, Random, None, Auto };
 
+    // decides which memory the driver evicts first when device memory is oversubscribed (needs VK_EXT_memory_priority, otherwise this does nothing)
+    enum class ResidencyClass {
+        RenderCritical, // needed to draw every frame, evicted last
+        Streaming,      // can be streamed back in if evicted. this is vma's default priority so these share the default pools
+        Background,     // evicted first
+    };
+
+    enum class DedicatedAllocation {
+        Auto,               // dedicated when at least BufferOptions::dedicated_threshold bytes (vma may still decide to use dedicated memory for smaller buffers)
+        Always,
+        PreferSuballocated, // never forced dedicated, even when large (vma will still use dedicated memory when the driver requires it)
+    };
+
+    [[nodiscard]] constexpr float residency_priority(const ResidencyClass residency) {
+        switch (residency) {
+        case ResidencyClass::RenderCritical:
+            return 1.0f;
+        case ResidencyClass::Background:
+            return 0.0f;
+        case ResidencyClass::Streaming:
+        default:
+            return 0.5f;
+        }
+    }
+
     struct BufferOptions {
         vk::BufferCreateFlags flags;
         // leave empty for exclusive sharing mode
         std::vector<uint32_t> queue_families;
 
-        MemoryAccessMode access_mode = MemoryAccessMode::Auto;
+        MemoryAccessMode   access_mode = MemoryAccessMode::Auto;
+        AllocationCategory category    = AllocationCategory::Other;
+
+        ResidencyClass       residency = ResidencyClass::Streaming;
+        std::optional<float> priority; // overrides the priority of the residency class (0-1)
+
+        DedicatedAllocation dedicated           = DedicatedAllocation::Auto;
+        vk::DeviceSize      dedicated_threshold = 32ull * 1024 * 1024;
+
+        // keep host visible memory mapped for the lifetime of the buffer (BufferInfo::allocation_info.pMappedData)
+        bool persistently_mapped = false;
     };
 
     struct BufferInfo {
-        vk::Buffer buffer;
-        VmaAllocation allocation;
-        VmaAllocationInfo allocation_info;
+        vk::Buffer           buffer;
+        VmaAllocation        allocation;
+        VmaAllocationInfo    allocation_info;
+        AllocationCategory   category = AllocationCategory::Other;
+        vk::DeviceSize       size     = 0;
+        vk::BufferUsageFlags usage;
+        vk::DeviceAddress    address = 0; // only set for buffers with SHADER_DEVICE_ADDRESS usage
     };
 
     class RenderContext {
@@ -75,7 +146,7 @@ namespace vke {
 
         void configure_swapchain(GLFWwindow *window);
 
-        void render_frame(GLFWwindow *window, const std::function<void(const FrameInfo &info)> &f);
+        void render_frame(GLFWwindow *window, function_ref<void(const FrameInfo &info)> f);
 
         [[nodiscard]] std::vector<vk::CommandBuffer> create_graphics_command_buffers(uint32_t count) const;
 
@@ -89,10 +160,31 @@ namespace vke {
 
         [[nodiscard]] QueueSet queues() const { return m_queues; }
 
+        [[nodiscard]] const DeviceFeatures &features() const { return m_features; }
+
         [[nodiscard]] QueueFamilies queue_families() const { return m_queue_families; }
 
         [[nodiscard]] VmaAllocator allocator() const { return m_allocator; }
 
+        [[nodiscard]] MemoryBudget &memory_budget() const { return *m_memory_budget; }
+
+        [[nodiscard]] Defragmenter &defragmenter() const { return *m_defragmenter; }
+
+        // transient cpu memory for the frame being recorded, reset at the start of every render_frame
+        [[nodiscard]] FrameArena &frame_arena() { return m_frame_arena; }
+
+        // incremented every time render_frame starts a new frame
+        [[nodiscard]] uint64_t frame_number() const { return m_frame_number.load(std::memory_order_relaxed); }
+
+        // custom pools backing residency classes which don't use vma's default priority
+        [[nodiscard]] std::vector<VmaPool> memory_pools() const;
+
+        // leave a buffer shared between these families if it is going to be touched by both the transfer and graphics queues (ie. anything the defragmenter may move)
+        [[nodiscard]] std::vector<uint32_t> graphics_transfer_queue_families() const;
+
+        // same idea for resources written by async compute and read by graphics (or the other way around)
+        [[nodiscard]] std::vector<uint32_t> graphics_compute_queue_families() const;
+
         [[nodiscard]] SwapchainConfiguration swapchain_configuration() const { return m_swapchain_configuration; }
 
         [[nodiscard]] vk::SwapchainKHR swapchain() const { return m_swapchain; }
@@ -119,14 +211,31 @@ namespace vke {
          * @param cmd The command buffer being submitted
          * @param frame_info The frame info for the frame being rendered
          */
-        void submit_for_rendering(vk::CommandBuffer cmd, const FrameInfo &frame_info) const;
+        void submit_for_rendering(vk::CommandBuffer cmd, const FrameInfo &frame_info);
+
+        // same as above, but the submission also waits on extra_waits (ie. AsyncComputeScheduler's semaphore)
+        void submit_for_rendering(vk::CommandBuffer cmd, const FrameInfo &frame_info, std::span<const SemaphoreWait> extra_waits);
+
+        /**
+         * @brief Queues the graphics side of a queue family ownership transfer, to be recorded ahead of the next frame's commands.
+         *
+         * The matching release must have finished executing on the other queue (ie. its fence has signaled) before the frame is submitted. submit_for_rendering records pending
+         * acquires in a command buffer submitted ahead of the frame's, frames which are submitted some other way have to call record_ownership_acquires themselves. This is thread
+         * safe.
+         */
+        void enqueue_ownership_acquire(const vk::BufferMemoryBarrier &barrier, vk::PipelineStageFlags dst_stages);
+
+        // records every pending acquire as a single barrier. returns false if there was nothing to record.
+        bool record_ownership_acquires(vk::CommandBuffer cmd);
 
         [[nodiscard]] vk::Rect2D   swapchain_area() const;
         [[nodiscard]] vk::Viewport swapchain_viewport(float min_depth = 0.0f, float max_depth = 1.0f) const;
 
         [[nodiscard]] vk::ShaderModule load_shader_module(const std::filesystem::path &path, SourceType source_type) const;
-        [[nodiscard]] vk::ShaderModule compile_glsl_shader(const std::string &source, const std::string &filename) const;
-        [[nodiscard]] vk::ShaderModule load_spirv_shader(const std::vector<uint32_t> &code) const;
+        // spirv for a shader file, compiled first if it's glsl (options are ignored for spirv). see ShaderObject for the pipeline-free path.
+        [[nodiscard]] std::vector<uint32_t> load_shader_code(const std::filesystem::path &path, SourceType source_type, const ShaderCompileOptions &options = {}) const;
+        [[nodiscard]] vk::ShaderModule compile_glsl_shader(const std::string &source, const std::string &filename, const ShaderCompileOptions &options = {}) const;
+        [[nodiscard]] vk::ShaderModule load_spirv_shader(std::span<const uint32_t> code) const;
 
         BufferInfo create_buffer(size_t size, const void *data, MemoryUsage memory_usage, vk::BufferUsageFlags usage,
                                                                                const BufferOptions &options = {});
@@ -137,15 +246,22 @@ namespace vke {
             return create_buffer(std::ranges::size(range) * sizeof(std::ranges::range_value_t<Range>), std::ranges::data(range), memory_usage, usage, options);
         };
 
-        void run_transfer_commands_and_wait(const std::function<void(const vk::CommandBuffer &cmd)> &f) const;
-        void run_graphics_commands_and_wait(const std::function<void(const vk::CommandBuffer &cmd)> &f) const;
-        void run_compute_commands_and_wait(const std::function<void(const vk::CommandBuffer &cmd)> &f) const;
+        void run_transfer_commands_and_wait(function_ref<void(const vk::CommandBuffer &cmd)> f) const;
+        void run_graphics_commands_and_wait(function_ref<void(const vk::CommandBuffer &cmd)> f) const;
+        void run_compute_commands_and_wait(function_ref<void(const vk::CommandBuffer &cmd)> f) const;
 
         void copy_buffer_to_buffer(vk::Buffer from, vk::Buffer to, vk::DeviceSize size, vk::DeviceSize dst_offset = 0) const;
         void copy_buffer_to_buffer(vk::Buffer from, vk::Buffer to, vk::DeviceSize size, vk::DeviceSize src_offset, vk::DeviceSize dst_offset) const;
 
         void destroy_buffer(const BufferInfo &info) const;
 
+        /**
+         * @brief Runs f once every frame which could currently be in flight has finished on the gpu.
+         *
+         * Use this to destroy resources which may still be referenced by submitted command buffers without waiting for the device to go idle. This is thread safe.
+         */
+        void defer_destruction(std::function<void()> f);
+
         void write_to_memory(VmaAllocation allocation, size_t size, const void *data, ptrdiff_t dst_offset = 0) const;
         void write_to_memory(VmaAllocation allocation, size_t size, const void *data, ptrdiff_t src_offset, ptrdiff_t dst_offset) const;
 
@@ -157,8 +273,18 @@ namespace vke {
         vk::Device                 m_device;
         QueueSet                   m_queues;
         QueueFamilies              m_queue_families;
+        DeviceFeatures             m_features;
         VmaAllocator               m_allocator;
 
+        std::unique_ptr<MemoryBudget> m_memory_budget;
+        std::unique_ptr<Defragmenter> m_defragmenter;
+
+        FrameArena m_frame_arena;
+
+        // vma only applies a priority when creating a VkDeviceMemory, so suballocations of different priorities need their own pools (keyed by memory type and priority)
+        mutable std::mutex                            m_pool_mutex;
+        std::map<std::pair<uint32_t, float>, VmaPool> m_priority_pools;
+
         SwapchainConfiguration m_swapchain_configuration;
         FrameInfo              m_frame_info;
 
@@ -176,9 +302,24 @@ namespace vke {
         vk::CommandPool m_transfer_pool;
         vk::CommandPool m_compute_pool;
 
+        std::mutex                           m_acquire_mutex;
+        std::vector<vk::BufferMemoryBarrier> m_pending_acquires;
+        std::vector<vk::BufferMemoryBarrier> m_recording_acquires; // swapped with m_pending_acquires while recording, so neither loses its capacity
+        vk::PipelineStageFlags               m_pending_acquire_stages;
+        std::vector<vk::CommandBuffer>       m_acquire_command_buffers;
+
         uint32_t m_current_frame      = 0;
         bool     m_swapchain_reloaded = false;
 
+        std::atomic<uint64_t> m_frame_number = 0;
+
+        std::mutex                                             m_deferred_destruction_mutex;
+        std::deque<std::pair<uint64_t, std::function<void()>>> m_deferred_destructions;
+
+        void run_deferred_destructions(bool all);
+
+        VmaPool priority_pool(const VkBufferCreateInfo &buffer_ci, const VmaAllocationCreateInfo &aci, float priority);
+
         static void setup_validation_logger();
 
         static VkBool32 VKAPI_CALL validation_callback(VkDebugUtilsMessageSeverityFlagBitsEXT severity, VkDebugUtilsMessageTypeFlagsEXT message_type,
@@ -194,5 +335,5 @@ namespace vke {
      * @param f
      * @param reset whether to reset the command buffer before recording or not.
      */
-    void record_single_use_commands(const vk::CommandBuffer &cmd, const std::function<void(const vk::CommandBuffer &)> &f, const bool reset = false);
+    void record_single_use_commands(const vk::CommandBuffer &cmd, function_ref<void(const vk::CommandBuffer &)> f, const bool reset = false);
 } // namespace vke
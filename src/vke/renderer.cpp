@@ -1,130 +1,322 @@
 #include "renderer.hpp"
 
+#include <algorithm>
+#include <cstring>
+#include <memory_resource>
+
+#include "vke/shader_object.hpp"
+
 namespace vke {
-    GraphicsPipeline::GraphicsPipeline(vk::Device device, const GraphicsPipelineBuilder &builder, vk::PipelineCache cache) : m_device(device) {
+    static constexpr vk::GraphicsPipelineLibraryFlagsEXT ALL_PIPELINE_PARTS =
+        vk::GraphicsPipelineLibraryFlagBitsEXT::eVertexInputInterface | vk::GraphicsPipelineLibraryFlagBitsEXT::ePreRasterizationShaders |
+        vk::GraphicsPipelineLibraryFlagBitsEXT::eFragmentShader | vk::GraphicsPipelineLibraryFlagBitsEXT::eFragmentOutputInterface;
+
+    // every create info for a builder (or the parts of it needed by a pipeline library). the create infos point into each other, so this can't move.
+    struct GraphicsPipelineCreateState {
         vk::GraphicsPipelineCreateInfo create_info{};
 
-        std::vector<vk::PipelineShaderStageCreateInfo> stages;
-        stages.reserve(builder.stages.size());
-        for (const auto &[stage, entry_point, module] : builder.stages) {
-            stages.emplace_back(vk::PipelineShaderStageCreateFlags{}, stage, module, entry_point.c_str());
-        }
-        create_info.setStages(stages);
+        std::vector<vk::PipelineShaderStageCreateInfo>     stages;
+        std::vector<vk::SpecializationInfo>                specializations;
+        std::vector<vk::DynamicState>                      dynamic_states;
+        vk::PipelineDynamicStateCreateInfo                 dynamic_state{};
+        vk::PipelineVertexInputStateCreateInfo             vertex_input_state{};
+        std::vector<vk::VertexInputBindingDescription>     vertex_bindings;
+        std::vector<vk::VertexInputAttributeDescription>   vertex_attributes;
+        vk::PipelineInputAssemblyStateCreateInfo           input_assembly{};
+        vk::PipelineViewportStateCreateInfo                viewport_state{};
+        vk::PipelineRasterizationStateCreateInfo           rasterization_state{};
+        vk::PipelineMultisampleStateCreateInfo             multisample_state{};
+        std::vector<vk::PipelineColorBlendAttachmentState> color_attachments;
+        vk::PipelineColorBlendStateCreateInfo              color_blend_state{};
+        vk::PipelineRenderingCreateInfo                    rendering_info{};
+        vk::GraphicsPipelineLibraryCreateInfoEXT           library_info{};
 
-        vk::PipelineDynamicStateCreateInfo dynamic_state{};
-        dynamic_state.setDynamicStates(builder.dynamic_states);
-        create_info.setPDynamicState(&dynamic_state);
+        GraphicsPipelineCreateState(const GraphicsPipelineBuilder &builder, const vk::GraphicsPipelineLibraryFlagsEXT parts) {
+            using Part = vk::GraphicsPipelineLibraryFlagBitsEXT;
 
-        vk::PipelineVertexInputStateCreateInfo           vertex_input_state{};
-        std::vector<vk::VertexInputBindingDescription>   vertex_bindings;
-        std::vector<vk::VertexInputAttributeDescription> vertex_attributes;
+            stages.reserve(builder.stages.size());
+            specializations.reserve(builder.stages.size()); // stages point into this, so it must not reallocate
+            for (const auto &[stage, entry_point, module, specialization] : builder.stages) {
+                // libraries only get the stages of their part
+                const Part stage_part = stage == vk::ShaderStageFlagBits::eFragment ? Part::eFragmentShader : Part::ePreRasterizationShaders;
+                if (!(parts & stage_part))
+                    continue;
 
-        vertex_bindings.reserve(builder.vertex_buffer_bindings.size());
-        for (const auto &[binding, stride, input_rate, attributes] : builder.vertex_buffer_bindings) {
-            vertex_bindings.emplace_back(binding, stride, input_rate);
-            for (const auto &[location, format, offset] : attributes) {
-                vertex_attributes.emplace_back(location, binding, format, offset);
+                auto &stage_ci = stages.emplace_back(vk::PipelineShaderStageCreateFlags{}, stage, module, entry_point.c_str());
+                if (!specialization.empty()) {
+                    stage_ci.setPSpecializationInfo(&specializations.emplace_back(specialization.info()));
+                }
+            }
+            create_info.setStages(stages);
+
+            // mesh shader pipelines have no vertex input or input assembly, so they can't have those states dynamic either
+            const bool mesh_shading = builder.uses_mesh_shaders();
+            dynamic_states          = builder.dynamic_states;
+            if (mesh_shading) {
+                std::erase_if(dynamic_states, [](const vk::DynamicState state) {
+                    return state == vk::DynamicState::eVertexInputEXT || state == vk::DynamicState::eVertexInputBindingStride ||
+                        state == vk::DynamicState::ePrimitiveTopology || state == vk::DynamicState::ePrimitiveRestartEnable;
+                });
+            }
+            dynamic_state.setDynamicStates(dynamic_states);
+            create_info.setPDynamicState(&dynamic_state);
+
+            if (parts & Part::eVertexInputInterface && !mesh_shading) {
+                vertex_bindings.reserve(builder.vertex_buffer_bindings.size());
+                for (const auto &[binding, stride, input_rate, attributes] : builder.vertex_buffer_bindings) {
+                    vertex_bindings.emplace_back(binding, stride, input_rate);
+                    for (const auto &[location, format, offset] : attributes) {
+                        vertex_attributes.emplace_back(location, binding, format, offset);
+                    }
+                }
+
+                vertex_input_state.setVertexBindingDescriptions(vertex_bindings);
+                vertex_input_state.setVertexAttributeDescriptions(vertex_attributes);
+                create_info.setPVertexInputState(&vertex_input_state);
+
+                input_assembly.setTopology(builder.topology);
+                input_assembly.setPrimitiveRestartEnable(builder.enable_primitive_restart);
+                create_info.setPInputAssemblyState(&input_assembly);
+            }
+
+            if (parts & Part::ePreRasterizationShaders) {
+                viewport_state.setViewports(builder.viewports);
+                viewport_state.setScissors(builder.scissors);
+                create_info.setPViewportState(&viewport_state);
+
+                rasterization_state.setDepthClampEnable(builder.enable_depth_clamp);
+                rasterization_state.setRasterizerDiscardEnable(builder.discard_rasterizer_output);
+                rasterization_state.setPolygonMode(builder.polygon_mode);
+                rasterization_state.setCullMode(builder.cull_mode);
+                rasterization_state.setFrontFace(builder.front_face);
+                rasterization_state.setLineWidth(builder.line_width);
+                rasterization_state.setDepthBiasEnable(builder.depth_bias.has_value());
+                if (builder.depth_bias.has_value()) {
+                    rasterization_state.setDepthBiasConstantFactor(builder.depth_bias->constant_factor);
+                    rasterization_state.setDepthBiasClamp(builder.depth_bias->clamp);
+                    rasterization_state.setDepthBiasSlopeFactor(builder.depth_bias->slope_factor);
+                }
+                create_info.setPRasterizationState(&rasterization_state);
+            }
+
+            if (parts & (Part::eFragmentShader | Part::eFragmentOutputInterface)) {
+                multisample_state.setSampleShadingEnable(builder.enable_sample_shading);
+                multisample_state.setRasterizationSamples(builder.rasterization_samples);
+                multisample_state.setMinSampleShading(builder.min_sample_shading);
+                multisample_state.setPSampleMask(builder.sample_mask.data());
+                multisample_state.setAlphaToCoverageEnable(builder.enable_alpha_to_coverage);
+                multisample_state.setAlphaToOneEnable(builder.enable_alpha_to_one);
+                create_info.setPMultisampleState(&multisample_state);
+            }
+
+            if (parts & Part::eFragmentOutputInterface) {
+                color_attachments.reserve(builder.color_blend_attachments.size());
+                for (const auto &[color_write_mask, enable_blending, color, alpha] : builder.color_blend_attachments) {
+                    color_attachments.emplace_back(enable_blending, color.src, color.dst, color.op, alpha.src, alpha.dst, alpha.op, color_write_mask);
+                }
+                color_blend_state.setAttachments(color_attachments);
+                color_blend_state.setLogicOpEnable(builder.logic_op.has_value());
+                color_blend_state.setLogicOp(builder.logic_op.value_or(vk::LogicOp::eCopy));
+                color_blend_state.setBlendConstants(builder.blend_constants);
+                create_info.setPColorBlendState(&color_blend_state);
+            }
+
+            create_info.setLayout(builder.layout);
+
+            if (builder.render_pass.has_value()) {
+                auto [render_pass, subpass_index] = builder.render_pass.value();
+                create_info.setRenderPass(render_pass);
+                create_info.setSubpass(subpass_index);
+            }
+
+            if (builder.dynamic_rendering_info.has_value()) {
+                rendering_info.setColorAttachmentFormats(builder.dynamic_rendering_info->color_formats);
+                rendering_info.setDepthAttachmentFormat(builder.dynamic_rendering_info->depth_format);
+                rendering_info.setStencilAttachmentFormat(builder.dynamic_rendering_info->stencil_format);
+                rendering_info.setViewMask(builder.dynamic_rendering_info->view_mask);
+                create_info.setPNext(&rendering_info);
+            }
+
+            if (parts != ALL_PIPELINE_PARTS) {
+                // keep what's needed for an optimized link later
+                library_info.setFlags(parts);
+                library_info.setPNext(create_info.pNext);
+                create_info.setPNext(&library_info);
+                create_info.setFlags(vk::PipelineCreateFlagBits::eLibraryKHR | vk::PipelineCreateFlagBits::eRetainLinkTimeOptimizationInfoEXT);
             }
         }
 
-        vertex_input_state.setVertexBindingDescriptions(vertex_bindings);
-        vertex_input_state.setVertexAttributeDescriptions(vertex_attributes);
-        create_info.setPVertexInputState(&vertex_input_state);
-
-        vk::PipelineInputAssemblyStateCreateInfo input_assembly{};
-        input_assembly.setTopology(builder.topology);
-        input_assembly.setPrimitiveRestartEnable(builder.enable_primitive_restart);
-        create_info.setPInputAssemblyState(&input_assembly);
-
-        vk::PipelineViewportStateCreateInfo viewport_state{};
-        viewport_state.setViewports(builder.viewports);
-        viewport_state.setScissors(builder.scissors);
-        create_info.setPViewportState(&viewport_state);
-
-        vk::PipelineRasterizationStateCreateInfo rasterization_state{};
-        rasterization_state.setDepthClampEnable(builder.enable_depth_clamp);
-        rasterization_state.setRasterizerDiscardEnable(builder.discard_rasterizer_output);
-        rasterization_state.setPolygonMode(builder.polygon_mode);
-        rasterization_state.setCullMode(builder.cull_mode);
-        rasterization_state.setFrontFace(builder.front_face);
-        rasterization_state.setLineWidth(builder.line_width);
-        rasterization_state.setDepthBiasEnable(builder.depth_bias.has_value());
-        if (builder.depth_bias.has_value()) {
-            rasterization_state.setDepthBiasConstantFactor(builder.depth_bias->constant_factor);
-            rasterization_state.setDepthBiasClamp(builder.depth_bias->clamp);
-            rasterization_state.setDepthBiasSlopeFactor(builder.depth_bias->slope_factor);
-        }
-        create_info.setPRasterizationState(&rasterization_state);
-
-        vk::PipelineMultisampleStateCreateInfo multisample_state{};
-        multisample_state.setSampleShadingEnable(builder.enable_sample_shading);
-        multisample_state.setRasterizationSamples(builder.rasterization_samples);
-        multisample_state.setMinSampleShading(builder.min_sample_shading);
-        multisample_state.setPSampleMask(builder.sample_mask.data());
-        multisample_state.setAlphaToCoverageEnable(builder.enable_alpha_to_coverage);
-        multisample_state.setAlphaToOneEnable(builder.enable_alpha_to_one);
-        create_info.setPMultisampleState(&multisample_state);
+        GraphicsPipelineCreateState(const GraphicsPipelineCreateState &other)                = delete;
+        GraphicsPipelineCreateState &operator=(const GraphicsPipelineCreateState &other)     = delete;
+        GraphicsPipelineCreateState(GraphicsPipelineCreateState &&other) noexcept            = delete;
+        GraphicsPipelineCreateState &operator=(GraphicsPipelineCreateState &&other) noexcept = delete;
+    };
 
-        std::vector<vk::PipelineColorBlendAttachmentState> color_attachments;
-        color_attachments.reserve(builder.color_blend_attachments.size());
-        for (const auto &[color_write_mask, enable_blending, color, alpha] : builder.color_blend_attachments) {
-            color_attachments.emplace_back(enable_blending, color.src, color.dst, color.op, alpha.src, alpha.dst, alpha.op, color_write_mask);
+    GraphicsPipeline::GraphicsPipeline(const vk::Device device, const GraphicsPipelineBuilder &builder, const vk::PipelineCache cache) : m_device(device) {
+        const GraphicsPipelineCreateState state(builder, ALL_PIPELINE_PARTS);
+        m_pipeline = m_device.createGraphicsPipeline(cache, state.create_info).value;
+    }
+
+    GraphicsPipeline::GraphicsPipeline(const vk::Device device, const GraphicsPipelineBuilder &builder, const vk::GraphicsPipelineLibraryFlagsEXT parts,
+                                       const vk::PipelineCache cache)
+        : m_device(device) {
+        const GraphicsPipelineCreateState state(builder, parts);
+        m_pipeline = m_device.createGraphicsPipeline(cache, state.create_info).value;
+    }
+
+    GraphicsPipeline::GraphicsPipeline(const vk::Device device, const std::span<const vk::Pipeline> libraries, const vk::PipelineLayout layout, const bool optimize,
+                                       const vk::PipelineCache cache)
+        : m_device(device) {
+        vk::PipelineLibraryCreateInfoKHR library_info{};
+        library_info.setLibraries(libraries);
+
+        vk::GraphicsPipelineCreateInfo create_info{};
+        create_info.setPNext(&library_info);
+        create_info.setLayout(layout);
+        if (optimize)
+            create_info.setFlags(vk::PipelineCreateFlagBits::eLinkTimeOptimizationEXT);
+
+        m_pipeline = m_device.createGraphicsPipeline(cache, create_info).value;
+    }
+
+    GraphicsPipeline::~GraphicsPipeline() {
+        m_device.destroy(m_pipeline);
+    }
+
+    void SpecializationConstants::set_bytes(const uint32_t constant_id, const void *data, const size_t size) {
+        const auto existing = std::ranges::find(m_entries, constant_id, &vk::SpecializationMapEntry::constantID);
+        if (existing != m_entries.end() && existing->size == size) {
+            std::memcpy(m_data.data() + existing->offset, data, size);
+            return;
+        }
+
+        if (existing != m_entries.end()) {
+            // the size changed, so drop the old value's bytes and shift everything after it down
+            const uint32_t offset = existing->offset;
+            const size_t   old    = existing->size;
+            m_data.erase(m_data.begin() + offset, m_data.begin() + static_cast<ptrdiff_t>(offset + old));
+            m_entries.erase(existing);
+            for (auto &entry : m_entries) {
+                if (entry.offset > offset)
+                    entry.offset -= static_cast<uint32_t>(old);
+            }
         }
-        vk::PipelineColorBlendStateCreateInfo color_blend_state{};
-        color_blend_state.setAttachments(color_attachments);
-        color_blend_state.setLogicOpEnable(builder.logic_op.has_value());
-        color_blend_state.setLogicOp(builder.logic_op.value_or(vk::LogicOp::eCopy));
-        color_blend_state.setBlendConstants(builder.blend_constants);
-        create_info.setPColorBlendState(&color_blend_state);
 
-        create_info.setLayout(builder.layout);
+        m_entries.emplace_back(constant_id, static_cast<uint32_t>(m_data.size()), size);
+        const auto *bytes = static_cast<const std::byte *>(data);
+        m_data.insert(m_data.end(), bytes, bytes + size);
+    }
 
-        if (builder.render_pass.has_value()) {
-            auto [render_pass, subpass_index] = builder.render_pass.value();
-            create_info.setRenderPass(render_pass);
-            create_info.setSubpass(subpass_index);
+    ComputePipeline::ComputePipeline(const vk::Device device, const ComputePipelineBuilder &builder, const vk::PipelineCache cache)
+        : m_device(device), m_layout(builder.layout), m_owns_layout(!builder.layout) {
+        if (m_owns_layout) {
+            m_layout = m_device.createPipelineLayout(vk::PipelineLayoutCreateInfo({}, builder.set_layouts, builder.push_constant_ranges));
         }
 
-        vk::PipelineRenderingCreateInfo rendering_info{};
-        if (builder.dynamic_rendering_info.has_value()) {
-            rendering_info.setColorAttachmentFormats(builder.dynamic_rendering_info->color_formats);
-            rendering_info.setDepthAttachmentFormat(builder.dynamic_rendering_info->depth_format);
-            rendering_info.setStencilAttachmentFormat(builder.dynamic_rendering_info->stencil_format);
-            rendering_info.setViewMask(builder.dynamic_rendering_info->view_mask);
-            create_info.setPNext(&rendering_info);
+        const vk::SpecializationInfo specialization = builder.specialization.info();
+
+        vk::PipelineShaderStageCreateInfo stage({}, vk::ShaderStageFlagBits::eCompute, builder.module, builder.entry_point.c_str());
+        if (!builder.specialization.empty()) {
+            stage.setPSpecializationInfo(&specialization);
         }
 
-        m_pipeline = m_device.createGraphicsPipeline(cache, create_info).value;
+        m_pipeline = m_device.createComputePipeline(cache, vk::ComputePipelineCreateInfo({}, stage, m_layout)).value;
     }
 
-    GraphicsPipeline::~GraphicsPipeline() {
+    ComputePipeline::~ComputePipeline() {
         m_device.destroy(m_pipeline);
+        if (m_owns_layout) {
+            m_device.destroy(m_layout);
+        }
+    }
+
+    std::vector<vk::DynamicState> extended_dynamic_states(const DeviceFeatures &features) {
+        // extended dynamic state 1 and 2 are core in 1.3
+        std::vector states = {
+            vk::DynamicState::eCullMode,
+            vk::DynamicState::eFrontFace,
+            vk::DynamicState::ePrimitiveTopology,
+            vk::DynamicState::ePrimitiveRestartEnable,
+            vk::DynamicState::eRasterizerDiscardEnable,
+            vk::DynamicState::eDepthBiasEnable,
+            vk::DynamicState::eDepthBias,
+        };
+
+        if (features.dynamic_polygon_mode)
+            states.push_back(vk::DynamicState::ePolygonModeEXT);
+        if (features.dynamic_depth_clamp)
+            states.push_back(vk::DynamicState::eDepthClampEnableEXT);
+        if (features.dynamic_color_blend) {
+            states.push_back(vk::DynamicState::eColorBlendEnableEXT);
+            states.push_back(vk::DynamicState::eColorBlendEquationEXT);
+            states.push_back(vk::DynamicState::eColorWriteMaskEXT);
+        }
+
+        return states;
+    }
+
+    // true (and remembers the value) if the command has to be recorded
+    template <typename T>
+    static bool update_cached(std::optional<T> &cached, const T &value) {
+        if (cached.has_value() && cached.value() == value)
+            return false;
+
+        cached = value;
+        return true;
     }
 
     void ActiveRenderer::bind_graphics_pipeline(const vk::Pipeline pipeline) const {
+        if (pipeline == m_bound_pipeline)
+            return;
+
+        // this replaces any bound shader objects too
         cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);
+        m_bound_pipeline       = pipeline;
+        m_bound_shaders        = {};
+        m_using_shader_objects = false;
+        m_dynamic_state        = {};
     }
 
     void ActiveRenderer::bind_graphics_pipeline(const GraphicsPipeline *pipeline) const {
-        cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline->get());
+        bind_graphics_pipeline(pipeline->get());
     }
 
     void ActiveRenderer::bind_graphics_pipeline(const std::shared_ptr<GraphicsPipeline> &pipeline) const {
-        cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline->get());
+        bind_graphics_pipeline(pipeline->get());
     }
 
     void ActiveRenderer::bind_graphics_pipeline(const std::unique_ptr<GraphicsPipeline> &pipeline) const {
-        cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline->get());
+        bind_graphics_pipeline(pipeline->get());
     }
 
     void ActiveRenderer::bind_graphics_pipeline(const GraphicsPipeline &pipeline) const {
-        cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline.get());
+        bind_graphics_pipeline(pipeline.get());
     }
 
     void ActiveRenderer::bind_compute_pipeline(const vk::Pipeline pipeline) const {
         cmd.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline);
     }
 
+    void ActiveRenderer::bind_compute_pipeline(const ComputePipeline *pipeline) const {
+        cmd.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline->get());
+    }
+
+    void ActiveRenderer::bind_compute_pipeline(const std::shared_ptr<ComputePipeline> &pipeline) const {
+        cmd.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline->get());
+    }
+
+    void ActiveRenderer::bind_compute_pipeline(const std::unique_ptr<ComputePipeline> &pipeline) const {
+        cmd.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline->get());
+    }
+
+    void ActiveRenderer::bind_compute_pipeline(const ComputePipeline &pipeline) const {
+        cmd.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline.get());
+    }
+
+    void ActiveRenderer::bind_descriptor_heap(const DescriptorHeap &heap, const vk::PipelineBindPoint bind_point) const {
+        cmd.bindDescriptorSets(bind_point, heap.pipeline_layout(), 0, heap.set(), {});
+    }
+
     void ActiveRenderer::bind_mesh(const std::unique_ptr<Mesh> &mesh) const {
         cmd.bindVertexBuffers(0, mesh->vertex_buffer().buffer, 0ULL);
         if (mesh->index_buffer().has_value()) {
@@ -146,7 +338,361 @@ namespace vke {
         }
     }
 
-    void SimpleRenderer::render(const vk::CommandBuffer &cmd, const vk::ImageView view, const vk::Rect2D &render_area, const std::function<void(ActiveRenderer &&)> &f) const {
+    void ActiveRenderer::bind_mesh(const std::unique_ptr<Mesh> &mesh, const std::span<const InstanceStream> instance_streams) const {
+        bind_mesh(mesh.get(), instance_streams);
+    }
+
+    void ActiveRenderer::bind_mesh(const std::shared_ptr<Mesh> &mesh, const std::span<const InstanceStream> instance_streams) const {
+        bind_mesh(mesh.get(), instance_streams);
+    }
+
+    void ActiveRenderer::bind_mesh(const Mesh *mesh, const std::span<const InstanceStream> instance_streams) const {
+        bind_mesh(mesh);
+        bind_instance_streams(instance_streams);
+    }
+
+    void ActiveRenderer::bind_instance_streams(const std::span<const InstanceStream> instance_streams, const uint32_t first_binding) const {
+        if (instance_streams.empty())
+            return;
+
+        // stack scratch, this is called for every draw and shouldn't touch the heap
+        std::array<std::byte, 1024>         storage;
+        std::pmr::monotonic_buffer_resource scratch(storage.data(), storage.size());
+        std::pmr::vector<vk::Buffer>        buffers(&scratch);
+        std::pmr::vector<vk::DeviceSize>    offsets(&scratch);
+        buffers.reserve(instance_streams.size());
+        offsets.reserve(instance_streams.size());
+        for (const auto &stream : instance_streams) {
+            buffers.push_back(stream.buffer);
+            offsets.push_back(stream.offset);
+        }
+
+        cmd.bindVertexBuffers(first_binding, buffers, offsets);
+    }
+
+    void ActiveRenderer::draw_instanced(const std::unique_ptr<Mesh> &mesh, const uint32_t instance_count, const uint32_t first_instance) const {
+        draw_instanced(mesh.get(), instance_count, first_instance);
+    }
+
+    void ActiveRenderer::draw_instanced(const std::shared_ptr<Mesh> &mesh, const uint32_t instance_count, const uint32_t first_instance) const {
+        draw_instanced(mesh.get(), instance_count, first_instance);
+    }
+
+    void ActiveRenderer::draw_instanced(const Mesh *mesh, const uint32_t instance_count, const uint32_t first_instance) const {
+        if (mesh->index_buffer().has_value()) {
+            cmd.drawIndexed(mesh->index_count(), instance_count, 0, 0, first_instance);
+        } else {
+            assert(mesh->vertex_count() != 0);
+            cmd.draw(mesh->vertex_count(), instance_count, 0, first_instance);
+        }
+    }
+
+    void ActiveRenderer::draw_lod(const std::unique_ptr<Mesh> &mesh, const uint32_t lod, const uint32_t instance_count, const uint32_t first_instance) const {
+        draw_lod(mesh.get(), lod, instance_count, first_instance);
+    }
+
+    void ActiveRenderer::draw_lod(const std::shared_ptr<Mesh> &mesh, const uint32_t lod, const uint32_t instance_count, const uint32_t first_instance) const {
+        draw_lod(mesh.get(), lod, instance_count, first_instance);
+    }
+
+    void ActiveRenderer::draw_lod(const Mesh *mesh, const uint32_t lod, const uint32_t instance_count, const uint32_t first_instance) const {
+        const auto lods = mesh->lods();
+        if (lods.empty()) {
+            draw_instanced(mesh, instance_count, first_instance);
+            return;
+        }
+
+        const MeshLod &level = lods[std::min<size_t>(lod, lods.size() - 1)];
+        cmd.drawIndexed(level.index_count, instance_count, level.first_index, 0, first_instance);
+    }
+
+    void ActiveRenderer::bind_pulled_mesh(const std::unique_ptr<Mesh> &mesh, const vk::PipelineLayout layout, const vk::ShaderStageFlags stages) const {
+        bind_pulled_mesh(mesh.get(), layout, stages);
+    }
+
+    void ActiveRenderer::bind_pulled_mesh(const std::shared_ptr<Mesh> &mesh, const vk::PipelineLayout layout, const vk::ShaderStageFlags stages) const {
+        bind_pulled_mesh(mesh.get(), layout, stages);
+    }
+
+    void ActiveRenderer::bind_pulled_mesh(const Mesh *mesh, const vk::PipelineLayout layout, const vk::ShaderStageFlags stages) const {
+        assert(mesh->vertex_address() != 0);
+
+        const VertexPullingConstants constants{mesh->vertex_address()};
+        cmd.pushConstants(layout, stages, 0, sizeof(VertexPullingConstants), &constants);
+        if (mesh->index_buffer().has_value()) {
+            cmd.bindIndexBuffer(mesh->index_buffer().value().buffer, 0, mesh->index_type());
+        }
+    }
+
+    void ActiveRenderer::draw_meshlets(const std::unique_ptr<Mesh> &mesh, const vk::PipelineLayout layout, const glm::mat4 &mvp, const glm::vec3 &camera_position,
+                                       const vk::ShaderStageFlags stages) const {
+        draw_meshlets(mesh.get(), layout, mvp, camera_position, stages);
+    }
+
+    void ActiveRenderer::draw_meshlets(const std::shared_ptr<Mesh> &mesh, const vk::PipelineLayout layout, const glm::mat4 &mvp, const glm::vec3 &camera_position,
+                                       const vk::ShaderStageFlags stages) const {
+        draw_meshlets(mesh.get(), layout, mvp, camera_position, stages);
+    }
+
+    void ActiveRenderer::draw_meshlets(const Mesh *mesh, const vk::PipelineLayout layout, const glm::mat4 &mvp, const glm::vec3 &camera_position,
+                                       const vk::ShaderStageFlags stages) const {
+        const std::optional<MeshletBuffer> meshlets = mesh->meshlets();
+        assert(meshlets.has_value());
+
+        const MeshletDrawConstants constants{
+            .mvp               = mvp,
+            .meshlets          = meshlets->address,
+            .meshlet_vertices  = meshlets->address + meshlets->vertices_offset,
+            .meshlet_triangles = meshlets->address + meshlets->triangles_offset,
+            .vertices          = mesh->vertex_address(),
+            .camera_position   = camera_position,
+            .meshlet_count     = meshlets->meshlet_count,
+            .vertex_stride     = meshlets->vertex_stride,
+            .position_offset   = meshlets->position_offset,
+            .uv_offset         = meshlets->uv_offset,
+        };
+        cmd.pushConstants(layout, stages, 0, sizeof(MeshletDrawConstants), &constants);
+        cmd.drawMeshTasksEXT((meshlets->meshlet_count + MESHLETS_PER_TASK - 1) / MESHLETS_PER_TASK, 1, 1);
+    }
+
+    void ActiveRenderer::set_viewport(const vk::Viewport &viewport) const {
+        if (!update_cached(m_dynamic_state.viewport, viewport))
+            return;
+
+        if (m_using_shader_objects) {
+            cmd.setViewportWithCount(viewport);
+        } else {
+            cmd.setViewport(0, viewport);
+        }
+    }
+
+    void ActiveRenderer::set_scissor(const vk::Rect2D &scissor) const {
+        if (!update_cached(m_dynamic_state.scissor, scissor))
+            return;
+
+        if (m_using_shader_objects) {
+            cmd.setScissorWithCount(scissor);
+        } else {
+            cmd.setScissor(0, scissor);
+        }
+    }
+
+    void ActiveRenderer::set_cull_mode(const vk::CullModeFlags cull_mode) const {
+        if (update_cached(m_dynamic_state.cull_mode, cull_mode))
+            cmd.setCullMode(cull_mode);
+    }
+
+    void ActiveRenderer::set_front_face(const vk::FrontFace front_face) const {
+        if (update_cached(m_dynamic_state.front_face, front_face))
+            cmd.setFrontFace(front_face);
+    }
+
+    void ActiveRenderer::set_primitive_topology(const vk::PrimitiveTopology topology) const {
+        if (update_cached(m_dynamic_state.topology, topology))
+            cmd.setPrimitiveTopology(topology);
+    }
+
+    void ActiveRenderer::set_primitive_restart_enable(const bool enable) const {
+        if (update_cached(m_dynamic_state.primitive_restart_enable, enable))
+            cmd.setPrimitiveRestartEnable(enable);
+    }
+
+    void ActiveRenderer::set_rasterizer_discard_enable(const bool enable) const {
+        if (update_cached(m_dynamic_state.rasterizer_discard_enable, enable))
+            cmd.setRasterizerDiscardEnable(enable);
+    }
+
+    void ActiveRenderer::set_depth_bias(const std::optional<DepthBias> &depth_bias) const {
+        if (update_cached(m_dynamic_state.depth_bias_enable, depth_bias.has_value()))
+            cmd.setDepthBiasEnable(depth_bias.has_value());
+
+        // the factors don't matter while it's disabled, so keep whatever was set before
+        if (depth_bias.has_value() && update_cached(m_dynamic_state.depth_bias, depth_bias.value()))
+            cmd.setDepthBias(depth_bias->constant_factor, depth_bias->clamp, depth_bias->slope_factor);
+    }
+
+    void ActiveRenderer::set_depth_test(const std::optional<DepthTest> &depth_test) const {
+        if (update_cached(m_dynamic_state.depth_test_enable, depth_test.has_value()))
+            cmd.setDepthTestEnable(depth_test.has_value());
+
+        const bool write = depth_test.has_value() && depth_test->enable_write;
+        if (update_cached(m_dynamic_state.depth_write_enable, write))
+            cmd.setDepthWriteEnable(write);
+
+        if (depth_test.has_value() && update_cached(m_dynamic_state.depth_compare_op, depth_test->compare_op))
+            cmd.setDepthCompareOp(depth_test->compare_op);
+    }
+
+    void ActiveRenderer::set_stencil_test(const std::optional<StencilTest> &stencil_test) const {
+        if (update_cached(m_dynamic_state.stencil_test_enable, stencil_test.has_value()))
+            cmd.setStencilTestEnable(stencil_test.has_value());
+
+        if (!stencil_test.has_value() || !update_cached(m_dynamic_state.stencil_test, stencil_test.value()))
+            return;
+
+        const auto set_face = [this](const vk::StencilFaceFlags face, const vk::StencilOpState &op) {
+            cmd.setStencilOp(face, op.failOp, op.passOp, op.depthFailOp, op.compareOp);
+            cmd.setStencilCompareMask(face, op.compareMask);
+            cmd.setStencilWriteMask(face, op.writeMask);
+            cmd.setStencilReference(face, op.reference);
+        };
+
+        if (stencil_test->front == stencil_test->back) {
+            set_face(vk::StencilFaceFlagBits::eFrontAndBack, stencil_test->front);
+        } else {
+            set_face(vk::StencilFaceFlagBits::eFront, stencil_test->front);
+            set_face(vk::StencilFaceFlagBits::eBack, stencil_test->back);
+        }
+    }
+
+    void ActiveRenderer::set_polygon_mode(const vk::PolygonMode polygon_mode) const {
+        if (update_cached(m_dynamic_state.polygon_mode, polygon_mode))
+            cmd.setPolygonModeEXT(polygon_mode);
+    }
+
+    void ActiveRenderer::set_depth_clamp_enable(const bool enable) const {
+        if (update_cached(m_dynamic_state.depth_clamp_enable, enable))
+            cmd.setDepthClampEnableEXT(enable);
+    }
+
+    void ActiveRenderer::set_color_blend(const uint32_t attachment, const ColorBlendAttachment &blend) const {
+        std::optional<ColorBlendAttachment> untracked;
+        auto                               &cached   = attachment < MAX_TRACKED_ATTACHMENTS ? m_dynamic_state.color_blend[attachment] : untracked;
+        const auto                          previous = cached;
+        if (!update_cached(cached, blend))
+            return;
+
+        if (!previous.has_value() || previous->enable_blending != blend.enable_blending)
+            cmd.setColorBlendEnableEXT(attachment, vk::Bool32(blend.enable_blending));
+
+        if (!previous.has_value() || previous->color != blend.color || previous->alpha != blend.alpha) {
+            const vk::ColorBlendEquationEXT equation(blend.color.src, blend.color.dst, blend.color.op, blend.alpha.src, blend.alpha.dst, blend.alpha.op);
+            cmd.setColorBlendEquationEXT(attachment, equation);
+        }
+
+        if (!previous.has_value() || previous->color_write_mask != blend.color_write_mask)
+            cmd.setColorWriteMaskEXT(attachment, blend.color_write_mask);
+    }
+
+    void ActiveRenderer::set_dynamic_state(const GraphicsPipelineBuilder &state) const {
+        const auto is_dynamic = [&](const vk::DynamicState dynamic_state) { return std::ranges::contains(state.dynamic_states, dynamic_state); };
+
+        if (is_dynamic(vk::DynamicState::eCullMode))
+            set_cull_mode(state.cull_mode);
+        if (is_dynamic(vk::DynamicState::eFrontFace))
+            set_front_face(state.front_face);
+        if (is_dynamic(vk::DynamicState::ePrimitiveTopology))
+            set_primitive_topology(state.topology);
+        if (is_dynamic(vk::DynamicState::ePrimitiveRestartEnable))
+            set_primitive_restart_enable(state.enable_primitive_restart);
+        if (is_dynamic(vk::DynamicState::eRasterizerDiscardEnable))
+            set_rasterizer_discard_enable(state.discard_rasterizer_output);
+        if (is_dynamic(vk::DynamicState::eDepthBiasEnable))
+            set_depth_bias(state.depth_bias);
+        if (is_dynamic(vk::DynamicState::ePolygonModeEXT))
+            set_polygon_mode(state.polygon_mode);
+        if (is_dynamic(vk::DynamicState::eDepthClampEnableEXT))
+            set_depth_clamp_enable(state.enable_depth_clamp);
+        if (is_dynamic(vk::DynamicState::eColorBlendEnableEXT)) {
+            for (uint32_t i = 0; i < state.color_blend_attachments.size(); i++) {
+                set_color_blend(i, state.color_blend_attachments[i]);
+            }
+        }
+    }
+
+    void ActiveRenderer::bind_shaders(const std::span<const std::shared_ptr<ShaderObject>> shaders) const {
+        const auto stages = std::span(SHADER_OBJECT_STAGES).first(m_shader_object_stage_count);
+
+        std::array<vk::ShaderEXT, SHADER_OBJECT_STAGES.size()> bound{};
+        for (const auto &shader : shaders) {
+            const auto stage = std::ranges::find(stages, shader->stage());
+            if (stage == stages.end()) {
+                throw std::runtime_error("Only graphics shader objects can be bound (and task and mesh shaders only when mesh shaders are enabled).");
+            }
+
+            bound[stage - stages.begin()] = shader->get();
+        }
+
+        if (m_using_shader_objects && bound == m_bound_shaders)
+            return;
+
+        if (!m_using_shader_objects) {
+            // state baked into the last pipeline doesn't count as set for shader objects
+            m_bound_pipeline       = VK_NULL_HANDLE;
+            m_using_shader_objects = true;
+            m_dynamic_state        = {};
+        }
+
+        cmd.bindShadersEXT(stages, std::span(bound).first(stages.size()));
+        m_bound_shaders = bound;
+    }
+
+    // identifies a vertex input layout for the state cache without copying it
+    static size_t hash_vertex_input(const std::span<const VertexBufferBinding> bindings) {
+        size_t seed = bindings.size();
+        for (const auto &[binding, stride, input_rate, attributes] : bindings) {
+            hash_combine(seed, binding);
+            hash_combine(seed, stride);
+            hash_combine(seed, static_cast<uint32_t>(input_rate));
+            hash_combine(seed, attributes.size());
+            for (const auto &[location, format, offset] : attributes) {
+                hash_combine(seed, location);
+                hash_combine(seed, static_cast<uint32_t>(format));
+                hash_combine(seed, offset);
+            }
+        }
+
+        return seed;
+    }
+
+    void ActiveRenderer::set_render_state(const ShaderRenderState &state) const {
+        if (update_cached(m_dynamic_state.vertex_input, hash_vertex_input(state.vertex_buffer_bindings))) {
+            std::array<std::byte, 4096>                               storage;
+            std::pmr::monotonic_buffer_resource                       scratch(storage.data(), storage.size());
+            std::pmr::vector<vk::VertexInputBindingDescription2EXT>   bindings(&scratch);
+            std::pmr::vector<vk::VertexInputAttributeDescription2EXT> attributes(&scratch);
+            bindings.reserve(state.vertex_buffer_bindings.size());
+            for (const auto &[binding, stride, input_rate, binding_attributes] : state.vertex_buffer_bindings) {
+                bindings.emplace_back(binding, stride, input_rate, 1);
+                for (const auto &[location, format, offset] : binding_attributes) {
+                    attributes.emplace_back(location, binding, format, offset);
+                }
+            }
+
+            cmd.setVertexInputEXT(bindings, attributes);
+        }
+
+        set_primitive_topology(state.topology);
+        set_primitive_restart_enable(state.enable_primitive_restart);
+        set_rasterizer_discard_enable(state.discard_rasterizer_output);
+        set_polygon_mode(state.polygon_mode);
+        set_cull_mode(state.cull_mode);
+        set_front_face(state.front_face);
+        set_depth_bias(state.depth_bias);
+
+        if (update_cached(m_dynamic_state.line_width, state.line_width))
+            cmd.setLineWidth(state.line_width);
+
+        if (update_cached(m_dynamic_state.rasterization_samples, state.rasterization_samples)) {
+            constexpr vk::SampleMask all_samples = ~0u;
+            cmd.setRasterizationSamplesEXT(state.rasterization_samples);
+            cmd.setSampleMaskEXT(state.rasterization_samples, all_samples);
+        }
+
+        if (update_cached(m_dynamic_state.alpha_to_coverage_enable, state.enable_alpha_to_coverage))
+            cmd.setAlphaToCoverageEnableEXT(state.enable_alpha_to_coverage);
+
+        set_depth_test(state.depth_test);
+        set_stencil_test(state.stencil_test);
+        if (update_cached(m_dynamic_state.depth_bounds_test_enable, false))
+            cmd.setDepthBoundsTestEnable(false);
+
+        for (uint32_t i = 0; i < state.color_blend_attachments.size(); i++) {
+            set_color_blend(i, state.color_blend_attachments[i]);
+        }
+    }
+
+    void SimpleRenderer::render(const vk::CommandBuffer &cmd, const vk::ImageView view, const vk::Rect2D &render_area, const function_ref<void(ActiveRenderer &&)> f) const {
         const vk::ClearColorValue clear_color(m_clear_color.r, m_clear_color.g, m_clear_color.b, m_clear_color.a);
 
         vk::RenderingAttachmentInfo color{
@@ -161,7 +707,7 @@ namespace vke {
         };
 
         cmd.beginRendering(vk::RenderingInfo({}, render_area, 1, 0, color));
-        f(ActiveRenderer(cmd));
+        f(ActiveRenderer(cmd, m_features));
         cmd.endRendering();
     }
 } // namespace vke
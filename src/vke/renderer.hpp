@@ -6,32 +6,66 @@
 
 #include <glm/glm.hpp>
 
+#include <algorithm>
+#include <array>
 #include <optional>
+#include <span>
+#include <utility>
 
+#include "vke/descriptor_heap.hpp"
 #include "vke/mesh.hpp"
+#include "vke/util.hpp"
 
 namespace vke {
     struct VertexBufferAttribute {
         uint32_t   location;
         vk::Format format;
         uint32_t   offset;
+
+        bool operator==(const VertexBufferAttribute &other) const = default;
     };
 
     struct VertexBufferBinding {
         uint32_t                           binding, stride;
         vk::VertexInputRate                input_rate;
         std::vector<VertexBufferAttribute> attributes;
+
+        bool operator==(const VertexBufferBinding &other) const = default;
+    };
+
+    // a per-instance vertex stream (a VertexBufferBinding with eInstance input rate). see InstanceBuffer and instance_stream(RingAllocation) in instancing.hpp
+    struct InstanceStream {
+        vk::Buffer     buffer;
+        vk::DeviceSize offset = 0;
     };
 
     struct DepthBias {
         float constant_factor = 0.0f;
         float clamp           = 0.0f;
         float slope_factor    = 0.0f;
+
+        bool operator==(const DepthBias &other) const = default;
+    };
+
+    struct DepthTest {
+        vk::CompareOp compare_op   = vk::CompareOp::eLess;
+        bool          enable_write = true;
+
+        bool operator==(const DepthTest &other) const = default;
+    };
+
+    struct StencilTest {
+        vk::StencilOpState front;
+        vk::StencilOpState back;
+
+        bool operator==(const StencilTest &other) const = default;
     };
 
     struct BlendFunction {
         vk::BlendFactor src, dst;
         vk::BlendOp     op;
+
+        bool operator==(const BlendFunction &other) const = default;
     };
 
     namespace blending {
@@ -45,12 +79,48 @@ namespace vke {
         bool          enable_blending = true;
         BlendFunction color           = blending::ALPHA_BLENDING;
         BlendFunction alpha           = blending::SOURCE_ONLY;
+
+        bool operator==(const ColorBlendAttachment &other) const = default;
+    };
+
+    // specialization constant values along with their map entries, so they can be handed straight to a pipeline stage
+    class SpecializationConstants {
+      public:
+        // bools are stored as VkBool32, like the spec expects
+        template <typename T>
+            requires std::is_trivially_copyable_v<T>
+        SpecializationConstants &set(const uint32_t constant_id, const T &value) {
+            if constexpr (std::is_same_v<T, bool>) {
+                return set(constant_id, static_cast<vk::Bool32>(value));
+            } else {
+                set_bytes(constant_id, &value, sizeof(T));
+                return *this;
+            }
+        }
+
+        // points into this object, so it is only valid while this is alive and unchanged
+        [[nodiscard]] vk::SpecializationInfo info() const {
+            return {static_cast<uint32_t>(m_entries.size()), m_entries.data(), m_data.size(), m_data.data()};
+        }
+
+        [[nodiscard]] bool empty() const { return m_entries.empty(); }
+
+        bool operator==(const SpecializationConstants &other) const = default;
+
+      private:
+        std::vector<vk::SpecializationMapEntry> m_entries;
+        std::vector<std::byte>                  m_data;
+
+        void set_bytes(uint32_t constant_id, const void *data, size_t size);
     };
 
     struct ShaderStage {
         vk::ShaderStageFlagBits stage;
         std::string             entry_point;
         vk::ShaderModule        module;
+        SpecializationConstants specialization;
+
+        bool operator==(const ShaderStage &other) const = default;
     };
 
     struct DynamicRenderingInfo {
@@ -58,6 +128,8 @@ namespace vke {
         vk::Format              depth_format   = vk::Format::eUndefined;
         vk::Format              stencil_format = vk::Format::eUndefined;
         uint32_t                view_mask      = 0;
+
+        bool operator==(const DynamicRenderingInfo &other) const = default;
     };
 
     struct GraphicsPipelineBuilder {
@@ -84,20 +156,38 @@ namespace vke {
         // TODO: depth stencil stuff
         std::vector<ColorBlendAttachment> color_blend_attachments;
         std::optional<vk::LogicOp>        logic_op = std::nullopt;
-        std::array<float, 4>              blend_constants;
+        std::array<float, 4>              blend_constants{};
         vk::PipelineLayout                layout;
 
         std::optional<DynamicRenderingInfo> dynamic_rendering_info = std::nullopt;
 
         std::optional<std::pair<vk::RenderPass, uint32_t>> render_pass = std::nullopt;
+
+        // with a mesh stage (and optionally a task stage) instead of a vertex stage, the vertex input and input assembly state is unused
+        [[nodiscard]] bool uses_mesh_shaders() const {
+            return std::ranges::any_of(stages, [](const ShaderStage &stage) { return stage.stage == vk::ShaderStageFlagBits::eMeshEXT; });
+        }
+
+        bool operator==(const GraphicsPipelineBuilder &other) const = default;
     };
 
     class GraphicsPipeline {
       public:
         GraphicsPipeline(vk::Device device, const GraphicsPipelineBuilder &builder, vk::PipelineCache cache = VK_NULL_HANDLE);
 
+        // creates only the given parts of the pipeline, as a library to be linked later (VK_EXT_graphics_pipeline_library)
+        GraphicsPipeline(vk::Device device, const GraphicsPipelineBuilder &builder, vk::GraphicsPipelineLibraryFlagsEXT parts, vk::PipelineCache cache = VK_NULL_HANDLE);
+
+        // links libraries into a complete pipeline. an optimized link takes about as long as a monolithic compile and makes an equally fast pipeline, otherwise it's quick.
+        GraphicsPipeline(vk::Device device, std::span<const vk::Pipeline> libraries, vk::PipelineLayout layout, bool optimize, vk::PipelineCache cache = VK_NULL_HANDLE);
+
         ~GraphicsPipeline();
 
+        GraphicsPipeline(const GraphicsPipeline &other)                = delete;
+        GraphicsPipeline &operator=(const GraphicsPipeline &other)     = delete;
+        GraphicsPipeline(GraphicsPipeline &&other) noexcept            = delete;
+        GraphicsPipeline &operator=(GraphicsPipeline &&other) noexcept = delete;
+
         [[nodiscard]] inline vk::Pipeline get() const { return m_pipeline; };
 
       private:
@@ -105,9 +195,87 @@ namespace vke {
         vk::Pipeline m_pipeline;
     };
 
+    // a pipeline which can be swapped out for a new version (see ShaderHotReloader and GraphicsPipelineLinker). only touch this from the thread which records frames.
+    class ReloadablePipeline {
+      public:
+        explicit ReloadablePipeline(std::shared_ptr<GraphicsPipeline> pipeline) : m_pipeline(std::move(pipeline)) {}
+
+        [[nodiscard]] inline const std::shared_ptr<GraphicsPipeline> &pipeline() const { return m_pipeline; }
+
+        [[nodiscard]] inline vk::Pipeline get() const { return m_pipeline->get(); }
+
+        // bumped every time a new pipeline is swapped in
+        [[nodiscard]] inline uint32_t generation() const { return m_generation; }
+
+        // returns the old pipeline, which frames in flight may still be using
+        [[nodiscard]] std::shared_ptr<GraphicsPipeline> replace(std::shared_ptr<GraphicsPipeline> pipeline) {
+            m_generation++;
+            return std::exchange(m_pipeline, std::move(pipeline));
+        }
+
+      private:
+        std::shared_ptr<GraphicsPipeline> m_pipeline;
+        uint32_t                          m_generation = 0;
+    };
+
+    struct ComputePipelineBuilder {
+        vk::ShaderModule        module;
+        std::string             entry_point = "main";
+        SpecializationConstants specialization;
+
+        // a layout is created from these (and owned by the pipeline) if layout is left null
+        std::vector<vk::DescriptorSetLayout> set_layouts;
+        std::vector<vk::PushConstantRange>   push_constant_ranges;
+        vk::PipelineLayout                   layout;
+    };
+
+    class ComputePipeline {
+      public:
+        ComputePipeline(vk::Device device, const ComputePipelineBuilder &builder, vk::PipelineCache cache = VK_NULL_HANDLE);
+
+        ~ComputePipeline();
+
+        ComputePipeline(const ComputePipeline &other)                = delete;
+        ComputePipeline &operator=(const ComputePipeline &other)     = delete;
+        ComputePipeline(ComputePipeline &&other) noexcept            = delete;
+        ComputePipeline &operator=(ComputePipeline &&other) noexcept = delete;
+
+        [[nodiscard]] inline vk::Pipeline get() const { return m_pipeline; };
+
+        [[nodiscard]] inline vk::PipelineLayout layout() const { return m_layout; };
+
+      private:
+        vk::Device         m_device;
+        vk::Pipeline       m_pipeline;
+        vk::PipelineLayout m_layout;
+        bool               m_owns_layout;
+    };
+
+    // push constant block used by meshes drawn with vertex pulling. shaders declare a matching buffer_reference as the first push constant member.
+    struct VertexPullingConstants {
+        vk::DeviceAddress vertices;
+    };
+
+    static constexpr vk::PushConstantRange VERTEX_PULLING_PUSH_CONSTANT_RANGE{vk::ShaderStageFlagBits::eVertex, 0, sizeof(VertexPullingConstants)};
+
+    class ShaderObject;
+    struct ShaderRenderState;
+
+    /**
+     * @brief Every render state the device lets us set at draw time, beyond viewport and scissor.
+     *
+     * Add these to GraphicsPipelineBuilder::dynamic_states to let one pipeline serve every cull mode, front face, topology (within the same topology class), depth bias, polygon
+     * mode and blend setting. They then have to be set before drawing, ActiveRenderer::set_dynamic_state does all of them from a builder.
+     */
+    [[nodiscard]] std::vector<vk::DynamicState> extended_dynamic_states(const DeviceFeatures &features);
+
     class ActiveRenderer {
       public:
-        inline explicit ActiveRenderer(const vk::CommandBuffer &cmd_) : cmd(cmd_){};
+        static constexpr vk::ShaderStageFlags MESHLET_STAGES = vk::ShaderStageFlagBits::eTaskEXT | vk::ShaderStageFlagBits::eMeshEXT;
+
+        // features decides which shader object stages bind_shaders has to bind, see DeviceFeatures::mesh_shader
+        inline explicit ActiveRenderer(const vk::CommandBuffer &cmd_, const DeviceFeatures &features = {})
+            : cmd(cmd_), m_shader_object_stage_count(features.mesh_shader ? SHADER_OBJECT_STAGES.size() : SHADER_OBJECT_STAGES.size() - 2){};
 
         inline vk::CommandBuffer *operator->() { return &cmd; }
 
@@ -119,30 +287,164 @@ namespace vke {
 
         inline const vk::CommandBuffer &operator*() const { return cmd; }
 
+        // binding a different pipeline forgets the dynamic state set below, since pipelines with the state baked in overwrite it
         void bind_graphics_pipeline(vk::Pipeline pipeline) const;
         void bind_graphics_pipeline(const GraphicsPipeline *pipeline) const;
         void bind_graphics_pipeline(const std::shared_ptr<GraphicsPipeline> &pipeline) const;
         void bind_graphics_pipeline(const std::unique_ptr<GraphicsPipeline> &pipeline) const;
         void bind_graphics_pipeline(const GraphicsPipeline &pipeline) const;
         void bind_compute_pipeline(vk::Pipeline pipeline) const;
+        void bind_compute_pipeline(const ComputePipeline *pipeline) const;
+        void bind_compute_pipeline(const std::shared_ptr<ComputePipeline> &pipeline) const;
+        void bind_compute_pipeline(const std::unique_ptr<ComputePipeline> &pipeline) const;
+        void bind_compute_pipeline(const ComputePipeline &pipeline) const;
+
+        // binds the heap's set at index 0. this only has to happen once per command buffer (per bind point), since every pipeline shares the heap's layout
+        void bind_descriptor_heap(const DescriptorHeap &heap, vk::PipelineBindPoint bind_point = vk::PipelineBindPoint::eGraphics) const;
 
         void bind_mesh(const std::unique_ptr<Mesh> &mesh) const;
         void bind_mesh(const std::shared_ptr<Mesh> &mesh) const;
         void bind_mesh(const Mesh *mesh) const;
 
+        // binds the mesh at binding 0 and the instance streams at bindings 1, 2, ...
+        void bind_mesh(const std::unique_ptr<Mesh> &mesh, std::span<const InstanceStream> instance_streams) const;
+        void bind_mesh(const std::shared_ptr<Mesh> &mesh, std::span<const InstanceStream> instance_streams) const;
+        void bind_mesh(const Mesh *mesh, std::span<const InstanceStream> instance_streams) const;
+
+        void bind_instance_streams(std::span<const InstanceStream> instance_streams, uint32_t first_binding = 1) const;
+
+        // draws the whole (already bound) mesh, indexed if it has an index buffer. non-indexed meshes need ExtraMeshSettings::vertex_stride set.
+        void draw_instanced(const std::unique_ptr<Mesh> &mesh, uint32_t instance_count, uint32_t first_instance = 0) const;
+        void draw_instanced(const std::shared_ptr<Mesh> &mesh, uint32_t instance_count, uint32_t first_instance = 0) const;
+        void draw_instanced(const Mesh *mesh, uint32_t instance_count, uint32_t first_instance = 0) const;
+
+        // draws one of the mesh's lods (see Mesh::lods), or the whole mesh if it has none
+        void draw_lod(const std::unique_ptr<Mesh> &mesh, uint32_t lod, uint32_t instance_count, uint32_t first_instance = 0) const;
+        void draw_lod(const std::shared_ptr<Mesh> &mesh, uint32_t lod, uint32_t instance_count, uint32_t first_instance = 0) const;
+        void draw_lod(const Mesh *mesh, uint32_t lod, uint32_t instance_count, uint32_t first_instance = 0) const;
+
+        /**
+         * @brief Draws a mesh's meshlets with the bound task/mesh shader pipeline (res/meshlet.task and res/meshlet.mesh, needs DeviceFeatures::mesh_shader).
+         *
+         * The task shader culls meshlets against the frustum and by their normal cones, 32 at a time, and only launches mesh shader workgroups for the survivors. mvp takes the
+         * mesh's object space to clip space, camera_position is in object space. The cone test assumes the model matrix doesn't scale non-uniformly. The constants are pushed to
+         * the start of layout's range with stages (like bind_pulled_mesh, pass the range's stages if it covers more than these). Without mesh shaders, see MeshletExpander.
+         */
+        void draw_meshlets(const std::unique_ptr<Mesh> &mesh, vk::PipelineLayout layout, const glm::mat4 &mvp, const glm::vec3 &camera_position,
+                           vk::ShaderStageFlags stages = MESHLET_STAGES) const;
+        void draw_meshlets(const std::shared_ptr<Mesh> &mesh, vk::PipelineLayout layout, const glm::mat4 &mvp, const glm::vec3 &camera_position,
+                           vk::ShaderStageFlags stages = MESHLET_STAGES) const;
+        void draw_meshlets(const Mesh *mesh, vk::PipelineLayout layout, const glm::mat4 &mvp, const glm::vec3 &camera_position,
+                           vk::ShaderStageFlags stages = MESHLET_STAGES) const;
+
+        /**
+         * @brief Binds a mesh created with vertex pulling enabled.
+         *
+         * No vertex buffers are bound; instead the vertex buffer's device address is pushed at the start of the push constant range (see VertexPullingConstants), and the pipeline
+         * is expected to have no vertex input bindings. The index buffer is still bound as normal.
+         */
+        void bind_pulled_mesh(const std::unique_ptr<Mesh> &mesh, vk::PipelineLayout layout, vk::ShaderStageFlags stages = vk::ShaderStageFlagBits::eVertex) const;
+        void bind_pulled_mesh(const std::shared_ptr<Mesh> &mesh, vk::PipelineLayout layout, vk::ShaderStageFlags stages = vk::ShaderStageFlagBits::eVertex) const;
+        void bind_pulled_mesh(const Mesh *mesh, vk::PipelineLayout layout, vk::ShaderStageFlags stages = vk::ShaderStageFlagBits::eVertex) const;
+
+        // these skip the command when the value is already set. state set straight through the command buffer isn't tracked, so don't mix the two.
+        void set_viewport(const vk::Viewport &viewport) const;
+        void set_scissor(const vk::Rect2D &scissor) const;
+        void set_cull_mode(vk::CullModeFlags cull_mode) const;
+        void set_front_face(vk::FrontFace front_face) const;
+        void set_primitive_topology(vk::PrimitiveTopology topology) const;
+        void set_primitive_restart_enable(bool enable) const;
+        void set_rasterizer_discard_enable(bool enable) const;
+        void set_depth_bias(const std::optional<DepthBias> &depth_bias) const;
+        // nullopt turns the test (and depth writes) off
+        void set_depth_test(const std::optional<DepthTest> &depth_test) const;
+        // with pipelines, this also needs the stencil compare mask, write mask and reference to be dynamic
+        void set_stencil_test(const std::optional<StencilTest> &stencil_test) const;
+
+        // these need DeviceFeatures::dynamic_polygon_mode, dynamic_depth_clamp and dynamic_color_blend (or shader objects, which always have them)
+        void set_polygon_mode(vk::PolygonMode polygon_mode) const;
+        void set_depth_clamp_enable(bool enable) const;
+        void set_color_blend(uint32_t attachment, const ColorBlendAttachment &blend) const;
+
+        // sets every state in state.dynamic_states (other than viewport and scissor) to the value the builder has for it
+        void set_dynamic_state(const GraphicsPipelineBuilder &state) const;
+
+        /**
+         * @brief Binds shader objects instead of a pipeline (VK_EXT_shader_object). Graphics stages which aren't given are unbound.
+         *
+         * Once mesh shaders are enabled on the device, the task and mesh stages have to be bound (even if only to nothing) before drawing, so the renderer has to be created
+         * with the device's features for those to be included.
+         *
+         * All the state a pipeline would have baked in has to be set before drawing: set_render_state for most of it, plus set_viewport and set_scissor.
+         */
+        void bind_shaders(std::span<const std::shared_ptr<ShaderObject>> shaders) const;
+
+        // only valid with shader objects bound
+        void set_render_state(const ShaderRenderState &state) const;
+
       private:
+        static constexpr uint32_t MAX_TRACKED_ATTACHMENTS = 8;
+
+        struct DynamicStateCache {
+            std::optional<vk::Viewport>          viewport;
+            std::optional<vk::Rect2D>            scissor;
+            std::optional<vk::CullModeFlags>     cull_mode;
+            std::optional<vk::FrontFace>         front_face;
+            std::optional<vk::PrimitiveTopology> topology;
+            std::optional<bool>                  primitive_restart_enable;
+            std::optional<bool>                  rasterizer_discard_enable;
+            std::optional<bool>                  depth_bias_enable;
+            std::optional<DepthBias>             depth_bias;
+            std::optional<vk::PolygonMode>       polygon_mode;
+            std::optional<bool>                  depth_clamp_enable;
+            std::optional<bool>                  depth_test_enable;
+            std::optional<bool>                  depth_write_enable;
+            std::optional<vk::CompareOp>         depth_compare_op;
+            std::optional<bool>                  stencil_test_enable;
+            std::optional<StencilTest>           stencil_test;
+
+            std::array<std::optional<ColorBlendAttachment>, MAX_TRACKED_ATTACHMENTS> color_blend;
+
+            // only set with shader objects
+            std::optional<size_t>                  vertex_input; // a hash of the bindings, copying them would allocate for every new renderer
+            std::optional<float>                   line_width;
+            std::optional<vk::SampleCountFlagBits> rasterization_samples;
+            std::optional<bool>                    alpha_to_coverage_enable;
+            std::optional<bool>                    depth_bounds_test_enable;
+        };
+
+        // task and mesh last, so they can be left out on devices without mesh shaders
+        static constexpr std::array SHADER_OBJECT_STAGES = {
+            vk::ShaderStageFlagBits::eVertex,   vk::ShaderStageFlagBits::eTessellationControl, vk::ShaderStageFlagBits::eTessellationEvaluation,
+            vk::ShaderStageFlagBits::eGeometry, vk::ShaderStageFlagBits::eFragment,               vk::ShaderStageFlagBits::eTaskEXT,
+            vk::ShaderStageFlagBits::eMeshEXT,
+        };
+
         vk::CommandBuffer cmd;
+        size_t            m_shader_object_stage_count; // how much of SHADER_OBJECT_STAGES is bound
+
+        // mutable since every other method here is const too
+        mutable vk::Pipeline                                           m_bound_pipeline;
+        mutable std::array<vk::ShaderEXT, SHADER_OBJECT_STAGES.size()> m_bound_shaders;
+        mutable bool                                                   m_using_shader_objects = false;
+        mutable DynamicStateCache                                      m_dynamic_state;
     };
 
     class SimpleRenderer {
       public:
-        void render(const vk::CommandBuffer &cmd, vk::ImageView view, const vk::Rect2D &render_area, const std::function<void(ActiveRenderer &&)> &f) const;
+        SimpleRenderer() = default;
+
+        // the renderers it hands out are created with features, see ActiveRenderer's constructor
+        explicit SimpleRenderer(const DeviceFeatures &features) : m_features(features) {}
+
+        void render(const vk::CommandBuffer &cmd, vk::ImageView view, const vk::Rect2D &render_area, function_ref<void(ActiveRenderer &&)> f) const;
 
         [[nodiscard]] glm::vec4 clear_color() const { return m_clear_color; }
 
         void set_clear_color(const glm::vec4 &clear_color) { m_clear_color = clear_color; }
 
       private:
-        glm::vec4 m_clear_color = {0.0f, 0.0f, 0.0f, 1.0f};
+        DeviceFeatures m_features;
+        glm::vec4      m_clear_color = {0.0f, 0.0f, 0.0f, 1.0f};
     };
 } // namespace vke
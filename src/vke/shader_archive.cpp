@@ -0,0 +1,102 @@
+#include "shader_archive.hpp"
+
+#include <algorithm>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+namespace vke {
+    static std::optional<std::filesystem::path> executable_directory() {
+#ifdef _WIN32
+        std::wstring path(MAX_PATH, L'\0');
+        const DWORD  length = GetModuleFileNameW(nullptr, path.data(), static_cast<DWORD>(path.size()));
+        if (length == 0 || length == path.size())
+            return std::nullopt;
+
+        path.resize(length);
+        return std::filesystem::path(path).parent_path();
+#elif defined(__linux__)
+        std::error_code error;
+        const auto      path = std::filesystem::read_symlink("/proc/self/exe", error);
+        if (error)
+            return std::nullopt;
+
+        return path.parent_path();
+#else
+        return std::nullopt;
+#endif
+    }
+
+    std::filesystem::path ShaderArchive::locate(const std::filesystem::path &fallback) {
+        const std::filesystem::path name = fallback.filename();
+
+        std::error_code error;
+        if (std::filesystem::is_regular_file(name, error))
+            return name;
+
+        if (const auto directory = executable_directory(); directory.has_value() && std::filesystem::is_regular_file(*directory / name, error))
+            return *directory / name;
+
+        return fallback;
+    }
+
+    ShaderArchive::ShaderArchive(const std::filesystem::path &path) : m_file(path) {
+        if (m_file.size() < sizeof(ShaderArchiveHeader)) {
+            throw std::runtime_error(path.string() + " is too small to be a shader archive.");
+        }
+
+        const auto &header = *reinterpret_cast<const ShaderArchiveHeader *>(m_file.data());
+        if (header.magic != SHADER_ARCHIVE_MAGIC || header.version != SHADER_ARCHIVE_VERSION) {
+            throw std::runtime_error(path.string() + " is not a supported shader archive.");
+        }
+
+        const uint64_t table_size = static_cast<uint64_t>(header.entry_count) * sizeof(ShaderArchiveEntry);
+        if (header.file_size != m_file.size() || header.entry_table_offset % alignof(ShaderArchiveEntry) != 0 || header.entry_table_offset > m_file.size() ||
+            table_size > m_file.size() - header.entry_table_offset) {
+            throw std::runtime_error(path.string() + " is truncated.");
+        }
+
+        m_entries = {reinterpret_cast<const ShaderArchiveEntry *>(m_file.data() + header.entry_table_offset), header.entry_count};
+        for (const auto &entry : m_entries) {
+            if (static_cast<uint64_t>(entry.name_offset) + entry.name_size > m_file.size() || entry.code_offset % sizeof(uint32_t) != 0 || entry.code_offset > m_file.size() ||
+                entry.code_size > m_file.size() - entry.code_offset) {
+                throw std::runtime_error(path.string() + " has a corrupt entry.");
+            }
+        }
+    }
+
+    std::optional<uint32_t> ShaderArchive::find(const std::string_view name) const {
+        // the tool sorts entries by name
+        const auto it = std::ranges::lower_bound(m_entries, name, {}, [this](const ShaderArchiveEntry &entry) {
+            return std::string_view(reinterpret_cast<const char *>(m_file.data() + entry.name_offset), entry.name_size);
+        });
+
+        if (it == m_entries.end() || this->name(static_cast<uint32_t>(it - m_entries.begin())) != name)
+            return std::nullopt;
+
+        return static_cast<uint32_t>(it - m_entries.begin());
+    }
+
+    std::string_view ShaderArchive::name(const uint32_t index) const {
+        const auto &entry = m_entries[index];
+        return {reinterpret_cast<const char *>(m_file.data() + entry.name_offset), entry.name_size};
+    }
+
+    std::span<const uint32_t> ShaderArchive::code(const uint32_t index) const {
+        const auto &entry = m_entries[index];
+        return {reinterpret_cast<const uint32_t *>(m_file.data() + entry.code_offset), entry.code_size / sizeof(uint32_t)};
+    }
+
+    vk::ShaderModule ShaderArchive::create_module(const vk::Device device, const std::string_view name) const {
+        const auto index = find(name);
+        if (!index.has_value()) {
+            throw std::runtime_error("The shader archive doesn't contain " + std::string(name) + ".");
+        }
+
+        const auto words = code(index.value());
+        return device.createShaderModule(vk::ShaderModuleCreateInfo({}, words.size_bytes(), words.data()));
+    }
+} // namespace vke
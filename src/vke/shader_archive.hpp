@@ -0,0 +1,44 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string_view>
+
+#include "vke/mapped_file.hpp"
+#include "vke/shader_archive_format.hpp"
+
+namespace vke {
+    // memory mapped archive of precompiled spirv, built by the shaders target. shaders are looked up by file name (ie. "shader.vert").
+    class ShaderArchive {
+      public:
+        explicit ShaderArchive(const std::filesystem::path &path);
+
+        /**
+         * @brief Finds an archive by file name, the same way res/ is found: in the working directory first, then next to the executable.
+         *
+         * Returns fallback (ie. the build tree path) if neither has it.
+         */
+        [[nodiscard]] static std::filesystem::path locate(const std::filesystem::path &fallback);
+
+        [[nodiscard]] uint32_t size() const { return static_cast<uint32_t>(m_entries.size()); }
+
+        [[nodiscard]] std::optional<uint32_t> find(std::string_view name) const;
+
+        [[nodiscard]] std::string_view name(uint32_t index) const;
+
+        [[nodiscard]] vk::ShaderStageFlagBits stage(const uint32_t index) const { return static_cast<vk::ShaderStageFlagBits>(m_entries[index].stage); }
+
+        // points straight into the mapping
+        [[nodiscard]] std::span<const uint32_t> code(uint32_t index) const;
+
+        // throws if the archive doesn't contain the shader
+        [[nodiscard]] vk::ShaderModule create_module(vk::Device device, std::string_view name) const;
+
+      private:
+        MappedFile                          m_file;
+        std::span<const ShaderArchiveEntry> m_entries;
+    };
+} // namespace vke
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+
+namespace vke {
+    /*
+     * shader archive layout (little endian), shared by ShaderArchive and the shader_pack build tool:
+     *
+     * ShaderArchiveHeader
+     * ShaderArchiveEntry[entry_count] (sorted by name)
+     * names (not null terminated)
+     * spirv blobs, each aligned to SHADER_ARCHIVE_ALIGNMENT
+     *
+     * this header is deliberately free of vulkan so the tool can build without it.
+     */
+
+    static constexpr uint32_t SHADER_ARCHIVE_MAGIC     = 0x41534b56; // "VKSA"
+    static constexpr uint32_t SHADER_ARCHIVE_VERSION   = 1;
+    static constexpr uint64_t SHADER_ARCHIVE_ALIGNMENT = 16;
+
+    struct ShaderArchiveHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t entry_count;
+        uint32_t reserved;
+        uint64_t entry_table_offset;
+        uint64_t file_size;
+    };
+
+    struct ShaderArchiveEntry {
+        uint32_t name_offset;
+        uint32_t name_size;
+        uint32_t stage; // VkShaderStageFlagBits, 0 if the tool couldn't tell from the file extension
+        uint32_t reserved;
+        uint64_t code_offset;
+        uint64_t code_size; // in bytes
+    };
+} // namespace vke
@@ -0,0 +1,82 @@
+#include "shader_cache.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+
+#include "vke/util.hpp"
+
+namespace vke {
+    ShaderVariantKey &ShaderVariantKey::define(const std::string &name, const std::string &value) {
+        const auto it = std::ranges::lower_bound(defines, name, {}, &std::pair<std::string, std::string>::first);
+        if (it != defines.end() && it->first == name) {
+            it->second = value;
+        } else {
+            defines.emplace(it, name, value);
+        }
+
+        return *this;
+    }
+
+    ShaderCache::ShaderCache(const std::shared_ptr<RenderContext> &rc, ShaderCompileOptions base_options) : m_rc(rc), m_base_options(std::move(base_options)) {}
+
+    ShaderCache::~ShaderCache() {
+        clear();
+    }
+
+    ShaderStage ShaderCache::stage(const ShaderVariantKey &key) {
+        return ShaderStage{key.stage, key.entry_point, module(key), key.specialization};
+    }
+
+    vk::ShaderModule ShaderCache::module(const ShaderVariantKey &key) {
+        ModuleKey module_key{key.path.lexically_normal().string(), key.stage, key.defines};
+
+        {
+            std::lock_guard lock(m_mutex);
+            if (const auto it = m_modules.find(module_key); it != m_modules.end())
+                return it->second;
+        }
+
+        // compile without holding the lock so other variants aren't stuck behind this one
+        ShaderCompileOptions options = m_base_options;
+        options.stage                = key.stage;
+        options.defines.insert(options.defines.end(), key.defines.begin(), key.defines.end());
+
+        spdlog::debug("Compiling shader variant {} ({} defines)", module_key.path, key.defines.size());
+        const vk::ShaderModule module = m_rc->load_spirv_shader(compile_glsl_to_spirv(read_text_file(key.path), module_key.path, options));
+
+        std::lock_guard lock(m_mutex);
+        const auto [it, inserted] = m_modules.emplace(std::move(module_key), module);
+        if (!inserted) {
+            // another thread compiled the same variant first
+            m_rc->device().destroy(module);
+        }
+
+        return it->second;
+    }
+
+    void ShaderCache::clear() {
+        std::lock_guard lock(m_mutex);
+        for (const auto &module : m_modules | std::views::values) {
+            m_rc->device().destroy(module);
+        }
+        m_modules.clear();
+    }
+
+    size_t ShaderCache::module_count() const {
+        std::lock_guard lock(m_mutex);
+        return m_modules.size();
+    }
+
+    size_t ShaderCache::ModuleKeyHash::operator()(const ModuleKey &key) const {
+        size_t seed = 0;
+        hash_combine(seed, key.path);
+        hash_combine(seed, static_cast<uint32_t>(key.stage));
+        for (const auto &[name, value] : key.defines) {
+            hash_combine(seed, name);
+            hash_combine(seed, value);
+        }
+
+        return seed;
+    }
+} // namespace vke
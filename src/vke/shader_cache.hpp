@@ -0,0 +1,84 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "vke/render_context.hpp"
+#include "vke/renderer.hpp"
+#include "vke/shader_compiler.hpp"
+
+namespace vke {
+    /**
+     * @brief Identifies one permutation of a shader: its source, macros and specialization constant values.
+     *
+     * Macros change the source, so each set of them gets its own module. Specialization constants are applied when the pipeline is created, so variants which only differ by
+     * those share a module, but the driver still compiles the constants in (and drops branches on them).
+     */
+    struct ShaderVariantKey {
+        std::filesystem::path   path;
+        vk::ShaderStageFlagBits stage;
+        std::string             entry_point = "main";
+
+        std::vector<std::pair<std::string, std::string>> defines; // sorted by name, use define to keep it that way
+        SpecializationConstants                          specialization;
+
+        ShaderVariantKey &define(const std::string &name, const std::string &value = "");
+
+        template <typename T>
+        ShaderVariantKey &specialize(const uint32_t constant_id, const T &value) {
+            specialization.set(constant_id, value);
+            return *this;
+        }
+
+        bool operator==(const ShaderVariantKey &other) const = default;
+    };
+
+    // compiles shader variants on demand and keeps their modules around. this is thread safe.
+    class ShaderCache {
+      public:
+        // base_options.defines are applied to every variant, before the variant's own
+        explicit ShaderCache(const std::shared_ptr<RenderContext> &rc, ShaderCompileOptions base_options = {});
+        ~ShaderCache();
+
+        ShaderCache(const ShaderCache &other)                = delete;
+        ShaderCache &operator=(const ShaderCache &other)     = delete;
+        ShaderCache(ShaderCache &&other) noexcept            = delete;
+        ShaderCache &operator=(ShaderCache &&other) noexcept = delete;
+
+        // ready to go in GraphicsPipelineBuilder::stages
+        [[nodiscard]] ShaderStage stage(const ShaderVariantKey &key);
+
+        [[nodiscard]] vk::ShaderModule module(const ShaderVariantKey &key);
+
+        // pipelines don't need their modules once they've been created, so this is safe as long as no pipelines are being created from them
+        void clear();
+
+        [[nodiscard]] size_t module_count() const;
+
+      private:
+        struct ModuleKey {
+            std::string                                      path;
+            vk::ShaderStageFlagBits                          stage;
+            std::vector<std::pair<std::string, std::string>> defines;
+
+            bool operator==(const ModuleKey &other) const = default;
+        };
+
+        struct ModuleKeyHash {
+            size_t operator()(const ModuleKey &key) const;
+        };
+
+        std::shared_ptr<RenderContext> m_rc;
+        ShaderCompileOptions           m_base_options;
+
+        mutable std::mutex                                             m_mutex;
+        std::unordered_map<ModuleKey, vk::ShaderModule, ModuleKeyHash> m_modules;
+    };
+} // namespace vke
@@ -0,0 +1,143 @@
+#include "shader_compiler.hpp"
+
+#ifdef VKE_RUNTIME_SHADER_COMPILER
+#include <shaderc/shaderc.hpp>
+#endif
+#include <spdlog/spdlog.h>
+
+#include <fstream>
+#include <sstream>
+
+namespace vke {
+#ifdef VKE_RUNTIME_SHADER_COMPILER
+    // resolves #include relative to the including file first, then through the include directories
+    class FileIncluder final : public shaderc::CompileOptions::IncluderInterface {
+      public:
+        explicit FileIncluder(std::vector<std::filesystem::path> include_directories) : m_include_directories(std::move(include_directories)) {};
+
+        shaderc_include_result *GetInclude(const char *requested_source, const shaderc_include_type type, const char *requesting_source, size_t) override {
+            auto *include = new Include{};
+
+            // an empty name tells shaderc the include failed, with the content as the error message. exceptions can't be thrown through shaderc.
+            if (const auto path = resolve(requested_source, type, requesting_source); path.has_value()) {
+                try {
+                    include->content = read_text_file(path.value());
+                    include->name    = path->string();
+                } catch (const std::exception &e) {
+                    include->content = e.what();
+                }
+            } else {
+                include->content = std::string("Couldn't find ") + requested_source;
+            }
+
+            include->result = {include->name.c_str(), include->name.size(), include->content.c_str(), include->content.size(), include};
+            return &include->result;
+        }
+
+        void ReleaseInclude(shaderc_include_result *data) override { delete static_cast<Include *>(data->user_data); }
+
+      private:
+        struct Include {
+            std::string            name;
+            std::string            content;
+            shaderc_include_result result;
+        };
+
+        std::vector<std::filesystem::path> m_include_directories;
+
+        [[nodiscard]] std::optional<std::filesystem::path> resolve(const std::filesystem::path &requested, const shaderc_include_type type,
+                                                                   const std::filesystem::path &requesting) const {
+            if (type == shaderc_include_type_relative) {
+                auto path = requesting.parent_path() / requested;
+                if (std::filesystem::exists(path))
+                    return path;
+            }
+
+            for (const auto &directory : m_include_directories) {
+                auto path = directory / requested;
+                if (std::filesystem::exists(path))
+                    return path;
+            }
+
+            return std::nullopt;
+        }
+    };
+
+    static shaderc_shader_kind default_shader_kind(const std::optional<vk::ShaderStageFlagBits> stage) {
+        if (!stage.has_value())
+            return shaderc_glsl_infer_from_source;
+
+        switch (stage.value()) {
+        case vk::ShaderStageFlagBits::eVertex:
+            return shaderc_glsl_default_vertex_shader;
+        case vk::ShaderStageFlagBits::eTessellationControl:
+            return shaderc_glsl_default_tess_control_shader;
+        case vk::ShaderStageFlagBits::eTessellationEvaluation:
+            return shaderc_glsl_default_tess_evaluation_shader;
+        case vk::ShaderStageFlagBits::eGeometry:
+            return shaderc_glsl_default_geometry_shader;
+        case vk::ShaderStageFlagBits::eFragment:
+            return shaderc_glsl_default_fragment_shader;
+        case vk::ShaderStageFlagBits::eCompute:
+            return shaderc_glsl_default_compute_shader;
+        case vk::ShaderStageFlagBits::eTaskEXT:
+            return shaderc_glsl_default_task_shader;
+        case vk::ShaderStageFlagBits::eMeshEXT:
+            return shaderc_glsl_default_mesh_shader;
+        default:
+            return shaderc_glsl_infer_from_source;
+        }
+    }
+
+    std::vector<uint32_t> compile_glsl_to_spirv(const std::string &source, const std::string &filename, const ShaderCompileOptions &options) {
+        const shaderc::Compiler compiler;
+        shaderc::CompileOptions compile_options;
+
+        compile_options.SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_3);
+        switch (options.optimization) {
+        case ShaderOptimization::None:
+            compile_options.SetOptimizationLevel(shaderc_optimization_level_zero);
+            break;
+        case ShaderOptimization::Size:
+            compile_options.SetOptimizationLevel(shaderc_optimization_level_size);
+            break;
+        case ShaderOptimization::Performance:
+            compile_options.SetOptimizationLevel(shaderc_optimization_level_performance);
+            break;
+        }
+
+        if (options.debug_info) {
+            compile_options.SetGenerateDebugInfo();
+        }
+
+        for (const auto &[name, value] : options.defines) {
+            compile_options.AddMacroDefinition(name, value);
+        }
+
+        compile_options.SetIncluder(std::make_unique<FileIncluder>(options.include_directories));
+
+        const auto result = compiler.CompileGlslToSpv(source, default_shader_kind(options.stage), filename.c_str(), compile_options);
+        if (result.GetCompilationStatus() != shaderc_compilation_status_success) {
+            spdlog::critical("Failed to compiler shader: {}", result.GetErrorMessage());
+            throw std::runtime_error("Failed to compile shader.");
+        }
+
+        return {result.cbegin(), result.cend()};
+    }
+#else
+    std::vector<uint32_t> compile_glsl_to_spirv(const std::string &, const std::string &filename, const ShaderCompileOptions &) {
+        throw std::runtime_error("Can't compile " + filename + ", this build has no runtime shader compiler (see VKE_RUNTIME_SHADER_COMPILER).");
+    }
+#endif
+
+    std::string read_text_file(const std::filesystem::path &path) {
+        std::ifstream f(path, std::ios::in);
+        if (!f.is_open()) {
+            throw std::runtime_error("Failed to open file '" + path.string() + "'.");
+        }
+
+        std::stringstream ss;
+        ss << f.rdbuf();
+        return ss.str();
+    }
+} // namespace vke
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace vke {
+    enum class ShaderOptimization {
+        None,
+        Size,
+        Performance,
+    };
+
+    struct ShaderCompileOptions {
+        ShaderOptimization optimization = ShaderOptimization::Performance;
+        bool               debug_info   = false;
+
+        // searched for <> includes, and for "" includes which aren't next to the including file
+        std::vector<std::filesystem::path> include_directories;
+
+        // name, value. an empty value just defines the macro.
+        std::vector<std::pair<std::string, std::string>> defines;
+
+        // only used if the source has no #pragma shader_stage
+        std::optional<vk::ShaderStageFlagBits> stage;
+    };
+
+    // throws if the build has no runtime compiler (VKE_RUNTIME_SHADER_COMPILER off), shaders should come from the prebuilt archive then
+    [[nodiscard]] std::vector<uint32_t> compile_glsl_to_spirv(const std::string &source, const std::string &filename, const ShaderCompileOptions &options = {});
+
+    [[nodiscard]] std::string read_text_file(const std::filesystem::path &path);
+} // namespace vke
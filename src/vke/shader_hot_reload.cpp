@@ -0,0 +1,253 @@
+#include "shader_hot_reload.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+#include <unordered_set>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+using namespace std::chrono_literals;
+
+namespace vke {
+    ShaderHotReloader::ShaderHotReloader(const std::shared_ptr<RenderContext> &rc, ShaderCompileOptions base_options) : m_rc(rc), m_base_options(std::move(base_options)) {
+#ifdef __linux__
+        m_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (m_inotify < 0) {
+            throw std::runtime_error("Failed to initialize inotify.");
+        }
+#endif
+
+        m_thread = std::jthread([this](const std::stop_token &stop) { run(stop); });
+    }
+
+    ShaderHotReloader::~ShaderHotReloader() {
+        m_thread.request_stop();
+        m_thread.join();
+
+        // none of these were ever used by a frame, and pipelines don't need their modules once created
+        m_rebuilt.clear();
+        for (const auto &watched : m_watched) {
+            for (const auto &module : watched->owned_modules) {
+                if (module)
+                    m_rc->device().destroy(module);
+            }
+        }
+
+#ifdef __linux__
+        close(m_inotify);
+#endif
+    }
+
+    std::shared_ptr<ReloadablePipeline> ShaderHotReloader::watch(const GraphicsPipelineBuilder &builder, const std::vector<std::filesystem::path> &sources,
+                                                                 std::shared_ptr<GraphicsPipeline> pipeline) {
+        if (sources.size() != builder.stages.size()) {
+            throw std::runtime_error("Hot reloaded pipelines need a source path (or an empty one) for every stage.");
+        }
+
+        if (!pipeline)
+            pipeline = std::make_shared<GraphicsPipeline>(m_rc->device(), builder);
+
+        auto reloadable = std::make_shared<ReloadablePipeline>(std::move(pipeline));
+
+        auto watched           = std::make_shared<Watched>();
+        watched->pipeline      = reloadable;
+        watched->builder       = builder;
+        watched->owned_modules = std::vector<vk::ShaderModule>(builder.stages.size());
+        for (const auto &source : sources) {
+            watched->sources.push_back(source.empty() ? source : std::filesystem::absolute(source).lexically_normal());
+        }
+
+        std::lock_guard lock(m_watched_mutex);
+#ifdef __linux__
+        // directories are watched rather than the files, since a lot of editors save by replacing the file
+        for (const auto &source : watched->sources) {
+            if (source.empty())
+                continue;
+
+            const int wd = inotify_add_watch(m_inotify, source.parent_path().c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+            if (wd < 0) {
+                spdlog::warn("Can't watch {} for shader changes.", source.parent_path().string());
+                continue;
+            }
+
+            m_watch_directories[wd] = source.parent_path();
+        }
+#endif
+        m_watched.push_back(std::move(watched));
+
+        return reloadable;
+    }
+
+    void ShaderHotReloader::update() {
+        std::vector<Rebuilt> rebuilt;
+        {
+            std::lock_guard lock(m_rebuilt_mutex);
+            rebuilt.swap(m_rebuilt);
+        }
+
+        for (auto &[target, pipeline] : rebuilt) {
+            auto old = target->replace(std::move(pipeline));
+
+            // frames in flight may still be using the old pipeline
+            m_rc->defer_destruction([old = std::move(old)]() mutable { old.reset(); });
+        }
+    }
+
+    void ShaderHotReloader::run(const std::stop_token &stop) {
+        while (!stop.stop_requested()) {
+            const auto changed = wait_for_changes(stop);
+            if (changed.empty())
+                continue;
+
+            std::vector<std::shared_ptr<Watched>> watched;
+            {
+                std::lock_guard lock(m_watched_mutex);
+
+                // forget pipelines nobody holds anymore
+                std::erase_if(m_watched, [this](const std::shared_ptr<Watched> &w) {
+                    if (!w->pipeline.expired())
+                        return false;
+
+                    for (const auto &module : w->owned_modules) {
+                        if (module)
+                            m_rc->device().destroy(module);
+                    }
+                    return true;
+                });
+
+                watched = m_watched;
+            }
+
+            for (const auto &w : watched) {
+                rebuild(*w, changed);
+            }
+        }
+    }
+
+#ifdef __linux__
+    std::vector<std::filesystem::path> ShaderHotReloader::wait_for_changes(const std::stop_token &stop) {
+        pollfd fd{m_inotify, POLLIN, 0};
+        if (poll(&fd, 1, 100) <= 0 || stop.stop_requested())
+            return {};
+
+        std::unordered_set<std::string> changed;
+        const auto                      drain = [&] {
+            alignas(inotify_event) char buffer[4096];
+            ssize_t                     size;
+            while ((size = read(m_inotify, buffer, sizeof(buffer))) > 0) {
+                std::lock_guard lock(m_watched_mutex);
+                for (ssize_t offset = 0; offset < size;) {
+                    const auto *event = reinterpret_cast<const inotify_event *>(buffer + offset);
+                    if (const auto it = m_watch_directories.find(event->wd); it != m_watch_directories.end() && event->len > 0) {
+                        changed.insert((it->second / event->name).string());
+                    }
+
+                    offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+                }
+            }
+        };
+
+        drain();
+
+        // editors tend to save in a few steps, give them a moment so we don't compile a half written file
+        std::this_thread::sleep_for(50ms);
+        drain();
+
+        return {changed.begin(), changed.end()};
+    }
+#else
+    std::vector<std::filesystem::path> ShaderHotReloader::wait_for_changes(const std::stop_token &stop) {
+        std::this_thread::sleep_for(250ms);
+        if (stop.stop_requested())
+            return {};
+
+        std::vector<std::filesystem::path> sources;
+        {
+            std::lock_guard lock(m_watched_mutex);
+            for (const auto &watched : m_watched) {
+                std::ranges::copy_if(watched->sources, std::back_inserter(sources), [](const auto &source) { return !source.empty(); });
+            }
+        }
+
+        std::vector<std::filesystem::path> changed;
+        for (const auto &source : sources) {
+            std::error_code ec;
+            const auto      write_time = std::filesystem::last_write_time(source, ec);
+            if (ec)
+                continue;
+
+            // the first time a file is seen just records its time
+            const auto [it, inserted] = m_write_times.try_emplace(source.string(), write_time);
+            if (!inserted && it->second != write_time) {
+                it->second = write_time;
+                changed.push_back(source);
+            }
+        }
+
+        return changed;
+    }
+#endif
+
+    void ShaderHotReloader::rebuild(Watched &watched, const std::vector<std::filesystem::path> &changed) {
+        const auto target = watched.pipeline.lock();
+        if (!target)
+            return;
+
+        GraphicsPipelineBuilder       builder = watched.builder;
+        std::vector<vk::ShaderModule> compiled(builder.stages.size());
+        const auto                    destroy_compiled = [&] {
+            for (const auto &module : compiled) {
+                if (module)
+                    m_rc->device().destroy(module);
+            }
+        };
+
+        std::shared_ptr<GraphicsPipeline> pipeline;
+        try {
+            for (size_t i = 0; i < builder.stages.size(); i++) {
+                const auto &source = watched.sources[i];
+                if (source.empty() || std::ranges::find(changed, source) == changed.end())
+                    continue;
+
+                spdlog::info("Reloading shader {}", source.string());
+
+                ShaderCompileOptions options = m_base_options;
+                options.stage                = builder.stages[i].stage;
+
+                compiled[i]              = m_rc->load_spirv_shader(compile_glsl_to_spirv(read_text_file(source), source.string(), options));
+                builder.stages[i].module = compiled[i];
+            }
+
+            if (std::ranges::none_of(compiled, [](const vk::ShaderModule module) { return static_cast<bool>(module); }))
+                return;
+
+            pipeline = std::make_shared<GraphicsPipeline>(m_rc->device(), builder);
+        } catch (const std::exception &e) {
+            spdlog::error("Shader reload failed, keeping the old pipeline: {}", e.what());
+            destroy_compiled();
+            return;
+        }
+
+        // the new modules become the base for the next reload of this pipeline
+        for (size_t i = 0; i < compiled.size(); i++) {
+            if (!compiled[i])
+                continue;
+
+            if (watched.owned_modules[i])
+                m_rc->device().destroy(watched.owned_modules[i]);
+
+            watched.owned_modules[i]         = compiled[i];
+            watched.builder.stages[i].module = compiled[i];
+        }
+
+        std::lock_guard lock(m_rebuilt_mutex);
+        m_rebuilt.push_back(Rebuilt{target, std::move(pipeline)});
+    }
+} // namespace vke
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "vke/render_context.hpp"
+#include "vke/renderer.hpp"
+#include "vke/shader_compiler.hpp"
+
+namespace vke {
+    /**
+     * @brief Watches GLSL sources and rebuilds the pipelines using them when they change on disk.
+     *
+     * Watching, compiling and pipeline creation all happen on a background thread. Finished pipelines wait until update is called (once per frame, before recording) to be
+     * swapped in, and the old ones are retired through RenderContext::defer_destruction once no frame in flight can still use them. A shader which fails to compile is logged and
+     * the pipeline keeps running the last good version.
+     *
+     * Uses inotify on linux and polls modification times elsewhere. Only the listed files are watched, editing an #include doesn't trigger a reload.
+     */
+    class ShaderHotReloader {
+      public:
+        explicit ShaderHotReloader(const std::shared_ptr<RenderContext> &rc, ShaderCompileOptions base_options = {});
+        ~ShaderHotReloader();
+
+        ShaderHotReloader(const ShaderHotReloader &other)                = delete;
+        ShaderHotReloader &operator=(const ShaderHotReloader &other)     = delete;
+        ShaderHotReloader(ShaderHotReloader &&other) noexcept            = delete;
+        ShaderHotReloader &operator=(ShaderHotReloader &&other) noexcept = delete;
+
+        /**
+         * @param builder the builder the pipeline was (or will be) created from, it's kept to rebuild the pipeline
+         * @param sources the GLSL source of each of builder.stages, an empty path leaves that stage alone
+         * @param pipeline the current pipeline, created from builder if null
+         */
+        [[nodiscard]] std::shared_ptr<ReloadablePipeline> watch(const GraphicsPipelineBuilder &builder, const std::vector<std::filesystem::path> &sources,
+                                                                std::shared_ptr<GraphicsPipeline> pipeline = nullptr);
+
+        // swaps in rebuilt pipelines. call this at a frame boundary, it never waits on the background thread.
+        void update();
+
+      private:
+        struct Watched {
+            std::weak_ptr<ReloadablePipeline>  pipeline;
+            GraphicsPipelineBuilder            builder;
+            std::vector<std::filesystem::path> sources;
+            std::vector<vk::ShaderModule>      owned_modules; // modules compiled by the reloader, per stage
+        };
+
+        struct Rebuilt {
+            std::shared_ptr<ReloadablePipeline> target;
+            std::shared_ptr<GraphicsPipeline>   pipeline;
+        };
+
+        std::shared_ptr<RenderContext> m_rc;
+        ShaderCompileOptions           m_base_options;
+
+        std::mutex                            m_watched_mutex;
+        std::vector<std::shared_ptr<Watched>> m_watched;
+
+        std::mutex           m_rebuilt_mutex;
+        std::vector<Rebuilt> m_rebuilt;
+
+#ifdef __linux__
+        int                                            m_inotify = -1;
+        std::unordered_map<int, std::filesystem::path> m_watch_directories; // by inotify watch descriptor, guarded by m_watched_mutex
+#else
+        std::unordered_map<std::string, std::filesystem::file_time_type> m_write_times; // only touched by the background thread
+#endif
+
+        std::jthread m_thread;
+
+        void run(const std::stop_token &stop);
+
+        // blocks until something might have changed (or stop is requested), and returns which of the watched files changed
+        std::vector<std::filesystem::path> wait_for_changes(const std::stop_token &stop);
+
+        void rebuild(Watched &watched, const std::vector<std::filesystem::path> &changed);
+    };
+} // namespace vke
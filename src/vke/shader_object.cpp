@@ -0,0 +1,75 @@
+#include "shader_object.hpp"
+
+#include <algorithm>
+#include <array>
+
+namespace vke {
+    ShaderObject::ShaderObject(const vk::Device device, const ShaderObjectSource &source)
+        : ShaderObject(device, create(device, std::span(&source, 1), false).front(), source.info.stage) {}
+
+    ShaderObject::ShaderObject(const RenderContext &rc, const std::filesystem::path &path, const SourceType source_type, const ShaderObjectInfo &info)
+        : m_device(rc.device()), m_stage(info.stage) {
+        ShaderCompileOptions options;
+        options.stage = info.stage;
+
+        const auto code = rc.load_shader_code(path, source_type, options);
+        m_shader        = create(m_device, std::array{ShaderObjectSource{code, info}}, false).front();
+    }
+
+    ShaderObject::ShaderObject(const vk::Device device, const vk::ShaderEXT shader, const vk::ShaderStageFlagBits stage) : m_device(device), m_shader(shader), m_stage(stage) {}
+
+    ShaderObject::~ShaderObject() {
+        m_device.destroyShaderEXT(m_shader);
+    }
+
+    std::vector<std::shared_ptr<ShaderObject>> ShaderObject::create_linked(const vk::Device device, const std::span<const ShaderObjectSource> sources) {
+        const auto shaders = create(device, sources, sources.size() > 1);
+
+        std::vector<std::shared_ptr<ShaderObject>> objects;
+        objects.reserve(shaders.size());
+        for (size_t i = 0; i < shaders.size(); i++) {
+            objects.push_back(std::shared_ptr<ShaderObject>(new ShaderObject(device, shaders[i], sources[i].info.stage)));
+        }
+
+        return objects;
+    }
+
+    std::vector<vk::ShaderEXT> ShaderObject::create(const vk::Device device, const std::span<const ShaderObjectSource> sources, const bool link) {
+        std::vector<vk::ShaderCreateInfoEXT> create_infos;
+        std::vector<vk::SpecializationInfo>  specializations;
+        create_infos.reserve(sources.size());
+        specializations.reserve(sources.size()); // create_infos point into this, so it must not reallocate
+        for (const auto &[code, info] : sources) {
+            auto &create_info = create_infos.emplace_back();
+            create_info.setFlags(link ? vk::ShaderCreateFlagBitsEXT::eLinkStage : vk::ShaderCreateFlagsEXT{});
+            create_info.setStage(info.stage);
+            create_info.setNextStage(info.next_stages);
+            create_info.setCodeType(vk::ShaderCodeTypeEXT::eSpirv);
+            create_info.setCodeSize(code.size_bytes());
+            create_info.setPCode(code.data());
+            create_info.setPName(info.entry_point.c_str());
+            create_info.setSetLayouts(info.set_layouts);
+            create_info.setPushConstantRanges(info.push_constant_ranges);
+            if (!info.specialization.empty()) {
+                create_info.setPSpecializationInfo(&specializations.emplace_back(info.specialization.info()));
+            }
+        }
+
+        // through the c api, since the return type of vk::Device::createShadersEXT differs between vulkan-hpp versions
+        std::vector<vk::ShaderEXT> shaders(create_infos.size());
+        const auto                 result = static_cast<vk::Result>(VULKAN_HPP_DEFAULT_DISPATCHER.vkCreateShadersEXT(
+            device, static_cast<uint32_t>(create_infos.size()), reinterpret_cast<const VkShaderCreateInfoEXT *>(create_infos.data()), nullptr,
+            reinterpret_cast<VkShaderEXT *>(shaders.data())));
+
+        if (result != vk::Result::eSuccess) {
+            for (const auto shader : shaders) {
+                if (shader)
+                    device.destroyShaderEXT(shader);
+            }
+
+            throw std::runtime_error("Failed to create shader objects (" + vk::to_string(result) + ").");
+        }
+
+        return shaders;
+    }
+} // namespace vke
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "vke/render_context.hpp"
+#include "vke/renderer.hpp"
+
+namespace vke {
+    struct ShaderObjectInfo {
+        vk::ShaderStageFlagBits stage;
+        vk::ShaderStageFlags    next_stages; // which stages may be bound after this one, ie. fragment for a vertex shader
+        std::string             entry_point = "main";
+        SpecializationConstants specialization;
+
+        // has to match the layout descriptor sets and push constants are bound with, like a pipeline's
+        std::vector<vk::DescriptorSetLayout> set_layouts;
+        std::vector<vk::PushConstantRange>   push_constant_ranges;
+    };
+
+    struct ShaderObjectSource {
+        std::span<const uint32_t> code;
+        ShaderObjectInfo          info;
+    };
+
+    /**
+     * @brief A single shader stage (VK_EXT_shader_object), bound on its own without a pipeline. Needs DeviceFeatures::shader_object.
+     *
+     * Every bit of render state comes from the command buffer instead, see ActiveRenderer::bind_shaders and ActiveRenderer::set_render_state.
+     */
+    class ShaderObject {
+      public:
+        ShaderObject(vk::Device device, const ShaderObjectSource &source);
+
+        // loads the shader through RenderContext::load_shader_code, compiling glsl for info.stage
+        ShaderObject(const RenderContext &rc, const std::filesystem::path &path, SourceType source_type, const ShaderObjectInfo &info);
+
+        ~ShaderObject();
+
+        ShaderObject(const ShaderObject &other)                = delete;
+        ShaderObject &operator=(const ShaderObject &other)     = delete;
+        ShaderObject(ShaderObject &&other) noexcept            = delete;
+        ShaderObject &operator=(ShaderObject &&other) noexcept = delete;
+
+        // linked shaders are optimized together, like a pipeline, at the cost of always having to be bound together
+        [[nodiscard]] static std::vector<std::shared_ptr<ShaderObject>> create_linked(vk::Device device, std::span<const ShaderObjectSource> sources);
+
+        [[nodiscard]] inline vk::ShaderEXT get() const { return m_shader; }
+
+        [[nodiscard]] inline vk::ShaderStageFlagBits stage() const { return m_stage; }
+
+      private:
+        vk::Device              m_device;
+        vk::ShaderEXT           m_shader;
+        vk::ShaderStageFlagBits m_stage;
+
+        ShaderObject(vk::Device device, vk::ShaderEXT shader, vk::ShaderStageFlagBits stage);
+
+        static std::vector<vk::ShaderEXT> create(vk::Device device, std::span<const ShaderObjectSource> sources, bool link);
+    };
+
+    // everything a draw with shader objects needs besides viewport and scissor, since there's no pipeline to take it from
+    struct ShaderRenderState {
+        std::vector<VertexBufferBinding>  vertex_buffer_bindings;
+        vk::PrimitiveTopology             topology                  = vk::PrimitiveTopology::eTriangleList;
+        bool                              enable_primitive_restart  = false;
+        bool                              discard_rasterizer_output = false;
+        vk::PolygonMode                   polygon_mode              = vk::PolygonMode::eFill;
+        vk::CullModeFlags                 cull_mode                 = vk::CullModeFlagBits::eBack;
+        vk::FrontFace                     front_face                = vk::FrontFace::eClockwise;
+        float                             line_width                = 1.0f;
+        std::optional<DepthBias>          depth_bias                = std::nullopt;
+        vk::SampleCountFlagBits           rasterization_samples     = vk::SampleCountFlagBits::e1;
+        bool                              enable_alpha_to_coverage  = false;
+        std::vector<ColorBlendAttachment> color_blend_attachments;
+        std::optional<DepthTest>          depth_test;   // nullopt for no depth testing or writes
+        std::optional<StencilTest>        stencil_test; // nullopt for no stencil testing
+
+        bool operator==(const ShaderRenderState &other) const = default;
+    };
+} // namespace vke
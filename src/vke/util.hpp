@@ -1,11 +1,40 @@
 #pragma once
 
 #include <concepts>
+#include <functional>
+#include <memory>
 #include <ranges>
+#include <type_traits>
 
 namespace vke {
     template <std::ranges::contiguous_range Range>
     constexpr std::size_t byte_size(Range &&range) {
         return std::ranges::size(range) * sizeof(std::ranges::range_value_t<Range>);
     };
+
+    // boost's hash_combine
+    template <typename T>
+    void hash_combine(std::size_t &seed, const T &value) {
+        seed ^= std::hash<T>{}(value) + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2);
+    }
+
+    template <typename Signature>
+    class function_ref;
+
+    // non-owning reference to a callable, for callbacks which are only called before the function taking them returns. unlike std::function it never allocates.
+    template <typename R, typename... Args>
+    class function_ref<R(Args...)> {
+      public:
+        template <typename F>
+            requires(!std::is_same_v<std::remove_cvref_t<F>, function_ref> && std::is_object_v<std::remove_reference_t<F>> && std::is_invocable_r_v<R, F &, Args...>)
+        function_ref(F &&f) noexcept // NOLINT(*-explicit-constructor)
+            : m_object(const_cast<void *>(static_cast<const void *>(std::addressof(f)))),
+              m_invoke([](void *object, Args... args) -> R { return std::invoke_r<R>(*static_cast<std::remove_reference_t<F> *>(object), std::forward<Args>(args)...); }) {}
+
+        R operator()(Args... args) const { return m_invoke(m_object, std::forward<Args>(args)...); }
+
+      private:
+        void *m_object;
+        R (*m_invoke)(void *object, Args... args);
+    };
 } // namespace vke
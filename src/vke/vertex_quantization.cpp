@@ -0,0 +1,426 @@
+#include "vertex_quantization.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define VKE_QUANTIZE_SSE2
+#include <immintrin.h>
+#endif
+
+// avx2 and f16c are picked at runtime, which needs per function target attributes
+#if defined(VKE_QUANTIZE_SSE2) && (defined(__GNUC__) || defined(__clang__))
+#define VKE_QUANTIZE_AVX2
+#define VKE_TARGET_AVX2 __attribute__((target("avx2,f16c")))
+#endif
+
+namespace vke {
+    // every kernel converts count floats to count 16 bit values, except octahedral which converts count vec3s to count pairs
+    using QuantizeKernel = void (*)(const float *in, uint16_t *out, size_t count);
+
+    struct QuantizeKernels {
+        QuantizeKernel half;
+        QuantizeKernel snorm16;
+        QuantizeKernel unorm16;
+        QuantizeKernel octahedral;
+    };
+
+    // ---- scalar ----
+
+    static uint16_t float_to_half(const float value) {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+
+        const auto     sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+        const uint32_t abs  = bits & 0x7fffffff;
+
+        if (abs >= 0x7f800000) // inf or nan
+            return sign | 0x7c00 | (abs > 0x7f800000 ? 0x0200 : 0);
+        if (abs >= 0x477ff000) // rounds up past 65504
+            return sign | 0x7c00;
+
+        if (abs < 0x38800000) { // denormal (or zero) as a half, 2^24 scales the smallest one to 1
+            float abs_value;
+            std::memcpy(&abs_value, &abs, sizeof(abs_value));
+            return sign | static_cast<uint16_t>(std::nearbyint(abs_value * 16777216.0f));
+        }
+
+        // rebias the exponent and round the mantissa to nearest even
+        const uint32_t rounded = abs + 0x0fff + ((abs >> 13) & 1);
+        return sign | static_cast<uint16_t>((rounded - 0x38000000) >> 13);
+    }
+
+    // these clamp nan to the bottom of the range, same as the sse min/max below
+    static uint16_t float_to_snorm16(const float value) {
+        const float clamped = value > -1.0f ? (value < 1.0f ? value : 1.0f) : -1.0f;
+        return static_cast<uint16_t>(static_cast<int16_t>(std::nearbyint(clamped * 32767.0f)));
+    }
+
+    static uint16_t float_to_unorm16(const float value) {
+        const float clamped = value > 0.0f ? (value < 1.0f ? value : 1.0f) : 0.0f;
+        return static_cast<uint16_t>(std::nearbyint(clamped * 65535.0f));
+    }
+
+    static void encode_octahedral(const float *normal, uint16_t *out) {
+        const float inv = 1.0f / std::max(std::abs(normal[0]) + std::abs(normal[1]) + std::abs(normal[2]), FLT_MIN);
+
+        float x = normal[0] * inv;
+        float y = normal[1] * inv;
+        if (normal[2] < 0.0f) {
+            const float folded_x = (1.0f - std::abs(y)) * std::copysign(1.0f, x);
+            const float folded_y = (1.0f - std::abs(x)) * std::copysign(1.0f, y);
+            x                    = folded_x;
+            y                    = folded_y;
+        }
+
+        out[0] = float_to_snorm16(x);
+        out[1] = float_to_snorm16(y);
+    }
+
+    static void half_scalar(const float *in, uint16_t *out, const size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            out[i] = float_to_half(in[i]);
+        }
+    }
+
+    static void snorm16_scalar(const float *in, uint16_t *out, const size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            out[i] = float_to_snorm16(in[i]);
+        }
+    }
+
+    static void unorm16_scalar(const float *in, uint16_t *out, const size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            out[i] = float_to_unorm16(in[i]);
+        }
+    }
+
+    static void octahedral_scalar(const float *in, uint16_t *out, const size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            encode_octahedral(in + i * 3, out + i * 2);
+        }
+    }
+
+#ifdef VKE_QUANTIZE_SSE2
+    // ---- sse2 ----
+
+    // folds x and y (already divided by |x| + |y| + |z|) into the lower hemisphere where z is negative
+    static void fold_octahedral_sse2(__m128 &x, __m128 &y, const __m128 z) {
+        const __m128 sign_mask = _mm_set1_ps(-0.0f);
+        const __m128 one       = _mm_set1_ps(1.0f);
+
+        const __m128 folded_x = _mm_mul_ps(_mm_sub_ps(one, _mm_andnot_ps(sign_mask, y)), _mm_or_ps(one, _mm_and_ps(x, sign_mask)));
+        const __m128 folded_y = _mm_mul_ps(_mm_sub_ps(one, _mm_andnot_ps(sign_mask, x)), _mm_or_ps(one, _mm_and_ps(y, sign_mask)));
+
+        const __m128 lower = _mm_cmplt_ps(z, _mm_setzero_ps());
+        x                  = _mm_or_ps(_mm_and_ps(lower, folded_x), _mm_andnot_ps(lower, x));
+        y                  = _mm_or_ps(_mm_and_ps(lower, folded_y), _mm_andnot_ps(lower, y));
+    }
+
+    static __m128i snorm16_epi32_sse2(const __m128 value) {
+        const __m128 clamped = _mm_min_ps(_mm_max_ps(value, _mm_set1_ps(-1.0f)), _mm_set1_ps(1.0f));
+        return _mm_cvtps_epi32(_mm_mul_ps(clamped, _mm_set1_ps(32767.0f)));
+    }
+
+    static void snorm16_sse2(const float *in, uint16_t *out, const size_t count) {
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            const __m128i lo = snorm16_epi32_sse2(_mm_loadu_ps(in + i));
+            const __m128i hi = snorm16_epi32_sse2(_mm_loadu_ps(in + i + 4));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_packs_epi32(lo, hi));
+        }
+
+        snorm16_scalar(in + i, out + i, count - i);
+    }
+
+    static void unorm16_sse2(const float *in, uint16_t *out, const size_t count) {
+        const __m128  zero  = _mm_setzero_ps();
+        const __m128  one   = _mm_set1_ps(1.0f);
+        const __m128  scale = _mm_set1_ps(65535.0f);
+        const __m128i bias  = _mm_set1_epi32(32768);
+        const __m128i flip  = _mm_set1_epi16(static_cast<int16_t>(0x8000));
+
+        // sse2 has no unsigned saturating pack, so shift into signed range, pack, and shift back
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            const __m128i lo = _mm_sub_epi32(_mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(in + i), zero), one), scale)), bias);
+            const __m128i hi = _mm_sub_epi32(_mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(in + i + 4), zero), one), scale)), bias);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_xor_si128(_mm_packs_epi32(lo, hi), flip));
+        }
+
+        unorm16_scalar(in + i, out + i, count - i);
+    }
+
+    static void octahedral_sse2(const float *in, uint16_t *out, const size_t count) {
+        const __m128  sign_mask = _mm_set1_ps(-0.0f);
+        const __m128  min_sum   = _mm_set1_ps(FLT_MIN);
+        const __m128i low_half  = _mm_set1_epi32(0xffff);
+
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            const float *n = in + i * 3;
+            __m128       x = _mm_set_ps(n[9], n[6], n[3], n[0]);
+            __m128       y = _mm_set_ps(n[10], n[7], n[4], n[1]);
+            const __m128 z = _mm_set_ps(n[11], n[8], n[5], n[2]);
+
+            const __m128 sum = _mm_add_ps(_mm_add_ps(_mm_andnot_ps(sign_mask, x), _mm_andnot_ps(sign_mask, y)), _mm_andnot_ps(sign_mask, z));
+            const __m128 inv = _mm_div_ps(_mm_set1_ps(1.0f), _mm_max_ps(sum, min_sum));
+            x                = _mm_mul_ps(x, inv);
+            y                = _mm_mul_ps(y, inv);
+            fold_octahedral_sse2(x, y, z);
+
+            // x in the low half and y in the high half of each 32 bits is exactly the interleaved pairs
+            const __m128i packed = _mm_or_si128(_mm_and_si128(snorm16_epi32_sse2(x), low_half), _mm_slli_epi32(snorm16_epi32_sse2(y), 16));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i * 2), packed);
+        }
+
+        octahedral_scalar(in + i * 3, out + i * 2, count - i);
+    }
+#endif
+
+#ifdef VKE_QUANTIZE_AVX2
+    // ---- avx2 / f16c ----
+
+    VKE_TARGET_AVX2 static __m256i snorm16_epi32_avx2(const __m256 value) {
+        const __m256 clamped = _mm256_min_ps(_mm256_max_ps(value, _mm256_set1_ps(-1.0f)), _mm256_set1_ps(1.0f));
+        return _mm256_cvtps_epi32(_mm256_mul_ps(clamped, _mm256_set1_ps(32767.0f)));
+    }
+
+    VKE_TARGET_AVX2 static void half_avx2(const float *in, uint16_t *out, const size_t count) {
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm256_cvtps_ph(_mm256_loadu_ps(in + i), _MM_FROUND_TO_NEAREST_INT));
+        }
+
+        half_scalar(in + i, out + i, count - i);
+    }
+
+    VKE_TARGET_AVX2 static void snorm16_avx2(const float *in, uint16_t *out, const size_t count) {
+        size_t i = 0;
+        for (; i + 16 <= count; i += 16) {
+            const __m256i lo = snorm16_epi32_avx2(_mm256_loadu_ps(in + i));
+            const __m256i hi = snorm16_epi32_avx2(_mm256_loadu_ps(in + i + 8));
+            // packs works per 128 bit lane, so the 64 bit quarters come out as lo0 hi0 lo1 hi1
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi), 0b11011000));
+        }
+
+        snorm16_scalar(in + i, out + i, count - i);
+    }
+
+    VKE_TARGET_AVX2 static void unorm16_avx2(const float *in, uint16_t *out, const size_t count) {
+        const __m256 zero  = _mm256_setzero_ps();
+        const __m256 one   = _mm256_set1_ps(1.0f);
+        const __m256 scale = _mm256_set1_ps(65535.0f);
+
+        size_t i = 0;
+        for (; i + 16 <= count; i += 16) {
+            const __m256i lo = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(in + i), zero), one), scale));
+            const __m256i hi = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(in + i + 8), zero), one), scale));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), _mm256_permute4x64_epi64(_mm256_packus_epi32(lo, hi), 0b11011000));
+        }
+
+        unorm16_scalar(in + i, out + i, count - i);
+    }
+
+    VKE_TARGET_AVX2 static void octahedral_avx2(const float *in, uint16_t *out, const size_t count) {
+        const __m256  sign_mask = _mm256_set1_ps(-0.0f);
+        const __m256  one       = _mm256_set1_ps(1.0f);
+        const __m256  min_sum   = _mm256_set1_ps(FLT_MIN);
+        const __m256i low_half  = _mm256_set1_epi32(0xffff);
+        const __m256i stride    = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            const float *n = in + i * 3;
+            __m256       x = _mm256_i32gather_ps(n, stride, 4);
+            __m256       y = _mm256_i32gather_ps(n + 1, stride, 4);
+            const __m256 z = _mm256_i32gather_ps(n + 2, stride, 4);
+
+            const __m256 sum = _mm256_add_ps(_mm256_add_ps(_mm256_andnot_ps(sign_mask, x), _mm256_andnot_ps(sign_mask, y)), _mm256_andnot_ps(sign_mask, z));
+            const __m256 inv = _mm256_div_ps(one, _mm256_max_ps(sum, min_sum));
+            x                = _mm256_mul_ps(x, inv);
+            y                = _mm256_mul_ps(y, inv);
+
+            const __m256 folded_x = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_andnot_ps(sign_mask, y)), _mm256_or_ps(one, _mm256_and_ps(x, sign_mask)));
+            const __m256 folded_y = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_andnot_ps(sign_mask, x)), _mm256_or_ps(one, _mm256_and_ps(y, sign_mask)));
+            const __m256 lower    = _mm256_cmp_ps(z, _mm256_setzero_ps(), _CMP_LT_OQ);
+            x                     = _mm256_blendv_ps(x, folded_x, lower);
+            y                     = _mm256_blendv_ps(y, folded_y, lower);
+
+            const __m256i packed = _mm256_or_si256(_mm256_and_si256(snorm16_epi32_avx2(x), low_half), _mm256_slli_epi32(snorm16_epi32_avx2(y), 16));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i * 2), packed);
+        }
+
+        octahedral_scalar(in + i * 3, out + i * 2, count - i);
+    }
+#endif
+
+    static QuantizeKernels select_kernels() {
+#ifdef VKE_QUANTIZE_AVX2
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("f16c"))
+            return {half_avx2, snorm16_avx2, unorm16_avx2, octahedral_avx2};
+#endif
+#ifdef VKE_QUANTIZE_SSE2
+        return {half_scalar, snorm16_sse2, unorm16_sse2, octahedral_sse2};
+#else
+        return {half_scalar, snorm16_scalar, unorm16_scalar, octahedral_scalar};
+#endif
+    }
+
+    static const QuantizeKernels &kernels() {
+        static const QuantizeKernels selected = select_kernels();
+        return selected;
+    }
+
+    // components as stored, 16 bit formats are padded to keep 4 byte alignment
+    static uint32_t stored_components(const VertexEncoding encoding, const uint32_t components) {
+        switch (encoding) {
+        case VertexEncoding::Float32:
+            return components;
+        case VertexEncoding::Octahedral:
+            return 2;
+        default:
+            return (components + 1) & ~1u;
+        }
+    }
+
+    static uint32_t component_size(const VertexEncoding encoding) { return encoding == VertexEncoding::Float32 ? 4 : 2; }
+
+    vk::Format quantized_format(const VertexEncoding encoding, const uint32_t components) {
+        static constexpr std::array FLOAT32_FORMATS = {vk::Format::eR32Sfloat, vk::Format::eR32G32Sfloat, vk::Format::eR32G32B32Sfloat, vk::Format::eR32G32B32A32Sfloat};
+        static constexpr std::array HALF_FORMATS    = {vk::Format::eR16G16Sfloat, vk::Format::eR16G16B16A16Sfloat};
+        static constexpr std::array SNORM16_FORMATS = {vk::Format::eR16G16Snorm, vk::Format::eR16G16B16A16Snorm};
+        static constexpr std::array UNORM16_FORMATS = {vk::Format::eR16G16Unorm, vk::Format::eR16G16B16A16Unorm};
+
+        const uint32_t stored = stored_components(encoding, components);
+        switch (encoding) {
+        case VertexEncoding::Float32:
+            return FLOAT32_FORMATS[stored - 1];
+        case VertexEncoding::Half:
+            return HALF_FORMATS[stored / 2 - 1];
+        case VertexEncoding::Snorm16:
+        case VertexEncoding::Octahedral:
+            return SNORM16_FORMATS[stored / 2 - 1];
+        case VertexEncoding::Unorm16:
+            return UNORM16_FORMATS[stored / 2 - 1];
+        }
+
+        throw std::runtime_error("Unknown vertex encoding.");
+    }
+
+    // the stream's floats padded out to the stored component count, remapped onto the encoded range if the stream asks for it
+    static std::vector<float> prepare_stream(const VertexStream &stream, const uint32_t vertex_count, const uint32_t stored, StreamDecode &decode) {
+        glm::vec4 scale(1.0f), offset(0.0f);
+
+        if (stream.fit_range && (stream.encoding == VertexEncoding::Snorm16 || stream.encoding == VertexEncoding::Unorm16)) {
+            glm::vec4 min(std::numeric_limits<float>::max()), max(std::numeric_limits<float>::lowest());
+            for (uint32_t v = 0; v < vertex_count; v++) {
+                for (uint32_t c = 0; c < stream.components; c++) {
+                    min[c] = std::min(min[c], stream.data[v * stream.components + c]);
+                    max[c] = std::max(max[c], stream.data[v * stream.components + c]);
+                }
+            }
+
+            for (uint32_t c = 0; c < stream.components; c++) {
+                const float extent = max[c] > min[c] ? max[c] - min[c] : 1.0f;
+                if (stream.encoding == VertexEncoding::Unorm16) {
+                    scale[c]  = extent;
+                    offset[c] = min[c];
+                } else {
+                    scale[c]  = extent * 0.5f;
+                    offset[c] = min[c] + extent * 0.5f;
+                }
+            }
+
+            decode = {scale, offset};
+        }
+
+        std::vector<float> prepared(static_cast<size_t>(vertex_count) * stored, 0.0f);
+        for (uint32_t v = 0; v < vertex_count; v++) {
+            for (uint32_t c = 0; c < stream.components; c++) {
+                prepared[v * stored + c] = (stream.data[v * stream.components + c] - offset[c]) / scale[c];
+            }
+        }
+
+        return prepared;
+    }
+
+    QuantizedVertices quantize_vertices(const std::span<const VertexStream> streams) {
+        QuantizedVertices result;
+        if (streams.empty())
+            return result;
+
+        for (const auto &stream : streams) {
+            if (stream.components < 1 || stream.components > 4 || (stream.encoding == VertexEncoding::Octahedral && stream.components != 3)) {
+                throw std::runtime_error("Invalid vertex stream component count.");
+            }
+        }
+
+        result.vertex_count = static_cast<uint32_t>(streams.front().data.size() / streams.front().components);
+        for (const auto &stream : streams) {
+            if (stream.data.size() != static_cast<size_t>(result.vertex_count) * stream.components) {
+                throw std::runtime_error("Vertex streams have different vertex counts.");
+            }
+
+            result.attributes.push_back(VertexBufferAttribute{stream.location, quantized_format(stream.encoding, stream.components), result.stride});
+            result.stride += stored_components(stream.encoding, stream.components) * component_size(stream.encoding);
+        }
+
+        result.data.resize(static_cast<size_t>(result.stride) * result.vertex_count);
+        result.decode.resize(streams.size());
+
+        const QuantizeKernels &k = kernels();
+        std::vector<uint16_t>  converted;
+        for (size_t s = 0; s < streams.size(); s++) {
+            const VertexStream &stream       = streams[s];
+            const uint32_t      stored       = stored_components(stream.encoding, stream.components);
+            const uint32_t      element_size = stored * component_size(stream.encoding);
+            const uint32_t      offset       = result.attributes[s].offset;
+
+            const void *source = nullptr;
+            if (stream.encoding == VertexEncoding::Float32) {
+                source = stream.data.data();
+            } else if (stream.encoding == VertexEncoding::Octahedral) {
+                converted.resize(static_cast<size_t>(result.vertex_count) * 2);
+                k.octahedral(stream.data.data(), converted.data(), result.vertex_count);
+                source = converted.data();
+            } else {
+                // data which is already the right shape is converted in place, without a copy
+                std::vector<float> prepared;
+                const float       *floats = stream.data.data();
+                if (stored != stream.components || stream.fit_range) {
+                    prepared = prepare_stream(stream, result.vertex_count, stored, result.decode[s]);
+                    floats   = prepared.data();
+                }
+
+                const size_t count = static_cast<size_t>(result.vertex_count) * stored;
+                converted.resize(count);
+                switch (stream.encoding) {
+                case VertexEncoding::Half:
+                    k.half(floats, converted.data(), count);
+                    break;
+                case VertexEncoding::Snorm16:
+                    k.snorm16(floats, converted.data(), count);
+                    break;
+                default:
+                    k.unorm16(floats, converted.data(), count);
+                    break;
+                }
+                source = converted.data();
+            }
+
+            const auto *bytes = static_cast<const std::byte *>(source);
+            for (uint32_t v = 0; v < result.vertex_count; v++) {
+                std::memcpy(result.data.data() + static_cast<size_t>(v) * result.stride + offset, bytes + static_cast<size_t>(v) * element_size, element_size);
+            }
+        }
+
+        return result;
+    }
+} // namespace vke
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <span>
+#include <vector>
+
+#include "vke/renderer.hpp"
+
+namespace vke {
+    enum class VertexEncoding {
+        Float32,
+        Half,       // 16 bit float, for anything that doesn't fit in a fixed range
+        Snorm16,    // [-1, 1], see VertexStream::fit_range
+        Unorm16,    // [0, 1], see VertexStream::fit_range
+        Octahedral, // unit vec3 (normals, tangents) folded onto 2 snorm16s. the shader has to unfold it.
+    };
+
+    struct VertexStream {
+        std::span<const float> data; // components floats per vertex, tightly packed
+        uint32_t               components; // 1 to 4, or 3 for octahedral
+        VertexEncoding         encoding;
+        uint32_t               location;
+
+        // for snorm16 and unorm16, maps each component's bounds onto the encoded range instead of clamping. StreamDecode gets the original back.
+        bool fit_range = false;
+    };
+
+    // original = decoded * scale + offset, per component. identity unless the stream used fit_range.
+    struct StreamDecode {
+        glm::vec4 scale{1.0f};
+        glm::vec4 offset{0.0f};
+    };
+
+    struct QuantizedVertices {
+        std::vector<std::byte>             data; // interleaved, ready to pass to Mesh::create with vertex_stride = stride
+        uint32_t                           stride       = 0;
+        uint32_t                           vertex_count = 0;
+        std::vector<VertexBufferAttribute> attributes;
+        std::vector<StreamDecode>          decode; // one per stream, in order
+
+        [[nodiscard]] VertexBufferBinding binding(uint32_t binding = 0) const { return {binding, stride, vk::VertexInputRate::eVertex, attributes}; }
+    };
+
+    /**
+     * @brief Converts float vertex streams to smaller formats and interleaves them into one vertex buffer.
+     *
+     * 16 bit formats are padded to an even component count (a vec3 becomes 4 components, the last one 0) so every attribute stays 4 byte aligned. The conversions use
+     * AVX2/F16C or SSE2 when the cpu has them (picked at runtime), and plain c++ otherwise.
+     */
+    [[nodiscard]] QuantizedVertices quantize_vertices(std::span<const VertexStream> streams);
+
+    // the attribute format a stream ends up in
+    [[nodiscard]] vk::Format quantized_format(VertexEncoding encoding, uint32_t components);
+} // namespace vke